@@ -0,0 +1,276 @@
+#ifndef BOWSER_UTIL_FILE_STREAM_H
+#define BOWSER_UTIL_FILE_STREAM_H
+
+#include <glad.h>
+#include "types/persistent_buffer.h"
+#include "types/gl_state.h"
+#include "parallel.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#define BOWSER_UTIL_FILE_STREAM_POSIX
+#endif
+
+namespace bowser_util {
+    /**
+     * @brief Stats for a file stream
+     */
+    struct FileStreamStats {
+        bool ok = false;          // False if the file couldn't be opened / read fully
+        bool directIO = false;    // Whether reads bypassed the page cache (O_DIRECT)
+        std::size_t bytes = 0;    // Bytes read from the file
+        std::size_t chunks = 0;   // Number of staging chunks used
+        double readSeconds = 0.0; // Time spent in read calls
+        double stallSeconds = 0.0;// Time spent waiting for the GPU to release staging buffers
+        double totalSeconds = 0.0;
+    };
+
+    namespace FileStream {
+        constexpr std::size_t DIRECT_IO_ALIGNMENT = 4096;
+
+        // Minimal file handle, reads go straight into the given pointer (no intermediate heap buffer)
+        class Reader {
+        public:
+            Reader(const char * path, bool tryDirectIO) {
+                #ifdef BOWSER_UTIL_FILE_STREAM_POSIX
+                #ifdef O_DIRECT
+                if (tryDirectIO) {
+                    fd = open(path, O_RDONLY | O_DIRECT);
+                    direct = fd >= 0;
+                }
+                #endif
+                if (fd < 0) fd = open(path, O_RDONLY);
+                if (fd >= 0) {
+                    struct stat st;
+                    if (fstat(fd, &st) == 0) _size = st.st_size;
+                    #ifdef POSIX_FADV_SEQUENTIAL
+                    if (!direct) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+                    #endif
+                }
+                #else
+                file = std::fopen(path, "rb");
+                if (file) {
+                    seek(0, SEEK_END);
+                    _size = tell();
+                    seek(0, SEEK_SET);
+                }
+                #endif
+                (void)tryDirectIO;
+                this->path = path;
+            }
+            ~Reader() {
+                #ifdef BOWSER_UTIL_FILE_STREAM_POSIX
+                if (fd >= 0) close(fd);
+                #else
+                if (file) std::fclose(file);
+                #endif
+            }
+            Reader(const Reader &other) = delete;
+            Reader &operator=(const Reader &other) = delete;
+
+            bool isOpen() const {
+                #ifdef BOWSER_UTIL_FILE_STREAM_POSIX
+                return fd >= 0;
+                #else
+                return file != nullptr;
+                #endif
+            }
+            bool isDirect() const { return direct; }
+            std::size_t size() const { return _size; }
+
+            /**
+             * @brief Read up to bytes at offset into dst. With direct IO the pointer, offset and
+             *        size must be aligned to DIRECT_IO_ALIGNMENT. If a direct read fails for any
+             *        reason (EINVAL for alignment, EFAULT for GPU mapped memory the kernel can't
+             *        DMA into, ...) the file is reopened without direct IO and the read retried
+             * @return std::size_t Bytes read (less than bytes only at the end of the file), 0 on error
+             */
+            std::size_t read(void * dst, std::size_t offset, std::size_t bytes) {
+                #ifdef BOWSER_UTIL_FILE_STREAM_POSIX
+                std::size_t done = 0;
+                while (done < bytes) {
+                    const ssize_t n = pread(fd, (uint8_t*)dst + done, bytes - done, offset + done);
+                    if (n < 0 && errno == EINTR) continue;
+                    if (n < 0 && direct) {
+                        close(fd);
+                        fd = open(path, O_RDONLY);
+                        direct = false;
+                        if (fd < 0) return 0;
+                        continue;
+                    }
+                    if (n <= 0) break;
+                    done += n;
+                }
+                return done;
+                #else
+                if (!seek(offset, SEEK_SET)) return 0;
+                return std::fread(dst, 1, bytes, file);
+                #endif
+            }
+        private:
+            const char * path = nullptr;
+            std::size_t _size = 0;
+            bool direct = false;
+            #ifdef BOWSER_UTIL_FILE_STREAM_POSIX
+            int fd = -1;
+            #else
+            std::FILE * file = nullptr;
+
+            // 64 bit offsets, long is 32 bits on Windows
+            bool seek(std::size_t offset, int origin) {
+                #ifdef _WIN32
+                return _fseeki64(file, (long long)offset, origin) == 0;
+                #else
+                return fseeko(file, (off_t)offset, origin) == 0;
+                #endif
+            }
+
+            std::size_t tell() {
+                #ifdef _WIN32
+                const long long position = _ftelli64(file);
+                #else
+                const off_t position = ftello(file);
+                #endif
+                return position < 0 ? 0 : (std::size_t)position;
+            }
+            #endif
+        };
+
+        // Direct IO needs the chunk size and every mapped pointer aligned
+        template <std::size_t bufferCount>
+        bool direct_io_ok(PersistentBuffer<bufferCount> &staging) {
+            bool aligned = staging.size() % DIRECT_IO_ALIGNMENT == 0;
+            for (std::size_t i = 0; i < staging.getBufferCount(); i++)
+                aligned &= (uintptr_t)staging.get(i) % DIRECT_IO_ALIGNMENT == 0;
+            return aligned;
+        }
+
+        // streamFile() from an already open reader
+        template <std::size_t bufferCount, class F>
+        FileStreamStats stream(Reader &reader, PersistentBuffer<bufferCount> &staging, F &onChunk,
+                std::chrono::steady_clock::time_point start) {
+            FileStreamStats stats;
+            const std::size_t chunk = staging.size();
+            const std::size_t fileSize = reader.size();
+            std::size_t offset = 0;
+            while (offset < fileSize) {
+                const auto waitStart = std::chrono::steady_clock::now();
+                staging.wait(0);
+                stats.stallSeconds += secondsSince(waitStart);
+
+                // Direct IO wants aligned lengths, it just returns fewer bytes at the end of the file
+                const std::size_t want = std::min(chunk, fileSize - offset);
+                const auto readStart = std::chrono::steady_clock::now();
+                const std::size_t got = reader.read(staging.get(0), offset, reader.isDirect() ? chunk : want);
+                stats.readSeconds += secondsSince(readStart);
+
+                const std::size_t bytes = std::min(got, want);
+                if (bytes == 0) break;
+
+                onChunk(std::size_t(0), offset, bytes);
+                staging.lock(0);
+                staging.advance_cycle();
+
+                offset += bytes;
+                stats.chunks++;
+            }
+
+            stats.bytes = offset;
+            stats.ok = offset == fileSize;
+            stats.directIO = reader.isDirect();
+            stats.totalSeconds = secondsSince(start);
+            return stats;
+        }
+    }
+
+    /**
+     * @brief Stream a file chunk by chunk straight into the mapped memory of a PersistentBuffer,
+     *        calling onChunk after each chunk is read. Each staging buffer is wait()ed on before
+     *        it is reused and lock()ed after onChunk, so the disk read of the next chunk overlaps
+     *        with the GPU consuming the previous one.
+     *
+     *        Direct IO (O_DIRECT) is used if the mapped pointers and buffer size are 4096 byte
+     *        aligned, so the file doesn't also end up in the page cache.
+     *
+     * @param path File to read
+     * @param staging Write-mapped persistent buffer, each buffer is one chunk
+     * @param onChunk void(std::size_t bufferIndex, std::size_t fileOffset, std::size_t bytes),
+     *        data is in staging.get(bufferIndex) / staging.getId(bufferIndex)
+     * @return FileStreamStats
+     */
+    template <std::size_t bufferCount, class F>
+    FileStreamStats streamFile(const char * path, PersistentBuffer<bufferCount> &staging, F onChunk) {
+        const auto start = std::chrono::steady_clock::now();
+        if (!staging.size()) return FileStreamStats();
+
+        FileStream::Reader reader(path, FileStream::direct_io_ok(staging));
+        if (!reader.isOpen()) return FileStreamStats();
+        return FileStream::stream(reader, staging, onChunk, start);
+    }
+
+    /**
+     * @brief Stream a file into an existing GPU buffer through a staging PersistentBuffer, with no
+     *        intermediate heap copy. Chunks are read into mapped memory and copied on the GPU
+     *        with glCopyBufferSubData
+     * @param path File to read
+     * @param staging Staging persistent buffer, ie PersistentBuffer<3>(GL_COPY_READ_BUFFER, 4 << 20, PBFlags::WRITE)
+     * @param destBuffer Buffer to copy into, must be big enough to hold the file
+     * @param destOffset Byte offset in destBuffer to start writing at
+     * @return FileStreamStats
+     */
+    template <std::size_t bufferCount>
+    FileStreamStats streamFileToBuffer(const char * path, PersistentBuffer<bufferCount> &staging,
+            GLuint destBuffer, GLintptr destOffset = 0) {
+        return streamFile(path, staging, [&](std::size_t i, std::size_t offset, std::size_t bytes) {
+            glState().bindBuffer(GL_COPY_READ_BUFFER, staging.getId(i));
+            glState().bindBuffer(GL_COPY_WRITE_BUFFER, destBuffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, destOffset + offset, bytes);
+        });
+    }
+
+    /**
+     * @brief Create an immutable GPU-only buffer sized to the file and stream the file into it,
+     *        ie for large static vertex data
+     * @param path File to read
+     * @param target Target to create the buffer with, ie GL_ARRAY_BUFFER
+     * @param staging Staging persistent buffer, see streamFileToBuffer
+     * @param stats Optional output stats
+     * @return GLuint Buffer id, 0 if the file couldn't be read
+     */
+    template <std::size_t bufferCount>
+    GLuint loadFileToBuffer(const char * path, GLenum target, PersistentBuffer<bufferCount> &staging,
+            FileStreamStats * stats = nullptr) {
+        const auto start = std::chrono::steady_clock::now();
+        if (!staging.size()) return 0;
+        FileStream::Reader reader(path, FileStream::direct_io_ok(staging));
+        if (!reader.isOpen() || reader.size() == 0) return 0;
+
+        GLuint buffer = 0;
+        glGenBuffers(1, &buffer);
+        glState().bindBuffer(target, buffer);
+        glBufferStorage(target, reader.size(), NULL, 0);
+
+        auto copy = [&](std::size_t i, std::size_t offset, std::size_t bytes) {
+            glState().bindBuffer(GL_COPY_READ_BUFFER, staging.getId(i));
+            glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, offset, bytes);
+        };
+        FileStreamStats result = FileStream::stream(reader, staging, copy, start);
+        if (stats) *stats = result;
+        if (!result.ok) {
+            glState().deleteBuffers(1, &buffer);
+            return 0;
+        }
+        return buffer;
+    }
+}
+
+#endif
@@ -0,0 +1,391 @@
+#ifndef BOWSER_UTIL_HULL_H
+#define BOWSER_UTIL_HULL_H
+
+#include "stdint.h"
+#include "types/vector.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace bowser_util {
+    namespace Hull {
+        // > 0 if p is left of a -> b (counter clockwise turn)
+        inline float cross2(const vec2 &a, const vec2 &b, const vec2 &p) {
+            return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+        }
+
+        inline bool lex_less(const vec2 &a, const vec2 &b) {
+            return a.x < b.x || (a.x == b.x && a.y < b.y);
+        }
+
+        // Emit the hull between a and b (exclusive) from points strictly right of a -> b, in order
+        inline std::size_t quickhull_rec(const vec2 &a, const vec2 &b, std::span<vec2> points, std::span<vec2> out, std::size_t count) {
+            if (points.empty()) return count;
+
+            std::size_t far = 0;
+            float farDist = 0.0f;
+            for (std::size_t i = 0; i < points.size(); i++) {
+                const float d = -cross2(a, b, points[i]);
+                if (d > farDist) {
+                    farDist = d;
+                    far = i;
+                }
+            }
+            const vec2 c = points[far];
+
+            // [0, right of a->c) [right of a->c, right of c->b) [rest: inside the triangle, dropped]
+            auto mid = std::partition(points.begin(), points.end(), [&](const vec2 &p) { return cross2(a, c, p) < 0.0f; });
+            auto end = std::partition(mid, points.end(), [&](const vec2 &p) { return cross2(c, b, p) < 0.0f; });
+
+            count = quickhull_rec(a, c, std::span<vec2>(points.begin(), mid), out, count);
+            out[count++] = c;
+            return quickhull_rec(c, b, std::span<vec2>(mid, end), out, count);
+        }
+    }
+
+    /**
+     * @brief 2D convex hull with Andrew's monotone chain, O(n log n)
+     * @param points Input points, sorted in place
+     * @param out Output hull, counter clockwise starting from the lowest x, collinear points
+     *        removed. Needs points.size() + 1 entries
+     * @return std::size_t Number of hull points, 1 if all points are identical
+     */
+    inline std::size_t convexHullMonotone(std::span<vec2> points, std::span<vec2> out) {
+        using Hull::cross2;
+        const std::size_t n = points.size();
+        if (!n) return 0;
+        std::sort(points.begin(), points.end(), Hull::lex_less);
+        if (points.front() == points.back()) {
+            out[0] = points.front();
+            return 1;
+        }
+        if (n < 3) {
+            std::copy(points.begin(), points.end(), out.begin());
+            return n;
+        }
+
+        std::size_t k = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            while (k >= 2 && cross2(out[k - 2], out[k - 1], points[i]) <= 0.0f) k--;
+            out[k++] = points[i];
+        }
+        for (std::size_t i = n - 1, lower = k + 1; i-- > 0;) {
+            while (k >= lower && cross2(out[k - 2], out[k - 1], points[i]) <= 0.0f) k--;
+            out[k++] = points[i];
+        }
+        return k - 1; // Last point is the first one again
+    }
+
+    /**
+     * @brief 2D convex hull with quickhull, faster than monotone chain when most points are inside
+     *        the hull (no sort, interior points are discarded early)
+     * @param points Input points, reordered in place
+     * @param out Output hull, counter clockwise starting from the lowest x. Needs points.size() entries
+     * @return std::size_t Number of hull points, 1 if all points are identical
+     */
+    inline std::size_t convexHullQuick(std::span<vec2> points, std::span<vec2> out) {
+        using Hull::cross2;
+        if (points.empty()) return 0;
+        const auto [minIt, maxIt] = std::minmax_element(points.begin(), points.end(), Hull::lex_less);
+        const vec2 a = *minIt, b = *maxIt;
+        if (a == b) {
+            out[0] = a;
+            return 1;
+        }
+        if (points.size() < 3) {
+            out[0] = a;
+            out[1] = b;
+            return 2;
+        }
+
+        // [right of a->b (lower chain), right of b->a (upper chain), on the line]
+        auto mid = std::partition(points.begin(), points.end(), [&](const vec2 &p) { return cross2(a, b, p) < 0.0f; });
+        auto end = std::partition(mid, points.end(), [&](const vec2 &p) { return cross2(b, a, p) < 0.0f; });
+
+        std::size_t count = 0;
+        out[count++] = a;
+        count = Hull::quickhull_rec(a, b, std::span<vec2>(points.begin(), mid), out, count);
+        out[count++] = b;
+        return Hull::quickhull_rec(b, a, std::span<vec2>(mid, end), out, count);
+    }
+
+    /**
+     * @brief Reusable working memory for convexHull3D, keep one per thread and reuse it so
+     *        hulls don't allocate once it has grown to the largest input
+     */
+    struct Hull3DScratch {
+        struct Face {
+            uint32_t v[3];
+            uint32_t adj[3];       // Face across edge v[i] -> v[(i + 1) % 3]
+            _baseVec3<double> normal; // Planes in double, in float near coplanar faces of dense inputs
+            double offset;            // give inconsistent visibility. dot(normal, p) - offset = signed distance
+            uint32_t outside;      // Head of the outside point list, UINT32_MAX if empty
+            uint32_t furthest;
+            double furthestDist;
+            uint32_t visit;
+            bool alive;
+        };
+        struct HorizonEdge { uint32_t a, b, face, edge; };
+
+        std::vector<Face> faces;
+        std::vector<uint32_t> freeFaces;
+        std::vector<uint32_t> nextPoint;  // Outside point linked lists
+        std::vector<uint32_t> pending;    // Faces that may have outside points
+        std::vector<uint32_t> visible;
+        std::vector<HorizonEdge> horizon;
+        std::vector<uint32_t> newFaces;
+        std::vector<uint32_t> stack;
+    };
+
+    namespace Hull {
+        using Face = Hull3DScratch::Face;
+        constexpr uint32_t NONE = UINT32_MAX;
+
+        inline double face_dist(const Face &f, const vec3 &p) {
+            return f.normal.x * p.x + f.normal.y * p.y + f.normal.z * p.z - f.offset;
+        }
+
+        inline uint32_t add_face(Hull3DScratch &s, std::span<const vec3> points, uint32_t a, uint32_t b, uint32_t c) {
+            Face f;
+            f.v[0] = a; f.v[1] = b; f.v[2] = c;
+            f.adj[0] = f.adj[1] = f.adj[2] = NONE;
+            const _baseVec3<double> pa(points[a].x, points[a].y, points[a].z);
+            const _baseVec3<double> pb(points[b].x, points[b].y, points[b].z);
+            const _baseVec3<double> pc(points[c].x, points[c].y, points[c].z);
+            const _baseVec3<double> n = (pb - pa).cross(pc - pa);
+            const double len = std::sqrt(n.dot(n));
+            f.normal = len > 0.0 ? n / len : _baseVec3<double>(0.0);
+            f.offset = f.normal.dot(pa);
+            f.outside = NONE;
+            f.furthest = NONE;
+            f.furthestDist = 0.0;
+            f.visit = 0;
+            f.alive = true;
+            if (!s.freeFaces.empty()) {
+                const uint32_t id = s.freeFaces.back();
+                s.freeFaces.pop_back();
+                s.faces[id] = f;
+                return id;
+            }
+            s.faces.push_back(f);
+            return (uint32_t)s.faces.size() - 1;
+        }
+
+        inline void add_outside(Hull3DScratch &s, uint32_t face, uint32_t point, double dist) {
+            Face &f = s.faces[face];
+            s.nextPoint[point] = f.outside;
+            f.outside = point;
+            if (dist > f.furthestDist) {
+                f.furthestDist = dist;
+                f.furthest = point;
+            }
+        }
+
+        // Link the edges of two faces that share (a, b) in opposite directions
+        inline void link_shared_edge(Hull3DScratch &s, uint32_t f, uint32_t g) {
+            for (int i = 0; i < 3; i++)
+                for (int j = 0; j < 3; j++)
+                    if (s.faces[f].v[i] == s.faces[g].v[(j + 1) % 3] && s.faces[f].v[(i + 1) % 3] == s.faces[g].v[j]) {
+                        s.faces[f].adj[i] = g;
+                        s.faces[g].adj[j] = f;
+                    }
+        }
+    }
+
+    /**
+     * @brief 3D convex hull with quickhull
+     * @param points Input points
+     * @param outIndices Output triangles (counter clockwise seen from outside) as indices into points.
+     *        A hull has at most 2n - 4 triangles, so needs 3 * (2 * points.size() - 4) entries
+     * @param scratch Working memory, reuse it between calls to avoid allocations
+     * @return std::size_t Number of indices written, 0 if the points are degenerate (coplanar)
+     */
+    inline std::size_t convexHull3D(std::span<const vec3> points, std::span<uint32_t> outIndices, Hull3DScratch &scratch) {
+        using namespace Hull;
+        Hull3DScratch &s = scratch;
+        const std::size_t n = points.size();
+        if (n < 4) return 0;
+        s.faces.clear();
+        s.freeFaces.clear();
+        s.pending.clear();
+        s.nextPoint.assign(n, NONE);
+
+        // Tolerance relative to the size of the input
+        vec3 maxAbs(0.0f);
+        uint32_t ext[6] = {0, 0, 0, 0, 0, 0}; // min x, max x, min y, max y, min z, max z
+        for (uint32_t i = 0; i < n; i++) {
+            const vec3 &p = points[i];
+            maxAbs = vec3(std::max(maxAbs.x, std::abs(p.x)), std::max(maxAbs.y, std::abs(p.y)), std::max(maxAbs.z, std::abs(p.z)));
+            if (p.x < points[ext[0]].x) ext[0] = i;
+            if (p.x > points[ext[1]].x) ext[1] = i;
+            if (p.y < points[ext[2]].y) ext[2] = i;
+            if (p.y > points[ext[3]].y) ext[3] = i;
+            if (p.z < points[ext[4]].z) ext[4] = i;
+            if (p.z > points[ext[5]].z) ext[5] = i;
+        }
+        const float eps = 3.0f * FLT_EPSILON * (maxAbs.x + maxAbs.y + maxAbs.z);
+        // Inputs are exact floats and planes are in double, so outside tests can be much tighter
+        const double planeEps = 1e-10 * (maxAbs.x + maxAbs.y + maxAbs.z);
+
+        // Initial tetrahedron: widest extreme pair, furthest from their line, furthest from their plane
+        uint32_t v0 = ext[0], v1 = ext[1];
+        float best = -1.0f;
+        for (int axis = 0; axis < 3; axis++) {
+            const float d = (points[ext[axis * 2 + 1]] - points[ext[axis * 2]]).lengthSqr();
+            if (d > best) {
+                best = d;
+                v0 = ext[axis * 2];
+                v1 = ext[axis * 2 + 1];
+            }
+        }
+        if (best <= eps * eps) return 0;
+
+        uint32_t v2 = NONE, v3 = NONE;
+        best = 0.0f;
+        const vec3 dir = points[v1] - points[v0];
+        for (uint32_t i = 0; i < n; i++) {
+            const float d = dir.cross(points[i] - points[v0]).lengthSqr();
+            if (d > best) {
+                best = d;
+                v2 = i;
+            }
+        }
+        if (v2 == NONE || std::sqrt(best) / dir.length() <= eps) return 0;
+
+        const vec3 planeN = dir.cross(points[v2] - points[v0]).normalize();
+        best = 0.0f;
+        for (uint32_t i = 0; i < n; i++) {
+            const float d = std::abs(planeN.dot(points[i] - points[v0]));
+            if (d > best) {
+                best = d;
+                v3 = i;
+            }
+        }
+        if (v3 == NONE || best <= eps) return 0;
+
+        // Orient the base so v3 is behind it
+        if (planeN.dot(points[v3] - points[v0]) > 0.0f) std::swap(v1, v2);
+        const uint32_t tetra[4] = {
+            add_face(s, points, v0, v1, v2), add_face(s, points, v0, v3, v1),
+            add_face(s, points, v1, v3, v2), add_face(s, points, v2, v3, v0)
+        };
+        for (int i = 0; i < 4; i++)
+            for (int j = i + 1; j < 4; j++)
+                link_shared_edge(s, tetra[i], tetra[j]);
+
+        for (uint32_t i = 0; i < n; i++) {
+            if (i == v0 || i == v1 || i == v2 || i == v3) continue;
+            for (uint32_t f : tetra) {
+                const double d = face_dist(s.faces[f], points[i]);
+                if (d > planeEps) {
+                    add_outside(s, f, i, d);
+                    break;
+                }
+            }
+        }
+        for (uint32_t f : tetra)
+            if (s.faces[f].outside != NONE) s.pending.push_back(f);
+
+        uint32_t visitStamp = 0;
+        while (!s.pending.empty()) {
+            const uint32_t start = s.pending.back();
+            s.pending.pop_back();
+            if (!s.faces[start].alive || s.faces[start].outside == NONE) continue;
+
+            const uint32_t eyeIndex = s.faces[start].furthest;
+            const vec3 eye = points[eyeIndex];
+            visitStamp++;
+
+            // Visible faces + ordered horizon, depth first across edges (start after the edge we came in through)
+            s.visible.clear();
+            s.horizon.clear();
+            s.stack.clear();
+            s.faces[start].visit = visitStamp;
+            s.visible.push_back(start);
+            s.stack.push_back(start);
+            s.stack.push_back(0);  // Next edge to try
+            s.stack.push_back(0);  // Edges tried
+            while (!s.stack.empty()) {
+                const std::size_t top = s.stack.size() - 3;
+                const uint32_t f = s.stack[top];
+                const uint32_t edge = s.stack[top + 1];
+                const uint32_t tried = s.stack[top + 2];
+                if (tried == 3) {
+                    s.stack.resize(top);
+                    continue;
+                }
+                s.stack[top + 1] = (edge + 1) % 3;
+                s.stack[top + 2] = tried + 1;
+
+                const uint32_t g = s.faces[f].adj[edge];
+                if (s.faces[g].visit == visitStamp) continue;
+                if (face_dist(s.faces[g], eye) > planeEps) {
+                    s.faces[g].visit = visitStamp;
+                    s.visible.push_back(g);
+                    uint32_t back = 0;
+                    while (s.faces[g].adj[back] != f) back++;
+                    s.stack.push_back(g);
+                    s.stack.push_back((back + 1) % 3);
+                    s.stack.push_back(1); // The edge back to f is already handled
+                } else {
+                    uint32_t back = 0;
+                    while (s.faces[g].adj[back] != f) back++;
+                    s.horizon.push_back({ s.faces[f].v[edge], s.faces[f].v[(edge + 1) % 3], g, back });
+                }
+            }
+
+            // Fan of new faces from the eye to the horizon
+            s.newFaces.clear();
+            for (const auto &h : s.horizon) {
+                const uint32_t nf = add_face(s, points, h.a, h.b, eyeIndex);
+                s.faces[nf].adj[0] = h.face;
+                s.faces[h.face].adj[h.edge] = nf;
+                s.newFaces.push_back(nf);
+            }
+            const std::size_t count = s.newFaces.size();
+            for (std::size_t k = 0; k < count; k++) {
+                s.faces[s.newFaces[k]].adj[1] = s.newFaces[(k + 1) % count];
+                s.faces[s.newFaces[k]].adj[2] = s.newFaces[(k + count - 1) % count];
+            }
+
+            // Kill visible faces, their outside points go to the new faces (or are now inside).
+            // Freed only now so the new faces above didn't reuse their slots
+            for (uint32_t f : s.visible) {
+                uint32_t p = s.faces[f].outside;
+                s.faces[f].alive = false;
+                s.faces[f].outside = NONE;
+                s.freeFaces.push_back(f);
+                while (p != NONE) {
+                    const uint32_t next = s.nextPoint[p];
+                    if (p != eyeIndex) {
+                        for (uint32_t nf : s.newFaces) {
+                            const double d = face_dist(s.faces[nf], points[p]);
+                            if (d > planeEps) {
+                                add_outside(s, nf, p, d);
+                                break;
+                            }
+                        }
+                    }
+                    p = next;
+                }
+            }
+            for (uint32_t nf : s.newFaces)
+                if (s.faces[nf].outside != NONE) s.pending.push_back(nf);
+        }
+
+        std::size_t written = 0;
+        for (const Face &f : s.faces) {
+            if (!f.alive) continue;
+            if (written + 3 > outIndices.size()) break;
+            outIndices[written++] = f.v[0];
+            outIndices[written++] = f.v[1];
+            outIndices[written++] = f.v[2];
+        }
+        return written;
+    }
+}
+
+#endif
@@ -0,0 +1,434 @@
+#ifndef BOWSER_UTIL_MESH_OPTIMIZE_H
+#define BOWSER_UTIL_MESH_OPTIMIZE_H
+
+#include "stdint.h"
+#include "types/vector.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace bowser_util {
+    /**
+     * @brief Post-transform vertex cache statistics of an index buffer
+     */
+    struct VertexCacheStats {
+        std::size_t transformed = 0; // Simulated vertex shader invocations
+        float acmr = 0.0f;           // Average cache miss ratio, transformed / triangles (0.5 is the best possible, 3 the worst)
+        float atvr = 0.0f;           // Average transform to vertex ratio, transformed / referenced vertices (1 is optimal)
+    };
+
+    /**
+     * @brief Timings and cache stats of optimizeMesh()
+     */
+    struct MeshOptimizeStats {
+        VertexCacheStats before, after;
+        double cacheSeconds = 0.0;
+        double overdrawSeconds = 0.0;
+        double fetchSeconds = 0.0;
+    };
+
+    namespace MeshOptimize {
+        // Triangles adjacent to each vertex, compressed (offsets[v] .. offsets[v] + counts[v])
+        struct Adjacency {
+            std::vector<uint32_t> counts, offsets, triangles;
+
+            void build(const uint32_t * indices, std::size_t indexCount, std::size_t vertexCount) {
+                counts.assign(vertexCount, 0);
+                offsets.resize(vertexCount);
+                triangles.resize(indexCount);
+                for (std::size_t i = 0; i < indexCount; i++) counts[indices[i]]++;
+                uint32_t offset = 0;
+                for (std::size_t v = 0; v < vertexCount; v++) {
+                    offsets[v] = offset;
+                    offset += counts[v];
+                }
+                std::vector<uint32_t> fill(offsets);
+                for (std::size_t i = 0; i < indexCount; i++)
+                    triangles[fill[indices[i]]++] = (uint32_t)(i / 3);
+            }
+        };
+
+        constexpr int MAX_CACHE_SIZE = 64;
+
+        // Forsyth vertex score, cachePos -1 = not in cache
+        inline float forsyth_score(int cachePos, uint32_t remaining, int cacheSize) {
+            if (remaining == 0) return -1.0f;
+            float score = 0.0f;
+            if (cachePos >= 0) {
+                if (cachePos < 3) score = 0.75f;
+                else score = std::pow(1.0f - (float)(cachePos - 3) / (cacheSize - 3), 1.5f);
+            }
+            return score + 2.0f / std::sqrt((float)remaining);
+        }
+    }
+
+    /**
+     * @brief Simulate a FIFO post-transform vertex cache
+     * @param indices Triangle list indices
+     * @param indexCount Number of indices (multiple of 3)
+     * @param vertexCount Number of vertices
+     * @param cacheSize Number of cache entries to simulate
+     * @return VertexCacheStats
+     */
+    inline VertexCacheStats analyzeVertexCache(const uint32_t * indices, std::size_t indexCount,
+            std::size_t vertexCount, int cacheSize = 16) {
+        VertexCacheStats stats;
+        if (indexCount < 3) return stats;
+
+        std::vector<int64_t> cacheTime(vertexCount, INT64_MIN / 2);
+        std::vector<uint8_t> referenced(vertexCount, 0);
+        int64_t time = 0;
+        std::size_t unique = 0;
+        for (std::size_t i = 0; i < indexCount; i++) {
+            const uint32_t v = indices[i];
+            if (time - cacheTime[v] >= cacheSize) {
+                cacheTime[v] = time++;
+                stats.transformed++;
+            }
+            unique += !referenced[v];
+            referenced[v] = 1;
+        }
+        stats.acmr = (float)stats.transformed / (indexCount / 3);
+        stats.atvr = unique ? (float)stats.transformed / unique : 0.0f;
+        return stats;
+    }
+
+    /**
+     * @brief Reorder triangles for the post-transform vertex cache with Tom Forsyth's
+     *        linear-speed algorithm. Works well regardless of the actual cache size / policy
+     * @param dst Output indices (indexCount), may be the same as indices
+     * @param indices Triangle list indices
+     * @param indexCount Number of indices (multiple of 3)
+     * @param vertexCount Number of vertices
+     * @param cacheSize Size of the modelled LRU cache (at most 64)
+     */
+    inline void optimizeVertexCacheForsyth(uint32_t * dst, const uint32_t * indices, std::size_t indexCount,
+            std::size_t vertexCount, int cacheSize = 32) {
+        using namespace MeshOptimize;
+        const std::size_t triCount = indexCount / 3;
+        if (!triCount) return;
+        cacheSize = std::clamp(cacheSize, 4, MAX_CACHE_SIZE);
+
+        std::vector<uint32_t> input;
+        if (dst == indices) {
+            input.assign(indices, indices + indexCount);
+            indices = input.data();
+        }
+
+        Adjacency adj;
+        adj.build(indices, indexCount, vertexCount);
+        std::vector<uint32_t> remaining(adj.counts);
+        std::vector<int8_t> cachePos(vertexCount, -1);
+        std::vector<float> vertexScore(vertexCount);
+        for (std::size_t v = 0; v < vertexCount; v++)
+            vertexScore[v] = forsyth_score(-1, remaining[v], cacheSize);
+
+        std::vector<uint8_t> emitted(triCount, 0);
+
+        uint32_t cache[MAX_CACHE_SIZE + 3];
+        uint32_t newCache[MAX_CACHE_SIZE + 3];
+        int cacheCount = 0;
+        std::size_t cursor = 0;
+        int64_t best = -1;
+
+        for (std::size_t out = 0; out < triCount; out++) {
+            if (best < 0) {
+                // Nothing in the cache has triangles left, take the next unemitted one
+                while (emitted[cursor]) cursor++;
+                best = (int64_t)cursor;
+            }
+
+            const uint32_t * tri = indices + best * 3;
+            std::copy(tri, tri + 3, dst + out * 3);
+            emitted[best] = 1;
+
+            // Remove the triangle from its vertices' live adjacency (swap with the last live one)
+            for (int k = 0; k < 3; k++) {
+                const uint32_t v = tri[k];
+                uint32_t * list = adj.triangles.data() + adj.offsets[v];
+                for (uint32_t j = 0; j < remaining[v]; j++) {
+                    if (list[j] == (uint32_t)best) {
+                        std::swap(list[j], list[remaining[v] - 1]);
+                        break;
+                    }
+                }
+                remaining[v]--;
+            }
+
+            // New cache: the triangle's vertices on top, then the old entries
+            int newCount = 0;
+            for (int k = 0; k < 3; k++) newCache[newCount++] = tri[k];
+            for (int i = 0; i < cacheCount; i++) {
+                const uint32_t v = cache[i];
+                if (v != tri[0] && v != tri[1] && v != tri[2]) newCache[newCount++] = v;
+            }
+
+            for (int i = 0; i < newCount; i++) {
+                const uint32_t v = newCache[i];
+                cachePos[v] = i < cacheSize ? (int8_t)i : -1;
+                vertexScore[v] = forsyth_score(cachePos[v], remaining[v], cacheSize);
+            }
+
+            // Score triangles touching the cache, pick the best one
+            best = -1;
+            float bestScore = -1.0f;
+            for (int i = 0; i < newCount; i++) {
+                const uint32_t v = newCache[i];
+                const uint32_t * list = adj.triangles.data() + adj.offsets[v];
+                for (uint32_t j = 0; j < remaining[v]; j++) {
+                    const uint32_t t = list[j];
+                    const float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                    if (i < cacheSize && score > bestScore) {
+                        bestScore = score;
+                        best = t;
+                    }
+                }
+            }
+
+            cacheCount = std::min(newCount, cacheSize);
+            std::copy(newCache, newCache + cacheCount, cache);
+        }
+    }
+
+    /**
+     * @brief Reorder triangles for the post-transform vertex cache with Tipsify (Sander et al. 2007)
+     *        Faster than Forsyth and tuned for a given FIFO cache size, also outputs the cluster
+     *        boundaries optimizeOverdraw() needs
+     * @param dst Output indices (indexCount), may not be the same as indices
+     * @param indices Triangle list indices
+     * @param indexCount Number of indices (multiple of 3)
+     * @param vertexCount Number of vertices
+     * @param cacheSize Size of the target FIFO cache
+     * @param clusters Optional output, index of the first triangle of each cluster (the cache was
+     *        "flushed" before it, so clusters can be reordered without hurting the cache much)
+     */
+    inline void optimizeVertexCacheTipsify(uint32_t * dst, const uint32_t * indices, std::size_t indexCount,
+            std::size_t vertexCount, int cacheSize = 16, std::vector<uint32_t> * clusters = nullptr) {
+        using namespace MeshOptimize;
+        const std::size_t triCount = indexCount / 3;
+        if (clusters) clusters->clear();
+        if (!triCount) return;
+
+        Adjacency adj;
+        adj.build(indices, indexCount, vertexCount);
+        std::vector<uint32_t> live(adj.counts);
+        std::vector<int64_t> cacheTime(vertexCount, INT64_MIN / 2);
+        std::vector<uint8_t> emitted(triCount, 0);
+        std::vector<uint32_t> deadEnd;
+        std::vector<uint32_t> candidates;
+        deadEnd.reserve(indexCount);
+        int64_t time = cacheSize + 1;
+        std::size_t cursor = 0, out = 0;
+
+        // First referenced vertex
+        int64_t fan = indices[0];
+        bool newCluster = true;
+        while (fan >= 0) {
+            candidates.clear();
+            const uint32_t * list = adj.triangles.data() + adj.offsets[fan];
+            for (uint32_t j = 0; j < adj.counts[fan]; j++) {
+                const uint32_t t = list[j];
+                if (emitted[t]) continue;
+                if (newCluster && clusters) clusters->push_back((uint32_t)out);
+                newCluster = false;
+
+                for (int k = 0; k < 3; k++) {
+                    const uint32_t v = indices[t * 3 + k];
+                    dst[out * 3 + k] = v;
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    if (time - cacheTime[v] > cacheSize) cacheTime[v] = time++;
+                }
+                emitted[t] = 1;
+                out++;
+            }
+
+            // Next fanning vertex: a candidate that will still be in cache after its triangles are emitted
+            fan = -1;
+            int64_t bestPriority = -1;
+            for (uint32_t v : candidates) {
+                if (!live[v]) continue;
+                int64_t priority = 0;
+                if (time - cacheTime[v] + 2 * (int64_t)live[v] <= cacheSize)
+                    priority = time - cacheTime[v];
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    fan = v;
+                }
+            }
+            if (fan >= 0) continue;
+
+            // Dead end, go back to recently used vertices, then scan for any vertex with triangles left
+            newCluster = true;
+            while (!deadEnd.empty()) {
+                const uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v]) {
+                    fan = v;
+                    break;
+                }
+            }
+            while (fan < 0 && cursor < vertexCount) {
+                if (live[cursor]) fan = (int64_t)cursor;
+                cursor++;
+            }
+        }
+    }
+
+    /**
+     * @brief Reorder the clusters found by optimizeVertexCacheTipsify() so triangles likely to occlude
+     *        others (facing away from the mesh center) are drawn first. Triangle order inside a
+     *        cluster is kept, so the vertex cache efficiency is mostly preserved
+     * @param indices Indices to reorder in place (output of optimizeVertexCacheTipsify)
+     * @param indexCount Number of indices
+     * @param positions Vertex positions
+     * @param vertexCount Number of vertices
+     * @param clusters Cluster start triangles from optimizeVertexCacheTipsify
+     */
+    inline void optimizeOverdraw(uint32_t * indices, std::size_t indexCount, const vec3 * positions,
+            std::size_t vertexCount, const std::vector<uint32_t> &clusters) {
+        (void)vertexCount;
+        const std::size_t triCount = indexCount / 3;
+        if (clusters.size() < 2) return;
+
+        // Area weighted mesh centroid
+        vec3 meshCenter(0.0f);
+        float meshArea = 0.0f;
+        struct Cluster { uint32_t start, end; float sortKey; };
+        std::vector<Cluster> list(clusters.size());
+        std::vector<vec3> centers(clusters.size()), normals(clusters.size());
+
+        for (std::size_t c = 0; c < clusters.size(); c++) {
+            const uint32_t start = clusters[c];
+            const uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : (uint32_t)triCount;
+            vec3 center(0.0f), normal(0.0f);
+            float area = 0.0f;
+            for (uint32_t t = start; t < end; t++) {
+                const vec3 &a = positions[indices[t * 3]], &b = positions[indices[t * 3 + 1]], &c2 = positions[indices[t * 3 + 2]];
+                const vec3 n = (b - a).cross(c2 - a);
+                const float triArea = n.length();
+                center += (a + b + c2) * (triArea / 3.0f);
+                normal += n;
+                area += triArea;
+            }
+            meshCenter += center;
+            meshArea += area;
+            centers[c] = area > 0.0f ? center / area : positions[indices[start * 3]];
+            const float len = normal.length();
+            normals[c] = len > 0.0f ? normal / len : vec3(0.0f);
+            list[c] = Cluster{ start, end, 0.0f };
+        }
+        if (meshArea > 0.0f) meshCenter /= meshArea;
+
+        for (std::size_t c = 0; c < list.size(); c++)
+            list[c].sortKey = (centers[c] - meshCenter).dot(normals[c]);
+        std::stable_sort(list.begin(), list.end(), [](const Cluster &a, const Cluster &b) { return a.sortKey > b.sortKey; });
+
+        std::vector<uint32_t> sorted;
+        sorted.reserve(triCount * 3);
+        for (const Cluster &c : list)
+            sorted.insert(sorted.end(), indices + c.start * 3, indices + c.end * 3);
+        std::copy(sorted.begin(), sorted.end(), indices);
+    }
+
+    /**
+     * @brief Build a remap table that orders vertices by first use in the index buffer,
+     *        so vertex fetches become (mostly) sequential. Unreferenced vertices are dropped
+     * @param remap Output, vertexCount entries: new index of each old vertex (UINT32_MAX if unused)
+     * @param indices Triangle list indices
+     * @param indexCount Number of indices
+     * @param vertexCount Number of vertices
+     * @return std::size_t Number of vertices after remapping
+     */
+    inline std::size_t buildVertexFetchRemap(uint32_t * remap, const uint32_t * indices, std::size_t indexCount,
+            std::size_t vertexCount) {
+        std::fill(remap, remap + vertexCount, UINT32_MAX);
+        uint32_t next = 0;
+        for (std::size_t i = 0; i < indexCount; i++)
+            if (remap[indices[i]] == UINT32_MAX) remap[indices[i]] = next++;
+        return next;
+    }
+
+    // Apply a remap table to an index buffer (in place is fine)
+    inline void remapIndices(uint32_t * dst, const uint32_t * indices, std::size_t indexCount, const uint32_t * remap) {
+        for (std::size_t i = 0; i < indexCount; i++)
+            dst[i] = remap[indices[i]];
+    }
+
+    // Apply a remap table to a vertex stream, dst must not alias src and hold as many vertices as the remap produced
+    template <class T>
+    void remapVertices(T * dst, const T * src, std::size_t vertexCount, const uint32_t * remap) {
+        for (std::size_t v = 0; v < vertexCount; v++)
+            if (remap[v] != UINT32_MAX) dst[remap[v]] = src[v];
+    }
+
+    /**
+     * @brief Reorder one interleaved vertex buffer by first use and remap the indices in place
+     * @param dstVertices Output vertex buffer, must not alias vertices
+     * @param indices Indices, remapped in place
+     * @param indexCount Number of indices
+     * @param vertices Input vertices
+     * @param vertexCount Number of input vertices
+     * @param vertexSize Size of one vertex in bytes
+     * @return std::size_t Number of vertices written to dstVertices
+     */
+    inline std::size_t optimizeVertexFetch(void * dstVertices, uint32_t * indices, std::size_t indexCount,
+            const void * vertices, std::size_t vertexCount, std::size_t vertexSize) {
+        std::vector<uint32_t> remap(vertexCount);
+        const std::size_t count = buildVertexFetchRemap(remap.data(), indices, indexCount, vertexCount);
+        for (std::size_t v = 0; v < vertexCount; v++)
+            if (remap[v] != UINT32_MAX)
+                std::memcpy((uint8_t*)dstVertices + remap[v] * vertexSize, (const uint8_t*)vertices + v * vertexSize, vertexSize);
+        remapIndices(indices, indices, indexCount, remap.data());
+        return count;
+    }
+
+    /**
+     * @brief Vertex cache (Tipsify) + optional overdraw + vertex fetch optimization of a position-only mesh
+     * @param indices Indices, reordered and remapped in place
+     * @param indexCount Number of indices
+     * @param positions Positions, reordered in place (unused vertices are dropped)
+     * @param vertexCount Number of vertices, updated to the new count
+     * @param overdraw Whether to also reorder clusters for overdraw
+     * @param cacheSize FIFO cache size to optimize / measure for
+     * @return MeshOptimizeStats Cache stats before / after and time spent in each pass
+     */
+    inline MeshOptimizeStats optimizeMesh(uint32_t * indices, std::size_t indexCount, vec3 * positions,
+            std::size_t &vertexCount, bool overdraw = true, int cacheSize = 16) {
+        MeshOptimizeStats stats;
+        stats.before = analyzeVertexCache(indices, indexCount, vertexCount, cacheSize);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<uint32_t> tmp(indexCount);
+        std::vector<uint32_t> clusters;
+        optimizeVertexCacheTipsify(tmp.data(), indices, indexCount, vertexCount, cacheSize, overdraw ? &clusters : nullptr);
+        std::copy(tmp.begin(), tmp.end(), indices);
+        stats.cacheSeconds = secondsSince(start);
+
+        if (overdraw) {
+            start = std::chrono::steady_clock::now();
+            optimizeOverdraw(indices, indexCount, positions, vertexCount, clusters);
+            stats.overdrawSeconds = secondsSince(start);
+        }
+
+        start = std::chrono::steady_clock::now();
+        std::vector<uint32_t> remap(vertexCount);
+        const std::size_t newCount = buildVertexFetchRemap(remap.data(), indices, indexCount, vertexCount);
+        std::vector<vec3> reordered(newCount);
+        remapVertices(reordered.data(), positions, vertexCount, remap.data());
+        std::copy(reordered.begin(), reordered.end(), positions);
+        remapIndices(indices, indices, indexCount, remap.data());
+        vertexCount = newCount;
+        stats.fetchSeconds = secondsSince(start);
+
+        stats.after = analyzeVertexCache(indices, indexCount, vertexCount, cacheSize);
+        return stats;
+    }
+}
+
+#endif
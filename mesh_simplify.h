@@ -0,0 +1,268 @@
+#ifndef BOWSER_UTIL_MESH_SIMPLIFY_H
+#define BOWSER_UTIL_MESH_SIMPLIFY_H
+
+#include "stdint.h"
+#include "types/vector.h"
+#include "mesh_optimize.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace bowser_util {
+    /**
+     * @brief Options for simplifyMesh()
+     */
+    struct SimplifyOptions {
+        std::size_t targetIndexCount = 0; // Stop once the mesh has at most this many indices
+        float maxError = INFINITY;        // Never collapse an edge whose error (world units) is above this
+        bool lockBorder = true;           // Never move vertices on open edges (ie chunk seams), otherwise they are only penalized
+        float borderWeight = 10.0f;       // Weight of the border preserving planes when lockBorder is false
+    };
+
+    /**
+     * @brief Result / quality metrics of simplifyMesh()
+     */
+    struct SimplifyStats {
+        std::size_t trianglesBefore = 0;
+        std::size_t trianglesAfter = 0;
+        std::size_t collapses = 0;
+        std::size_t passes = 0;
+        float maxError = 0.0f;   // Largest quadric error (world units) of any collapse done
+        double seconds = 0.0;
+
+        double trianglesPerSecond() const { return seconds > 0.0 ? trianglesBefore / seconds : 0.0; }
+        float ratio() const { return trianglesBefore ? (float)trianglesAfter / trianglesBefore : 0.0f; }
+    };
+
+    namespace MeshSimplify {
+        // Symmetric 4x4 error quadric, divided by the weight it's the mean squared distance to its planes
+        struct Quadric {
+            double a2 = 0, b2 = 0, c2 = 0, d2 = 0, ab = 0, ac = 0, ad = 0, bc = 0, bd = 0, cd = 0, w = 0;
+
+            static Quadric plane(double a, double b, double c, double d, double weight) {
+                Quadric q;
+                q.a2 = a * a * weight; q.b2 = b * b * weight; q.c2 = c * c * weight; q.d2 = d * d * weight;
+                q.ab = a * b * weight; q.ac = a * c * weight; q.ad = a * d * weight;
+                q.bc = b * c * weight; q.bd = b * d * weight; q.cd = c * d * weight;
+                q.w = weight;
+                return q;
+            }
+
+            Quadric &operator+=(const Quadric &o) {
+                a2 += o.a2; b2 += o.b2; c2 += o.c2; d2 += o.d2;
+                ab += o.ab; ac += o.ac; ad += o.ad; bc += o.bc; bd += o.bd; cd += o.cd;
+                w += o.w;
+                return *this;
+            }
+
+            // Mean squared distance of p to the planes
+            double error(const vec3 &p) const {
+                const double x = p.x, y = p.y, z = p.z;
+                const double e = a2 * x * x + b2 * y * y + c2 * z * z
+                    + 2 * (ab * x * y + ac * x * z + bc * y * z)
+                    + 2 * (ad * x + bd * y + cd * z) + d2;
+                return w > 0 ? std::abs(e) / w : 0.0;
+            }
+        };
+
+        struct Edge {
+            uint32_t from, to; // Collapse from -> to
+            float cost;        // Squared error
+        };
+
+        inline uint64_t edge_key(uint32_t a, uint32_t b) {
+            return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+        }
+
+        // Smallest cosine between a triangle's normal before and after a collapse, and between its normal
+        // and the normal it had in the input mesh, so slivers can't turn over a bit at a time across passes
+        constexpr float MIN_NORMAL_COS = 0.2f;
+
+        // Collapsing from onto to must not flip or steeply tilt any remaining triangle around from
+        inline bool flips(const MeshOptimize::Adjacency &adj, const uint32_t * indices, const vec3 * positions,
+                const vec3 * originalNormals, uint32_t from, uint32_t to) {
+            const vec3 &target = positions[to];
+            const uint32_t * list = adj.triangles.data() + adj.offsets[from];
+            for (uint32_t j = 0; j < adj.counts[from]; j++) {
+                const uint32_t * tri = indices + list[j] * 3;
+                if (tri[0] == to || tri[1] == to || tri[2] == to) continue; // Removed by the collapse
+
+                const vec3 &a = positions[tri[0]], &b = positions[tri[1]], &c = positions[tri[2]];
+                const vec3 before = (b - a).cross(c - a);
+                const vec3 na = tri[0] == from ? target : a;
+                const vec3 nb = tri[1] == from ? target : b;
+                const vec3 nc = tri[2] == from ? target : c;
+                const vec3 after = (nb - na).cross(nc - na);
+                const float afterLength = after.length();
+                if (before.dot(after) <= MIN_NORMAL_COS * before.length() * afterLength) return true;
+                if (originalNormals[list[j]].dot(after) <= MIN_NORMAL_COS * afterLength) return true;
+            }
+            return false;
+        }
+    }
+
+    /**
+     * @brief Simplify a triangle mesh by collapsing edges in order of quadric error (Garland & Heckbert)
+     *        Vertices are collapsed onto existing vertices, so the output indices still refer to the
+     *        input vertex buffer (use buildVertexFetchRemap from mesh_optimize.h to compact it).
+     *        Only uses local memory so it's safe to call from worker threads
+     * @param dst Output indices, at least indexCount entries (may be the same as indices)
+     * @param indices Triangle list indices
+     * @param indexCount Number of indices
+     * @param positions Vertex positions
+     * @param vertexCount Number of vertices
+     * @param options Target count / error and border handling
+     * @param stats Optional output metrics
+     * @return std::size_t Number of indices written to dst
+     */
+    inline std::size_t simplifyMesh(uint32_t * dst, const uint32_t * indices, std::size_t indexCount,
+            const vec3 * positions, std::size_t vertexCount, const SimplifyOptions &options, SimplifyStats * stats = nullptr) {
+        using namespace MeshSimplify;
+        const auto start = std::chrono::steady_clock::now();
+        SimplifyStats result;
+        result.trianglesBefore = indexCount / 3;
+
+        std::vector<uint32_t> current(indices, indices + indexCount - indexCount % 3);
+        std::vector<Quadric> quadrics(vertexCount);
+        std::vector<uint8_t> border(vertexCount, 0);
+
+        // Open edges (used by exactly one triangle)
+        std::vector<uint64_t> edgeKeys;
+        edgeKeys.reserve(current.size());
+        for (std::size_t t = 0; t < current.size(); t += 3)
+            for (int k = 0; k < 3; k++)
+                edgeKeys.push_back(edge_key(current[t + k], current[t + (k + 1) % 3]));
+        std::sort(edgeKeys.begin(), edgeKeys.end());
+
+        auto is_border_edge = [&](uint32_t a, uint32_t b) {
+            const uint64_t key = edge_key(a, b);
+            auto range = std::equal_range(edgeKeys.begin(), edgeKeys.end(), key);
+            return range.second - range.first == 1;
+        };
+
+        // Plane quadrics weighted by area, plus planes perpendicular to open edges. The unit normals are kept
+        // per triangle (compacted along with current) for the flip test
+        std::vector<vec3> normals(current.size() / 3);
+        for (std::size_t t = 0; t < current.size(); t += 3) {
+            const vec3 &p0 = positions[current[t]], &p1 = positions[current[t + 1]], &p2 = positions[current[t + 2]];
+            vec3 n = (p1 - p0).cross(p2 - p0);
+            const float area = n.length();
+            if (area <= 0.0f) continue;
+            n /= area;
+            normals[t / 3] = n;
+            const Quadric q = Quadric::plane(n.x, n.y, n.z, -n.dot(p0), area * 0.5);
+            for (int k = 0; k < 3; k++) quadrics[current[t + k]] += q;
+
+            for (int k = 0; k < 3; k++) {
+                const uint32_t a = current[t + k], b = current[t + (k + 1) % 3];
+                if (!is_border_edge(a, b)) continue;
+                border[a] = border[b] = 1;
+                if (options.lockBorder) continue;
+
+                const vec3 edge = positions[b] - positions[a];
+                vec3 side = edge.cross(n);
+                const float len = side.length();
+                if (len <= 0.0f) continue;
+                side /= len;
+                const Quadric bq = Quadric::plane(side.x, side.y, side.z, -side.dot(positions[a]),
+                    edge.lengthSqr() * options.borderWeight);
+                quadrics[a] += bq;
+                quadrics[b] += bq;
+            }
+        }
+
+        const float maxCost = options.maxError * options.maxError;
+        const std::size_t target = options.targetIndexCount - options.targetIndexCount % 3;
+        std::vector<uint32_t> remap(vertexCount);
+        std::vector<uint8_t> touched(vertexCount);
+        std::vector<Edge> edges;
+        MeshOptimize::Adjacency adj;
+
+        while (current.size() > target) {
+            result.passes++;
+            adj.build(current.data(), current.size(), vertexCount);
+
+            // Unique edges with the cheaper collapse direction
+            edgeKeys.clear();
+            for (std::size_t t = 0; t < current.size(); t += 3)
+                for (int k = 0; k < 3; k++)
+                    edgeKeys.push_back(edge_key(current[t + k], current[t + (k + 1) % 3]));
+            std::sort(edgeKeys.begin(), edgeKeys.end());
+            edgeKeys.erase(std::unique(edgeKeys.begin(), edgeKeys.end()), edgeKeys.end());
+
+            edges.clear();
+            for (uint64_t key : edgeKeys) {
+                const uint32_t a = (uint32_t)(key >> 32), b = (uint32_t)key;
+                Quadric q = quadrics[a];
+                q += quadrics[b];
+                const bool canA = !(options.lockBorder && border[a]), canB = !(options.lockBorder && border[b]);
+                const float costAB = canA ? (float)q.error(positions[b]) : INFINITY;
+                const float costBA = canB ? (float)q.error(positions[a]) : INFINITY;
+                if (costAB <= costBA && canA) edges.push_back({ a, b, costAB });
+                else if (canB) edges.push_back({ b, a, costBA });
+            }
+            std::sort(edges.begin(), edges.end(), [](const Edge &l, const Edge &r) { return l.cost < r.cost; });
+
+            // Collapse the cheapest edges whose vertices weren't touched this pass,
+            // each collapse removes ~2 triangles
+            for (uint32_t v = 0; v < vertexCount; v++) remap[v] = v;
+            std::fill(touched.begin(), touched.end(), 0);
+            const std::size_t wanted = (current.size() - target) / 6 + 1;
+            std::size_t collapsed = 0;
+            for (const Edge &e : edges) {
+                if (e.cost > maxCost || collapsed >= wanted) break;
+                if (touched[e.from] || touched[e.to]) continue;
+                if (flips(adj, current.data(), positions, normals.data(), e.from, e.to)) continue;
+
+                remap[e.from] = e.to;
+                quadrics[e.to] += quadrics[e.from];
+                // Everything around from changes, so its neighbours can't collapse again this pass
+                const uint32_t * list = adj.triangles.data() + adj.offsets[e.from];
+                for (uint32_t j = 0; j < adj.counts[e.from]; j++)
+                    for (int k = 0; k < 3; k++) touched[current[list[j] * 3 + k]] = 1;
+                result.maxError = std::max(result.maxError, std::sqrt(e.cost));
+                collapsed++;
+            }
+            if (!collapsed) break;
+            result.collapses += collapsed;
+
+            // Apply the collapses and drop degenerate triangles
+            std::size_t write = 0;
+            for (std::size_t t = 0; t < current.size(); t += 3) {
+                const uint32_t a = remap[current[t]], b = remap[current[t + 1]], c = remap[current[t + 2]];
+                if (a == b || b == c || a == c) continue;
+                normals[write / 3] = normals[t / 3];
+                current[write++] = a;
+                current[write++] = b;
+                current[write++] = c;
+            }
+            current.resize(write);
+            normals.resize(write / 3);
+        }
+
+        std::copy(current.begin(), current.end(), dst);
+        result.trianglesAfter = current.size() / 3;
+        result.seconds = secondsSince(start);
+        if (stats) *stats = result;
+        return current.size();
+    }
+
+    /**
+     * @brief Simplify to a fraction of the triangles, see simplifyMesh()
+     * @param ratio Fraction of triangles to keep, ie 0.25
+     * @return std::size_t Number of indices written to dst
+     */
+    inline std::size_t simplifyMeshRatio(uint32_t * dst, const uint32_t * indices, std::size_t indexCount,
+            const vec3 * positions, std::size_t vertexCount, float ratio, float maxError = INFINITY,
+            SimplifyStats * stats = nullptr) {
+        SimplifyOptions options;
+        options.targetIndexCount = (std::size_t)(indexCount / 3 * std::clamp(ratio, 0.0f, 1.0f)) * 3;
+        options.maxError = maxError;
+        return simplifyMesh(dst, indices, indexCount, positions, vertexCount, options, stats);
+    }
+}
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef BOWSER_UTIL_MESH_WELD_H
+#define BOWSER_UTIL_MESH_WELD_H
+
+#include "stdint.h"
+#include "types/vector.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace bowser_util {
+    /**
+     * @brief Stats of weldVertices() / weldMesh()
+     */
+    struct WeldStats {
+        std::size_t verticesBefore = 0;
+        std::size_t verticesAfter = 0;
+        unsigned threads = 0;
+        std::size_t maxProbe = 0;   // Longest probe sequence in any hash table
+        double quantizeSeconds = 0.0;
+        double weldSeconds = 0.0;
+        double remapSeconds = 0.0;
+        double totalSeconds = 0.0;
+
+        double verticesPerSecond() const { return totalSeconds > 0.0 ? verticesBefore / totalSeconds : 0.0; }
+    };
+
+    namespace MeshWeld {
+        constexpr uint32_t EMPTY = UINT32_MAX;
+
+        inline uint32_t hash_cell(const ivec3 &c) {
+            uint32_t h = (uint32_t)c.x * 73856093u ^ (uint32_t)c.y * 19349663u ^ (uint32_t)c.z * 83492791u;
+            // Finalizer so the low bits (table slot) and high bits (partition) are both well mixed
+            h ^= h >> 16;
+            h *= 0x85ebca6bu;
+            h ^= h >> 13;
+            return h;
+        }
+
+        // floor(v) as a cell coordinate, clamped to the int range (and NaN to 0) instead of overflowing
+        inline int cell_coord(float v) {
+            const float c = std::floor(v);
+            return c == c ? (int)std::clamp(c, -2147483520.0f, 2147483520.0f) : 0;
+        }
+    }
+
+    /**
+     * @brief Find duplicate vertices: positions are snapped to a grid of cell size epsilon and vertices
+     *        in the same cell are merged into the first of them. Note two points closer than epsilon
+     *        but on either side of a cell boundary are not merged, and cell coordinates are clamped to
+     *        the int range (positions beyond 2^31 * epsilon share the edge cells)
+     *
+     *        Runs in parallel: vertices are bucketed by hash partition, each thread walks the bucket of
+     *        its partition and dedups it in its own flat open addressing (linear probing) table,
+     *        so no locking is needed and the result is the same as single threaded
+     *
+     * @param remap Output, vertexCount entries: new (compacted) index of each vertex, apply it with
+     *        remapIndices / remapVertices from mesh_optimize.h
+     * @param positions Vertex positions
+     * @param vertexCount Number of vertices
+     * @param epsilon Grid cell size
+     * @param threads Number of threads, 0 = hardwareThreadCount()
+     * @param stats Optional output stats
+     * @return std::size_t Number of unique vertices
+     */
+    inline std::size_t weldVertices(uint32_t * remap, const vec3 * positions, std::size_t vertexCount,
+            float epsilon, unsigned threads = 0, WeldStats * stats = nullptr) {
+        using namespace MeshWeld;
+        auto start = std::chrono::steady_clock::now();
+        const auto totalStart = start;
+        WeldStats result;
+        result.verticesBefore = vertexCount;
+        if (!threads) threads = hardwareThreadCount();
+        threads = (unsigned)std::clamp<std::size_t>(vertexCount / 16384, 1, threads);
+        result.threads = threads;
+
+        // Quantize + hash
+        const float inv = epsilon > 0.0f ? 1.0f / epsilon : 1.0f;
+        std::vector<ivec3> cells(vertexCount);
+        std::vector<uint32_t> hashes(vertexCount);
+        parallelFor(0, vertexCount, [&](std::size_t begin, std::size_t end, unsigned) {
+            for (std::size_t v = begin; v < end; v++) {
+                const vec3 &p = positions[v];
+                cells[v] = ivec3(cell_coord(p.x * inv), cell_coord(p.y * inv), cell_coord(p.z * inv));
+                hashes[v] = hash_cell(cells[v]);
+            }
+        }, threads);
+        result.quantizeSeconds = secondsSince(start);
+
+        // Each thread dedups the vertices whose hash falls in its partition, remap[v] = first vertex in the cell
+        start = std::chrono::steady_clock::now();
+        std::vector<std::size_t> partitionSizes(threads, 0);
+        for (std::size_t v = 0; v < vertexCount; v++)
+            partitionSizes[(uint64_t)hashes[v] * threads >> 32]++;
+
+        // Bucket the vertices by partition (counting sort, stable so each bucket stays in vertex order)
+        std::vector<std::size_t> partitionStart(threads + 1, 0);
+        for (unsigned part = 0; part < threads; part++) partitionStart[part + 1] = partitionStart[part] + partitionSizes[part];
+        std::vector<uint32_t> order(vertexCount);
+        {
+            std::vector<std::size_t> cursor(partitionStart.begin(), partitionStart.end() - 1);
+            for (std::size_t v = 0; v < vertexCount; v++) order[cursor[(uint64_t)hashes[v] * threads >> 32]++] = (uint32_t)v;
+        }
+
+        std::vector<std::size_t> maxProbes(threads, 0);
+        parallelFor(0, threads, [&](std::size_t begin, std::size_t end, unsigned) {
+            for (std::size_t part = begin; part < end; part++) {
+                std::size_t capacity = 16;
+                while (capacity < partitionSizes[part] * 2) capacity <<= 1;
+                const std::size_t mask = capacity - 1;
+                std::vector<uint32_t> table(capacity, EMPTY);
+
+                for (std::size_t k = partitionStart[part]; k < partitionStart[part + 1]; k++) {
+                    const uint32_t v = order[k];
+                    const uint32_t h = hashes[v];
+
+                    std::size_t slot = h & mask, probe = 0;
+                    while (true) {
+                        const uint32_t other = table[slot];
+                        if (other == EMPTY) {
+                            table[slot] = v;
+                            remap[v] = v;
+                            break;
+                        }
+                        if (hashes[other] == h && cells[other] == cells[v]) {
+                            remap[v] = other;
+                            break;
+                        }
+                        slot = (slot + 1) & mask;
+                        probe++;
+                    }
+                    maxProbes[part] = std::max(maxProbes[part], probe);
+                }
+            }
+        }, threads, 1);
+        result.maxProbe = *std::max_element(maxProbes.begin(), maxProbes.end());
+        result.weldSeconds = secondsSince(start);
+
+        // Compact: unique vertices keep their relative order, duplicates point to their first vertex's new index
+        start = std::chrono::steady_clock::now();
+        uint32_t next = 0;
+        for (std::size_t v = 0; v < vertexCount; v++)
+            remap[v] = remap[v] == v ? next++ : remap[remap[v]];
+        result.verticesAfter = next;
+        result.remapSeconds = secondsSince(start);
+
+        result.totalSeconds = secondsSince(totalStart);
+        if (stats) *stats = result;
+        return next;
+    }
+
+    /**
+     * @brief Weld a position-only mesh in place, see weldVertices()
+     * @param positions Positions, compacted to the unique vertices
+     * @param indices Indices, remapped in place. If empty, the mesh is treated as an unindexed
+     *        triangle list and indices are generated
+     * @param epsilon Grid cell size
+     * @param threads Number of threads, 0 = hardwareThreadCount()
+     * @return WeldStats
+     */
+    inline WeldStats weldMesh(std::vector<vec3> &positions, std::vector<uint32_t> &indices, float epsilon, unsigned threads = 0) {
+        WeldStats stats;
+        std::vector<uint32_t> remap(positions.size());
+        const std::size_t unique = weldVertices(remap.data(), positions.data(), positions.size(), epsilon, threads, &stats);
+
+        const auto start = std::chrono::steady_clock::now();
+        if (indices.empty()) {
+            indices.resize(positions.size());
+            for (std::size_t i = 0; i < indices.size(); i++) indices[i] = (uint32_t)i;
+        }
+        parallelFor(0, indices.size(), [&](std::size_t begin, std::size_t end, unsigned) {
+            for (std::size_t i = begin; i < end; i++) indices[i] = remap[indices[i]];
+        }, stats.threads);
+
+        // New indices of unique vertices are increasing, so compacting in place never overwrites an unread one
+        uint32_t next = 0;
+        for (std::size_t v = 0; v < positions.size(); v++)
+            if (remap[v] == next) positions[next++] = positions[v];
+        positions.resize(unique);
+        const double seconds = secondsSince(start);
+        stats.remapSeconds += seconds;
+        stats.totalSeconds += seconds;
+        return stats;
+    }
+}
+
+#endif
@@ -0,0 +1,325 @@
+#ifndef BOWSER_UTIL_MESHLET_H
+#define BOWSER_UTIL_MESHLET_H
+
+#include "stdint.h"
+#include "types/vector.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace bowser_util {
+    // Ranges into MeshletData::vertices / triangles
+    struct Meshlet {
+        uint32_t vertexOffset;
+        uint32_t triangleOffset;   // In bytes of MeshletData::triangles (3 per triangle)
+        uint32_t vertexCount;
+        uint32_t triangleCount;
+    };
+
+    /**
+     * @brief Culling bounds of a meshlet
+     * Sphere: cull if outside the frustum
+     * Cone: cull (all triangles backfacing) if dot(normalize(coneApex - cameraPos), coneAxis) >= coneCutoff
+     */
+    struct MeshletBounds {
+        vec3 center;
+        float radius;
+        vec3 coneApex;
+        vec3 coneAxis;
+        float coneCutoff; // > 1 if the cone is too wide to ever cull
+    };
+
+    struct MeshletData {
+        std::vector<Meshlet> meshlets;
+        std::vector<MeshletBounds> bounds;
+        std::vector<uint32_t> vertices; // Meshlet local vertex -> mesh vertex
+        std::vector<uint8_t> triangles; // Meshlet local indices, 3 per triangle
+
+        // Bytes of the meshlet data (meshlets + vertex remap + local triangles), bounds not included
+        std::size_t bytes() const {
+            return meshlets.size() * sizeof(Meshlet) + vertices.size() * sizeof(uint32_t) + triangles.size();
+        }
+    };
+
+    /**
+     * @brief Build stats of buildMeshlets()
+     */
+    struct MeshletStats {
+        std::size_t meshlets = 0;
+        float avgVertices = 0.0f;
+        float avgTriangles = 0.0f;
+        std::size_t indexBytes = 0;   // Size of the source 32-bit index buffer
+        std::size_t meshletBytes = 0; // MeshletData::bytes()
+        double seconds = 0.0;
+    };
+
+    namespace Meshlets {
+        // Approximate bounding sphere (Ritter): start from the most distant pair of axis extremes, then grow
+        inline void bounding_sphere(const vec3 * positions, const uint32_t * vertices, std::size_t count, vec3 &center, float &radius) {
+            auto component = [](const vec3 &p, int axis) { return axis == 0 ? p.x : axis == 1 ? p.y : p.z; };
+            std::size_t lo[3] = {0, 0, 0}, hi[3] = {0, 0, 0};
+            for (std::size_t i = 1; i < count; i++) {
+                const vec3 &p = positions[vertices[i]];
+                for (int axis = 0; axis < 3; axis++) {
+                    if (component(p, axis) < component(positions[vertices[lo[axis]]], axis)) lo[axis] = i;
+                    if (component(p, axis) > component(positions[vertices[hi[axis]]], axis)) hi[axis] = i;
+                }
+            }
+            int best = 0;
+            float bestDist = -1.0f;
+            for (int axis = 0; axis < 3; axis++) {
+                const float d = (positions[vertices[hi[axis]]] - positions[vertices[lo[axis]]]).lengthSqr();
+                if (d > bestDist) {
+                    bestDist = d;
+                    best = axis;
+                }
+            }
+            const vec3 &a = positions[vertices[lo[best]]], &b = positions[vertices[hi[best]]];
+            center = (a + b) * 0.5f;
+            radius = (b - a).length() * 0.5f;
+
+            for (std::size_t i = 0; i < count; i++) {
+                const vec3 &p = positions[vertices[i]];
+                const float d = (p - center).length();
+                if (d > radius) {
+                    const float grow = (d - radius) * 0.5f;
+                    radius += grow;
+                    center += (p - center) * (grow / d);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Compute the bounding sphere and normal cone of a meshlet
+     * @param data Meshlet data
+     * @param m Meshlet
+     * @param positions Vertex positions of the mesh
+     * @return MeshletBounds
+     */
+    inline MeshletBounds computeMeshletBounds(const MeshletData &data, const Meshlet &m, const vec3 * positions) {
+        MeshletBounds b;
+        Meshlets::bounding_sphere(positions, data.vertices.data() + m.vertexOffset, m.vertexCount, b.center, b.radius);
+
+        // Cone axis = average triangle normal, spread = smallest cos(angle) to any normal
+        const uint32_t * verts = data.vertices.data() + m.vertexOffset;
+        const uint8_t * tris = data.triangles.data() + m.triangleOffset;
+        vec3 axis(0.0f);
+        std::vector<vec3> normals(m.triangleCount);
+        for (uint32_t t = 0; t < m.triangleCount; t++) {
+            const vec3 &p0 = positions[verts[tris[t * 3]]], &p1 = positions[verts[tris[t * 3 + 1]]], &p2 = positions[verts[tris[t * 3 + 2]]];
+            vec3 n = (p1 - p0).cross(p2 - p0);
+            const float len = n.length();
+            normals[t] = len > 0.0f ? n / len : vec3(0.0f);
+            axis += normals[t];
+        }
+        const float axisLen = axis.length();
+        axis = axisLen > 0.0f ? axis / axisLen : vec3(0.0f, 0.0f, 1.0f);
+
+        float minDot = 1.0f;
+        for (const vec3 &n : normals)
+            if (n.lengthSqr() > 0.0f) minDot = std::min(minDot, n.dot(axis));
+
+        b.coneAxis = axis;
+        b.coneApex = b.center;
+        if (minDot <= 0.1f || axisLen == 0.0f) {
+            b.coneCutoff = 2.0f; // Normals spread over (nearly) a hemisphere, never cull
+            return b;
+        }
+
+        // Apex: the point along the axis behind every triangle's plane
+        float apexT = INFINITY;
+        for (uint32_t t = 0; t < m.triangleCount; t++) {
+            if (normals[t].lengthSqr() == 0.0f) continue;
+            const vec3 &p0 = positions[verts[tris[t * 3]]];
+            apexT = std::min(apexT, (p0 - b.center).dot(normals[t]) / axis.dot(normals[t]));
+        }
+        if (std::isfinite(apexT)) b.coneApex = b.center + axis * apexT;
+        b.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+        return b;
+    }
+
+    /**
+     * @brief Split a triangle list into meshlets of at most maxVertices vertices and maxTriangles triangles,
+     *        triangles are taken in index order so optimize the vertex cache order first (mesh_optimize.h)
+     *        for tight, well-connected meshlets
+     * @param data Output meshlets (cleared first), with bounds
+     * @param indices Triangle list indices
+     * @param indexCount Number of indices
+     * @param positions Vertex positions
+     * @param vertexCount Number of vertices
+     * @param maxVertices Max unique vertices per meshlet (at most 256)
+     * @param maxTriangles Max triangles per meshlet
+     * @return MeshletStats
+     */
+    inline MeshletStats buildMeshlets(MeshletData &data, const uint32_t * indices, std::size_t indexCount,
+            const vec3 * positions, std::size_t vertexCount, uint32_t maxVertices = 64, uint32_t maxTriangles = 124) {
+        const auto start = std::chrono::steady_clock::now();
+        data = MeshletData{};
+        maxVertices = std::clamp<uint32_t>(maxVertices, 3, 256);
+        maxTriangles = std::max<uint32_t>(maxTriangles, 1);
+
+        // Local index of each mesh vertex in the current meshlet, valid if stamp == meshlet number
+        std::vector<uint8_t> local(vertexCount);
+        std::vector<uint32_t> stamp(vertexCount, UINT32_MAX);
+        Meshlet current{ 0, 0, 0, 0 };
+
+        auto flush = [&]() {
+            if (!current.triangleCount) return;
+            data.meshlets.push_back(current);
+            current = Meshlet{ (uint32_t)data.vertices.size(), (uint32_t)data.triangles.size(), 0, 0 };
+        };
+
+        for (std::size_t i = 0; i + 2 < indexCount; i += 3) {
+            const uint32_t id = (uint32_t)data.meshlets.size();
+            const uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+            const uint32_t added = (stamp[a] != id) + (stamp[b] != id && b != a) + (stamp[c] != id && c != a && c != b);
+            if (current.vertexCount + added > maxVertices || current.triangleCount + 1 > maxTriangles) flush();
+
+            const uint32_t meshletId = (uint32_t)data.meshlets.size();
+            for (int k = 0; k < 3; k++) {
+                const uint32_t v = indices[i + k];
+                if (stamp[v] != meshletId) {
+                    stamp[v] = meshletId;
+                    local[v] = (uint8_t)current.vertexCount++;
+                    data.vertices.push_back(v);
+                }
+                data.triangles.push_back(local[v]);
+            }
+            current.triangleCount++;
+        }
+        flush();
+
+        data.bounds.reserve(data.meshlets.size());
+        for (const Meshlet &m : data.meshlets)
+            data.bounds.push_back(computeMeshletBounds(data, m, positions));
+
+        MeshletStats stats;
+        stats.meshlets = data.meshlets.size();
+        if (stats.meshlets) {
+            stats.avgVertices = (float)data.vertices.size() / stats.meshlets;
+            stats.avgTriangles = (float)(data.triangles.size() / 3) / stats.meshlets;
+        }
+        stats.indexBytes = indexCount * sizeof(uint32_t);
+        stats.meshletBytes = data.bytes();
+        stats.seconds = secondsSince(start);
+        return stats;
+    }
+
+    /**
+     * @brief Test meshlet bounds against a camera position (cone backface test)
+     * @return true if every triangle of the meshlet faces away from the camera
+     */
+    inline bool meshletBackfacing(const MeshletBounds &b, const vec3 &cameraPos) {
+        const vec3 dir = b.coneApex - cameraPos;
+        const float len = dir.length();
+        return len > 0.0f && dir.dot(b.coneAxis) >= b.coneCutoff * len;
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // Quantized vertex formats
+    // ---------------------------------------------------------------------------------------------
+
+    /**
+     * @brief 12 byte vertex: position as unorm16 in the mesh bounding box, normal as octahedral snorm16
+     * Decode in the vertex shader with
+     *     position = offset + vec3(pos.xyz) / 65535.0 * scale
+     *     normal = decodeOctahedral(vec2(normal) / 32767.0)
+     * ie attributes GL_UNSIGNED_SHORT x3 (normalized) and GL_SHORT x2 (normalized)
+     */
+    struct QuantizedVertex {
+        uint16_t pos[3];
+        int16_t normal[2];
+        uint16_t pad;
+    };
+
+    /**
+     * @brief Dequantization parameters of quantizePositions()
+     */
+    struct QuantizeParams {
+        vec3 offset; // Min corner of the bounding box
+        vec3 scale;  // Size of the bounding box
+    };
+
+    /**
+     * @brief Encode a unit vector with octahedral mapping
+     * @param n Normalized vector
+     * @return vec2 in [-1, 1]^2
+     */
+    inline vec2 encodeOctahedral(const vec3 &n) {
+        const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        vec2 p = l1 > 0.0f ? vec2(n.x / l1, n.y / l1) : vec2(0.0f);
+        if (n.z < 0.0f) {
+            p = vec2((1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+                     (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+        }
+        return p;
+    }
+
+    // Inverse of encodeOctahedral, returns a normalized vector
+    inline vec3 decodeOctahedral(const vec2 &e) {
+        vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+        const float t = std::max(-n.z, 0.0f);
+        n.x += n.x >= 0.0f ? -t : t;
+        n.y += n.y >= 0.0f ? -t : t;
+        return n / n.length();
+    }
+
+    inline int16_t quantizeSnorm16(float v) {
+        return (int16_t)std::lround(std::clamp(v, -1.0f, 1.0f) * 32767.0f);
+    }
+    inline uint16_t quantizeUnorm16(float v) {
+        return (uint16_t)std::lround(std::clamp(v, 0.0f, 1.0f) * 65535.0f);
+    }
+
+    /**
+     * @brief Quantize positions and normals into 12 byte vertices (vs 24 bytes for float position + normal)
+     * @param dst Output, vertexCount vertices
+     * @param positions Positions
+     * @param normals Normals (normalized), may be nullptr
+     * @param vertexCount Number of vertices
+     * @return QuantizeParams Offset / scale to decode positions with
+     */
+    inline QuantizeParams quantizeVertices(QuantizedVertex * dst, const vec3 * positions, const vec3 * normals, std::size_t vertexCount) {
+        QuantizeParams params{ vec3(0.0f), vec3(0.0f) };
+        if (!vertexCount) return params;
+
+        vec3 lo = positions[0], hi = positions[0];
+        for (std::size_t v = 1; v < vertexCount; v++) {
+            const vec3 &p = positions[v];
+            lo = vec3(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+            hi = vec3(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+        }
+        params.offset = lo;
+        params.scale = hi - lo;
+        const vec3 inv(params.scale.x > 0.0f ? 1.0f / params.scale.x : 0.0f,
+                       params.scale.y > 0.0f ? 1.0f / params.scale.y : 0.0f,
+                       params.scale.z > 0.0f ? 1.0f / params.scale.z : 0.0f);
+
+        for (std::size_t v = 0; v < vertexCount; v++) {
+            const vec3 p = positions[v] - lo;
+            QuantizedVertex &q = dst[v];
+            q.pos[0] = quantizeUnorm16(p.x * inv.x);
+            q.pos[1] = quantizeUnorm16(p.y * inv.y);
+            q.pos[2] = quantizeUnorm16(p.z * inv.z);
+            const vec2 oct = normals ? encodeOctahedral(normals[v]) : vec2(0.0f);
+            q.normal[0] = quantizeSnorm16(oct.x);
+            q.normal[1] = quantizeSnorm16(oct.y);
+            q.pad = 0;
+        }
+        return params;
+    }
+
+    // Decode a quantized vertex on the CPU (ie to measure the quantization error)
+    inline void dequantizeVertex(const QuantizedVertex &q, const QuantizeParams &params, vec3 &position, vec3 &normal) {
+        position = params.offset + vec3(q.pos[0] / 65535.0f * params.scale.x,
+                                        q.pos[1] / 65535.0f * params.scale.y,
+                                        q.pos[2] / 65535.0f * params.scale.z);
+        normal = decodeOctahedral(vec2(q.normal[0] / 32767.0f, q.normal[1] / 32767.0f));
+    }
+}
+
+#endif
@@ -28,6 +28,18 @@ namespace bowser_util {
     inline uint32_t morton_decode8(uint8_t x, uint8_t y, uint8_t z) {
         return Morton::X_SHIFTS[x] | Morton::Y_SHIFTS[y] | Morton::Z_SHIFTS[z];
     }
+
+    /**
+     * @brief Generate morton code for 3 16-bit unsigned coordinate values (48 bits),
+     *        one table lookup per byte like morton_decode8. For 2D codes pass z = 0
+     * @param x X coordinate
+     * @param y Y coordinate
+     * @param z Z coordinate
+     * @return uint64_t Morton code
+     */
+    inline uint64_t morton_encode16(uint16_t x, uint16_t y, uint16_t z) {
+        return (uint64_t)morton_decode8(x >> 8, y >> 8, z >> 8) << 24 | morton_decode8(x & 0xFF, y & 0xFF, z & 0xFF);
+    }
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,73 @@
+#ifndef BOWSER_UTIL_PARALLEL_H
+#define BOWSER_UTIL_PARALLEL_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace bowser_util {
+    // Seconds elapsed since start, for the timing stats of the bulk kernels
+    inline double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // max(x, 0) without a compare, selects block vectorization under the default -ftrapping-math
+    inline float positivePart(float x) { return 0.5f * (x + std::fabs(x)); }
+
+    // sqrt only vectorizes with -fno-math-errno (it has to set errno for negative inputs), so vectorized
+    // kernels take their square roots in a loop of their own instead of blocking the loops around them
+    inline void sqrtInPlace(float * values, std::size_t n) {
+        for (std::size_t i = 0; i < n; i++) values[i] = std::sqrt(values[i]);
+    }
+
+    // Number of hardware threads, at least 1
+    inline unsigned hardwareThreadCount() {
+        const unsigned n = std::thread::hardware_concurrency();
+        return n ? n : 1;
+    }
+
+    /**
+     * @brief Split [begin, end) into contiguous ranges and run func on each range in its own thread
+     *        (the calling thread runs the last range), returns once all ranges are done
+     *
+     * Example:
+     * parallelFor(0, points.size(), [&](std::size_t start, std::size_t end, unsigned thread) {
+     *     for (std::size_t i = start; i < end; i++) points[i] *= 2.0f;
+     * });
+     *
+     * @param begin First index
+     * @param end One past the last index
+     * @param func void(std::size_t rangeBegin, std::size_t rangeEnd, unsigned threadIndex)
+     * @param threads Number of threads to use, 0 = hardwareThreadCount()
+     * @param minRange Don't split into ranges smaller than this (avoids spawning threads for tiny loops)
+     */
+    template <class F>
+    void parallelFor(std::size_t begin, std::size_t end, F &&func, unsigned threads = 0, std::size_t minRange = 1024) {
+        if (end <= begin) return;
+        const std::size_t count = end - begin;
+        if (!threads) threads = hardwareThreadCount();
+        threads = (unsigned)std::min<std::size_t>(threads, std::max<std::size_t>(count / std::max<std::size_t>(minRange, 1), 1));
+
+        if (threads == 1) {
+            func(begin, end, 0u);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        const std::size_t step = count / threads, extra = count % threads;
+        std::size_t start = begin;
+        for (unsigned t = 0; t < threads; t++) {
+            const std::size_t stop = start + step + (t < extra ? 1 : 0);
+            if (t + 1 == threads) func(start, stop, t);
+            else workers.emplace_back([&func, start, stop, t]() { func(start, stop, t); });
+            start = stop;
+        }
+        for (auto &worker : workers) worker.join();
+    }
+}
+
+#endif
@@ -0,0 +1,708 @@
+#ifndef BOWSER_UTIL_PHYSICS2D_H
+#define BOWSER_UTIL_PHYSICS2D_H
+
+#include "stdint.h"
+#include "types/vector.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <numbers>
+#include <numeric>
+#include <vector>
+
+namespace bowser_util {
+    /**
+     * @brief Stats of the last PhysicsWorld2D::step()
+     */
+    struct Physics2DStats {
+        std::size_t bodies = 0;
+        std::size_t pairs = 0;      // Broadphase AABB overlaps
+        std::size_t contacts = 0;   // Contact points
+        std::size_t islands = 0;
+        unsigned threads = 0;
+        double broadphaseSeconds = 0.0;
+        double narrowphaseSeconds = 0.0;
+        double solveSeconds = 0.0;
+        double totalSeconds = 0.0;
+
+        double bodiesPerMs() const { return totalSeconds > 0.0 ? bodies / (totalSeconds * 1000.0) : 0.0; }
+    };
+
+    namespace Physics2D {
+        enum Shape : uint8_t { CIRCLE, BOX };
+
+        // Box edges / features for contact ids (Box2D Lite numbering), NO_EDGE = clipped by nothing
+        enum Edge : uint8_t { NO_EDGE, EDGE1, EDGE2, EDGE3, EDGE4 };
+
+        struct ClipVertex {
+            vec2 v;
+            uint8_t inEdge1 = NO_EDGE, outEdge1 = NO_EDGE, inEdge2 = NO_EDGE, outEdge2 = NO_EDGE;
+
+            uint16_t feature() const { return (uint16_t)(inEdge1 | outEdge1 << 3 | inEdge2 << 6 | outEdge2 << 9); }
+            void flip() {
+                std::swap(inEdge1, inEdge2);
+                std::swap(outEdge1, outEdge2);
+            }
+        };
+
+        struct ContactPoint {
+            vec2 position;
+            float separation;
+            uint16_t feature;
+        };
+
+        struct Rot {
+            float c, s;
+            vec2 col1() const { return vec2(c, s); }
+            vec2 col2() const { return vec2(-s, c); }
+            vec2 mul(const vec2 &v) const { return vec2(c * v.x - s * v.y, s * v.x + c * v.y); }
+            vec2 mulT(const vec2 &v) const { return vec2(c * v.x + s * v.y, -s * v.x + c * v.y); }
+        };
+
+        inline float cross(const vec2 &a, const vec2 &b) { return a.x * b.y - a.y * b.x; }
+        inline vec2 cross(float w, const vec2 &r) { return vec2(-w * r.y, w * r.x); }
+
+        inline int clip_segment(ClipVertex out[2], const ClipVertex in[2], const vec2 &normal, float offset, uint8_t clipEdge) {
+            int count = 0;
+            const float d0 = normal.dot(in[0].v) - offset, d1 = normal.dot(in[1].v) - offset;
+            if (d0 <= 0.0f) out[count++] = in[0];
+            if (d1 <= 0.0f) out[count++] = in[1];
+            if (d0 * d1 < 0.0f) {
+                out[count].v = in[0].v + (in[1].v - in[0].v) * (d0 / (d0 - d1));
+                if (d0 > 0.0f) {
+                    out[count] = ClipVertex{ out[count].v, clipEdge, in[0].outEdge1, NO_EDGE, in[0].outEdge2 };
+                } else {
+                    out[count] = ClipVertex{ out[count].v, in[1].inEdge1, clipEdge, in[1].inEdge2, NO_EDGE };
+                }
+                count++;
+            }
+            return count;
+        }
+
+        inline void incident_edge(ClipVertex c[2], const vec2 &h, const vec2 &pos, const Rot &rot, const vec2 &normal) {
+            const vec2 n = rot.mulT(normal) * -1.0f;
+            if (std::abs(n.x) > std::abs(n.y)) {
+                if (n.x > 0.0f) {
+                    c[0] = ClipVertex{ vec2(h.x, -h.y), NO_EDGE, NO_EDGE, EDGE3, EDGE4 };
+                    c[1] = ClipVertex{ vec2(h.x, h.y), NO_EDGE, NO_EDGE, EDGE4, EDGE1 };
+                } else {
+                    c[0] = ClipVertex{ vec2(-h.x, h.y), NO_EDGE, NO_EDGE, EDGE1, EDGE2 };
+                    c[1] = ClipVertex{ vec2(-h.x, -h.y), NO_EDGE, NO_EDGE, EDGE2, EDGE3 };
+                }
+            } else {
+                if (n.y > 0.0f) {
+                    c[0] = ClipVertex{ vec2(h.x, h.y), NO_EDGE, NO_EDGE, EDGE4, EDGE1 };
+                    c[1] = ClipVertex{ vec2(-h.x, h.y), NO_EDGE, NO_EDGE, EDGE1, EDGE2 };
+                } else {
+                    c[0] = ClipVertex{ vec2(-h.x, -h.y), NO_EDGE, NO_EDGE, EDGE2, EDGE3 };
+                    c[1] = ClipVertex{ vec2(h.x, -h.y), NO_EDGE, NO_EDGE, EDGE3, EDGE4 };
+                }
+            }
+            c[0].v = pos + rot.mul(c[0].v);
+            c[1].v = pos + rot.mul(c[1].v);
+        }
+
+        // Box vs box: SAT to pick the reference face, then clip the incident edge against it (Box2D Lite)
+        // normal points from A to B
+        inline int collide_boxes(ContactPoint out[2], vec2 &normal, const vec2 &posA, const Rot &rotA, const vec2 &hA,
+                const vec2 &posB, const Rot &rotB, const vec2 &hB) {
+            const vec2 dp = posB - posA;
+            const vec2 dA = rotA.mulT(dp), dB = rotB.mulT(dp);
+            const float c = std::abs(rotA.c * rotB.c + rotA.s * rotB.s), s = std::abs(rotA.c * rotB.s - rotA.s * rotB.c);
+
+            const vec2 faceA(std::abs(dA.x) - hA.x - (c * hB.x + s * hB.y), std::abs(dA.y) - hA.y - (s * hB.x + c * hB.y));
+            const vec2 faceB(std::abs(dB.x) - (c * hA.x + s * hA.y) - hB.x, std::abs(dB.y) - (s * hA.x + c * hA.y) - hB.y);
+            if (faceA.x > 0.0f || faceA.y > 0.0f || faceB.x > 0.0f || faceB.y > 0.0f) return 0;
+
+            // Prefer faces of A, then by separation with some tolerance so the reference face doesn't flip flop
+            constexpr float relativeTol = 0.95f, absoluteTol = 0.01f;
+            int axis = 0;
+            float separation = faceA.x;
+            normal = dA.x > 0.0f ? rotA.col1() : rotA.col1() * -1.0f;
+            if (faceA.y > relativeTol * separation + absoluteTol * hA.y) {
+                axis = 1;
+                separation = faceA.y;
+                normal = dA.y > 0.0f ? rotA.col2() : rotA.col2() * -1.0f;
+            }
+            if (faceB.x > relativeTol * separation + absoluteTol * hB.x) {
+                axis = 2;
+                separation = faceB.x;
+                normal = dB.x > 0.0f ? rotB.col1() : rotB.col1() * -1.0f;
+            }
+            if (faceB.y > relativeTol * separation + absoluteTol * hB.y) {
+                axis = 3;
+                normal = dB.y > 0.0f ? rotB.col2() : rotB.col2() * -1.0f;
+            }
+
+            vec2 frontNormal, sideNormal;
+            float front, negSide, posSide;
+            uint8_t negEdge, posEdge;
+            ClipVertex incident[2];
+            const bool faceOfA = axis < 2;
+            const vec2 &refPos = faceOfA ? posA : posB, &refH = faceOfA ? hA : hB;
+            const Rot &refRot = faceOfA ? rotA : rotB;
+            frontNormal = faceOfA ? normal : normal * -1.0f;
+            if (axis % 2 == 0) {
+                front = refPos.dot(frontNormal) + refH.x;
+                sideNormal = refRot.col2();
+                const float side = refPos.dot(sideNormal);
+                negSide = -side + refH.y;
+                posSide = side + refH.y;
+                negEdge = EDGE3;
+                posEdge = EDGE1;
+            } else {
+                front = refPos.dot(frontNormal) + refH.y;
+                sideNormal = refRot.col1();
+                const float side = refPos.dot(sideNormal);
+                negSide = -side + refH.x;
+                posSide = side + refH.x;
+                negEdge = EDGE2;
+                posEdge = EDGE4;
+            }
+            if (faceOfA) incident_edge(incident, hB, posB, rotB, frontNormal);
+            else incident_edge(incident, hA, posA, rotA, frontNormal);
+
+            ClipVertex clip1[2], clip2[2];
+            if (clip_segment(clip1, incident, sideNormal * -1.0f, negSide, negEdge) < 2) return 0;
+            if (clip_segment(clip2, clip1, sideNormal, posSide, posEdge) < 2) return 0;
+
+            int count = 0;
+            for (int i = 0; i < 2; i++) {
+                const float sep = frontNormal.dot(clip2[i].v) - front;
+                if (sep > 0.0f) continue;
+                if (!faceOfA) clip2[i].flip();
+                out[count++] = ContactPoint{ clip2[i].v - frontNormal * sep, sep, clip2[i].feature() };
+            }
+            return count;
+        }
+
+        // Box (A) vs circle (B), normal points from A to B
+        inline int collide_box_circle(ContactPoint out[1], vec2 &normal, const vec2 &posA, const Rot &rotA, const vec2 &hA,
+                const vec2 &posB, float radius) {
+            const vec2 local = rotA.mulT(posB - posA);
+            const vec2 closest(std::clamp(local.x, -hA.x, hA.x), std::clamp(local.y, -hA.y, hA.y));
+            vec2 localNormal, surface = closest;
+            float separation;
+            if (closest == local) {
+                // Center inside the box, push out through the nearest face
+                const float dx = hA.x - std::abs(local.x), dy = hA.y - std::abs(local.y);
+                if (dx < dy) {
+                    localNormal = vec2(local.x < 0.0f ? -1.0f : 1.0f, 0.0f);
+                    surface.x = localNormal.x * hA.x;
+                    separation = -dx - radius;
+                } else {
+                    localNormal = vec2(0.0f, local.y < 0.0f ? -1.0f : 1.0f);
+                    surface.y = localNormal.y * hA.y;
+                    separation = -dy - radius;
+                }
+            } else {
+                const vec2 d = local - closest;
+                const float dist = d.length();
+                separation = dist - radius;
+                if (separation > 0.0f) return 0;
+                localNormal = d / dist;
+            }
+            normal = rotA.mul(localNormal);
+            out[0] = ContactPoint{ posA + rotA.mul(surface) + normal * (0.5f * separation), separation, 0 };
+            return 1;
+        }
+
+        inline int collide_circles(ContactPoint out[1], vec2 &normal, const vec2 &posA, float rA, const vec2 &posB, float rB) {
+            const vec2 d = posB - posA;
+            const float dist = d.length();
+            const float separation = dist - rA - rB;
+            if (separation > 0.0f) return 0;
+            normal = dist > 1e-6f ? d / dist : vec2(0.0f, 1.0f);
+            out[0] = ContactPoint{ posA + normal * (rA + 0.5f * separation), separation, 0 };
+            return 1;
+        }
+    }
+
+    /**
+     * @brief 2D rigid body world with boxes and circles
+     *
+     *        - Broadphase: sort and sweep on x over SoA AABBs (insertion sort on last step's order, nearly sorted)
+     *        - Narrowphase: pairs are bucketed by shape, each bucket first runs a branch free overlap / SAT test over
+     *          the whole batch (vectorizable), only the overlapping pairs generate contacts
+     *        - Solver: sequential impulses with warm starting (impulses matched by body pair + contact feature)
+     *          over SoA contact arrays, Baumgarte position correction, Coulomb friction, restitution
+     *        - Bodies touching each other (through dynamic bodies) form islands, islands are solved in parallel
+     *
+     *        Coordinates follow raylib's 2D convention (y down), the default gravity points down the screen
+     */
+    class PhysicsWorld2D {
+    public:
+        using BodyId = uint32_t;
+
+        int velocityIterations = 10;
+        vec2 gravity;
+        float linearDamping = 0.0f;
+        float angularDamping = 0.0f;
+        float allowedPenetration = 0.01f;
+        float biasFactor = 0.2f;
+        float restitutionThreshold = 1.0f;    // Relative normal speed below which restitution is ignored (resting contacts)
+
+        explicit PhysicsWorld2D(const vec2 &gravity = vec2(0.0f, 9.81f)): gravity(gravity) {}
+
+        /**
+         * @brief Add a box
+         * @param position Center
+         * @param halfExtents Half width / height
+         * @param density Mass per area, 0 = static
+         * @param angle Rotation in radians
+         * @return BodyId
+         */
+        BodyId addBox(const vec2 &position, const vec2 &halfExtents, float density = 1.0f, float angle = 0.0f) {
+            const float mass = density * 4.0f * halfExtents.x * halfExtents.y;
+            const float inertia = mass * (halfExtents.x * halfExtents.x + halfExtents.y * halfExtents.y) / 3.0f;
+            return add_body(Physics2D::BOX, position, halfExtents, mass, inertia, angle);
+        }
+
+        /**
+         * @brief Add a circle
+         * @param position Center
+         * @param radius Radius
+         * @param density Mass per area, 0 = static
+         * @return BodyId
+         */
+        BodyId addCircle(const vec2 &position, float radius, float density = 1.0f) {
+            const float mass = density * std::numbers::pi_v<float> * radius * radius;
+            return add_body(Physics2D::CIRCLE, position, vec2(radius, radius), mass, 0.5f * mass * radius * radius, 0.0f);
+        }
+
+        void setVelocity(BodyId body, const vec2 &velocity) { velocities[body] = velocity; }
+        void setAngularVelocity(BodyId body, float w) { angularVelocities[body] = w; }
+        void setPosition(BodyId body, const vec2 &position) { positions[body] = position; }
+        void setAngle(BodyId body, float angle) { angles[body] = angle; }
+        void setFriction(BodyId body, float f) { frictions[body] = f; }
+        void setRestitution(BodyId body, float r) { restitutions[body] = r; }
+
+        // Apply an impulse at a world point
+        void applyImpulse(BodyId body, const vec2 &impulse, const vec2 &point) {
+            velocities[body] += impulse * invMasses[body];
+            angularVelocities[body] += invInertias[body] * Physics2D::cross(point - positions[body], impulse);
+        }
+
+        const vec2 &getPosition(BodyId body) const { return positions[body]; }
+        float getAngle(BodyId body) const { return angles[body]; }
+        const vec2 &getVelocity(BodyId body) const { return velocities[body]; }
+        float getAngularVelocity(BodyId body) const { return angularVelocities[body]; }
+        const vec2 &getHalfExtents(BodyId body) const { return extents[body]; } // Circles: (radius, radius)
+        bool isCircle(BodyId body) const { return shapes[body] == Physics2D::CIRCLE; }
+        bool isStatic(BodyId body) const { return invMasses[body] == 0.0f; }
+        std::size_t size() const { return positions.size(); }
+
+        void clear() {
+            for (auto * v : { &positions, &velocities, &extents }) v->clear();
+            for (auto * v : { &angles, &angularVelocities, &invMasses, &invInertias, &frictions, &restitutions }) v->clear();
+            shapes.clear();
+            order.clear();
+            cacheKeys.clear();
+            cacheImpulses.clear();
+        }
+
+        /**
+         * @brief Advance the simulation
+         * @param dt Time step (fixed steps recommended)
+         * @param threads Number of threads, 0 = hardwareThreadCount()
+         * @return const Physics2DStats& Stats of this step
+         */
+        const Physics2DStats &step(float dt, unsigned threads = 0) {
+            using namespace Physics2D;
+            const auto totalStart = std::chrono::steady_clock::now();
+            stats = Physics2DStats();
+            stats.bodies = size();
+            if (!threads) threads = hardwareThreadCount();
+            stats.threads = threads;
+            if (dt <= 0.0f || !size()) return stats;
+
+            auto start = std::chrono::steady_clock::now();
+            broadphase();
+            stats.pairs = pairA.size();
+            stats.broadphaseSeconds = secondsSince(start);
+
+            start = std::chrono::steady_clock::now();
+            narrowphase();
+            warm_start_match();
+            stats.contacts = contactCount;
+            stats.narrowphaseSeconds = secondsSince(start);
+
+            start = std::chrono::steady_clock::now();
+            build_islands();
+            stats.islands = islandCount;
+            solve(dt, threads);
+            stats.solveSeconds = secondsSince(start);
+
+            stats.totalSeconds = secondsSince(totalStart);
+            return stats;
+        }
+
+        const Physics2DStats &getStats() const { return stats; }
+        std::size_t getContactCount() const { return contactCount; }
+
+    private:
+        // Bodies (SoA)
+        std::vector<vec2> positions, velocities, extents;
+        std::vector<float> angles, angularVelocities, invMasses, invInertias, frictions, restitutions;
+        std::vector<uint8_t> shapes;
+
+        // Per step body scratch
+        std::vector<Physics2D::Rot> rots;
+        std::vector<float> minX, minY, maxX, maxY;
+        std::vector<BodyId> order; // Bodies sorted by minX, kept between steps
+
+        // Broadphase pairs, bucketed by shape (box / circle pairs have the box as A)
+        std::vector<BodyId> pairA, pairB;
+        std::vector<uint32_t> circlePairs, boxCirclePairs, boxPairs;
+        std::vector<float> batchSeparation;
+
+        // Contacts (SoA)
+        std::size_t contactCount = 0;
+        std::vector<BodyId> cA, cB;
+        std::vector<vec2> cNormal, cRA, cRB;
+        std::vector<float> cSeparation, cFriction, cRestitution, cMassNormal, cMassTangent, cBias, cPn, cPt;
+        std::vector<uint64_t> cKey;
+
+        // Warm starting cache, sorted by key
+        std::vector<uint64_t> cacheKeys;
+        std::vector<vec2> cacheImpulses;
+        std::vector<uint32_t> keyOrder;
+
+        // Islands
+        std::vector<uint32_t> unionParent;
+        std::vector<uint32_t> islandOf;
+        std::vector<uint32_t> islandStart, islandContacts, contactIsland;
+        std::size_t islandCount = 0;
+        std::vector<std::vector<uint32_t>> threadIslands;
+
+        Physics2DStats stats;
+
+        BodyId add_body(Physics2D::Shape shape, const vec2 &position, const vec2 &halfExtents, float mass, float inertia, float angle) {
+            const BodyId id = (BodyId)positions.size();
+            shapes.push_back(shape);
+            positions.push_back(position);
+            velocities.push_back(vec2(0.0f));
+            extents.push_back(halfExtents);
+            angles.push_back(angle);
+            angularVelocities.push_back(0.0f);
+            invMasses.push_back(mass > 0.0f ? 1.0f / mass : 0.0f);
+            invInertias.push_back(inertia > 0.0f ? 1.0f / inertia : 0.0f);
+            frictions.push_back(0.5f);
+            restitutions.push_back(0.0f);
+            order.push_back(id);
+            return id;
+        }
+
+        void broadphase() {
+            using namespace Physics2D;
+            const std::size_t n = size();
+            rots.resize(n);
+            minX.resize(n); minY.resize(n); maxX.resize(n); maxY.resize(n);
+            for (std::size_t i = 0; i < n; i++) {
+                rots[i] = Rot{ std::cos(angles[i]), std::sin(angles[i]) };
+                // Box AABB half size = |R| h, circles have c = 1, s = 0 so it's the radius
+                const float c = shapes[i] == BOX ? std::abs(rots[i].c) : 1.0f, s = shapes[i] == BOX ? std::abs(rots[i].s) : 0.0f;
+                const float hx = c * extents[i].x + s * extents[i].y, hy = s * extents[i].x + c * extents[i].y;
+                minX[i] = positions[i].x - hx; maxX[i] = positions[i].x + hx;
+                minY[i] = positions[i].y - hy; maxY[i] = positions[i].y + hy;
+            }
+
+            // Insertion sort, bodies barely move between steps so this is ~linear
+            for (std::size_t i = 1; i < n; i++) {
+                const BodyId body = order[i];
+                const float key = minX[body];
+                std::size_t j = i;
+                while (j > 0 && minX[order[j - 1]] > key) {
+                    order[j] = order[j - 1];
+                    j--;
+                }
+                order[j] = body;
+            }
+
+            pairA.clear();
+            pairB.clear();
+            for (std::size_t i = 0; i < n; i++) {
+                const BodyId a = order[i];
+                const float right = maxX[a];
+                for (std::size_t j = i + 1; j < n && minX[order[j]] <= right; j++) {
+                    const BodyId b = order[j];
+                    if (minY[b] > maxY[a] || maxY[b] < minY[a]) continue;
+                    if (invMasses[a] == 0.0f && invMasses[b] == 0.0f) continue;
+                    pairA.push_back(std::min(a, b));
+                    pairB.push_back(std::max(a, b));
+                }
+            }
+        }
+
+        void narrowphase() {
+            using namespace Physics2D;
+            circlePairs.clear();
+            boxCirclePairs.clear();
+            boxPairs.clear();
+            for (uint32_t p = 0; p < pairA.size(); p++) {
+                const uint8_t sa = shapes[pairA[p]], sb = shapes[pairB[p]];
+                if (sa == CIRCLE && sb == CIRCLE) circlePairs.push_back(p);
+                else if (sa == BOX && sb == BOX) boxPairs.push_back(p);
+                else {
+                    if (sa == CIRCLE) std::swap(pairA[p], pairB[p]); // Box first
+                    boxCirclePairs.push_back(p);
+                }
+            }
+            contactCount = 0;
+
+            // Each bucket: batch overlap test (flat loops over the pairs), then contacts for the overlapping ones
+            ContactPoint points[2];
+            vec2 normal;
+
+            batchSeparation.resize(std::max({ circlePairs.size(), boxCirclePairs.size(), boxPairs.size() }));
+            float * sep = batchSeparation.data();
+
+            for (std::size_t k = 0; k < circlePairs.size(); k++) {
+                const BodyId a = pairA[circlePairs[k]], b = pairB[circlePairs[k]];
+                const float dx = positions[b].x - positions[a].x, dy = positions[b].y - positions[a].y, r = extents[a].x + extents[b].x;
+                sep[k] = dx * dx + dy * dy - r * r;
+            }
+            for (std::size_t k = 0; k < circlePairs.size(); k++) {
+                if (sep[k] > 0.0f) continue;
+                const BodyId a = pairA[circlePairs[k]], b = pairB[circlePairs[k]];
+                const int count = collide_circles(points, normal, positions[a], extents[a].x, positions[b], extents[b].x);
+                add_contacts(a, b, normal, points, count);
+            }
+
+            for (std::size_t k = 0; k < boxCirclePairs.size(); k++) {
+                const BodyId a = pairA[boxCirclePairs[k]], b = pairB[boxCirclePairs[k]];
+                const float dx = positions[b].x - positions[a].x, dy = positions[b].y - positions[a].y;
+                const float lx = rots[a].c * dx + rots[a].s * dy, ly = -rots[a].s * dx + rots[a].c * dy;
+                const float ex = std::max(std::abs(lx) - extents[a].x, 0.0f), ey = std::max(std::abs(ly) - extents[a].y, 0.0f);
+                sep[k] = ex * ex + ey * ey - extents[b].x * extents[b].x;
+            }
+            for (std::size_t k = 0; k < boxCirclePairs.size(); k++) {
+                if (sep[k] > 0.0f) continue;
+                const BodyId a = pairA[boxCirclePairs[k]], b = pairB[boxCirclePairs[k]];
+                const int count = collide_box_circle(points, normal, positions[a], rots[a], extents[a], positions[b], extents[b].x);
+                add_contacts(a, b, normal, points, count);
+            }
+
+            // SAT on the 4 face axes
+            for (std::size_t k = 0; k < boxPairs.size(); k++) {
+                const BodyId a = pairA[boxPairs[k]], b = pairB[boxPairs[k]];
+                const Rot ra = rots[a], rb = rots[b];
+                const vec2 hA = extents[a], hB = extents[b];
+                const float dx = positions[b].x - positions[a].x, dy = positions[b].y - positions[a].y;
+                const float dAx = std::abs(ra.c * dx + ra.s * dy), dAy = std::abs(-ra.s * dx + ra.c * dy);
+                const float dBx = std::abs(rb.c * dx + rb.s * dy), dBy = std::abs(-rb.s * dx + rb.c * dy);
+                const float c = std::abs(ra.c * rb.c + ra.s * rb.s), s = std::abs(ra.c * rb.s - ra.s * rb.c);
+                const float fAx = dAx - hA.x - (c * hB.x + s * hB.y), fAy = dAy - hA.y - (s * hB.x + c * hB.y);
+                const float fBx = dBx - (c * hA.x + s * hA.y) - hB.x, fBy = dBy - (s * hA.x + c * hA.y) - hB.y;
+                sep[k] = std::max(std::max(fAx, fAy), std::max(fBx, fBy));
+            }
+            for (std::size_t k = 0; k < boxPairs.size(); k++) {
+                if (sep[k] > 0.0f) continue;
+                const BodyId a = pairA[boxPairs[k]], b = pairB[boxPairs[k]];
+                const int count = collide_boxes(points, normal, positions[a], rots[a], extents[a], positions[b], rots[b], extents[b]);
+                add_contacts(a, b, normal, points, count);
+            }
+        }
+
+        void add_contacts(BodyId a, BodyId b, const vec2 &normal, const Physics2D::ContactPoint * points, int count) {
+            for (int i = 0; i < count; i++) {
+                if (contactCount == cA.size()) grow_contacts(std::max<std::size_t>(64, cA.size() * 2));
+                const std::size_t c = contactCount++;
+                cA[c] = a;
+                cB[c] = b;
+                cNormal[c] = normal;
+                cRA[c] = points[i].position - positions[a];
+                cRB[c] = points[i].position - positions[b];
+                cSeparation[c] = points[i].separation;
+                cFriction[c] = std::sqrt(frictions[a] * frictions[b]);
+                cRestitution[c] = std::max(restitutions[a], restitutions[b]);
+                cPn[c] = cPt[c] = 0.0f;
+                cKey[c] = (uint64_t)a << 40 | (uint64_t)(b & 0xFFFFFF) << 16 | points[i].feature;
+            }
+        }
+
+        void grow_contacts(std::size_t capacity) {
+            for (auto * v : { &cA, &cB }) v->resize(capacity);
+            for (auto * v : { &cNormal, &cRA, &cRB }) v->resize(capacity);
+            for (auto * v : { &cSeparation, &cFriction, &cRestitution, &cMassNormal, &cMassTangent, &cBias, &cPn, &cPt }) v->resize(capacity);
+            cKey.resize(capacity);
+        }
+
+        // Match this step's contacts with last step's (both sorted by key) to reuse their impulses
+        void warm_start_match() {
+            keyOrder.resize(contactCount);
+            std::iota(keyOrder.begin(), keyOrder.end(), 0u);
+            std::sort(keyOrder.begin(), keyOrder.end(), [&](uint32_t x, uint32_t y) { return cKey[x] < cKey[y]; });
+            std::size_t j = 0;
+            for (uint32_t c : keyOrder) {
+                while (j < cacheKeys.size() && cacheKeys[j] < cKey[c]) j++;
+                if (j < cacheKeys.size() && cacheKeys[j] == cKey[c]) {
+                    cPn[c] = cacheImpulses[j].x;
+                    cPt[c] = cacheImpulses[j].y;
+                }
+            }
+        }
+
+        uint32_t find(uint32_t x) {
+            while (unionParent[x] != x) {
+                unionParent[x] = unionParent[unionParent[x]];
+                x = unionParent[x];
+            }
+            return x;
+        }
+
+        // Union find over contacts between dynamic bodies (static bodies don't join islands), then bucket contacts by island
+        void build_islands() {
+            const std::size_t n = size();
+            unionParent.resize(n);
+            std::iota(unionParent.begin(), unionParent.end(), 0u);
+            for (std::size_t c = 0; c < contactCount; c++) {
+                if (invMasses[cA[c]] == 0.0f || invMasses[cB[c]] == 0.0f) continue;
+                const uint32_t ra = find(cA[c]), rb = find(cB[c]);
+                if (ra != rb) unionParent[std::max(ra, rb)] = std::min(ra, rb);
+            }
+
+            islandOf.assign(n, UINT32_MAX);
+            islandCount = 0;
+            islandStart.assign(1, 0);
+            for (std::size_t c = 0; c < contactCount; c++) {
+                const BodyId body = invMasses[cA[c]] != 0.0f ? cA[c] : cB[c];
+                const uint32_t root = find(body);
+                if (islandOf[root] == UINT32_MAX) {
+                    islandOf[root] = (uint32_t)islandCount++;
+                    islandStart.push_back(0);
+                }
+                islandStart[islandOf[root] + 1]++;
+            }
+            for (std::size_t i = 0; i < islandCount; i++) islandStart[i + 1] += islandStart[i];
+
+            islandContacts.resize(contactCount);
+            std::vector<uint32_t> &cursor = unionParent; // Reuse, roots aren't needed anymore once the islands are numbered
+            contactIsland.resize(contactCount);
+            for (std::size_t c = 0; c < contactCount; c++) {
+                const BodyId body = invMasses[cA[c]] != 0.0f ? cA[c] : cB[c];
+                contactIsland[c] = islandOf[find(body)];
+            }
+            cursor.assign(islandStart.begin(), islandStart.end() - 1);
+            for (std::size_t c = 0; c < contactCount; c++) islandContacts[cursor[contactIsland[c]]++] = (uint32_t)c;
+        }
+
+        // Longest processing time first: biggest islands first, each to the least loaded thread
+        void assign_islands(unsigned threads) {
+            threadIslands.resize(threads);
+            for (auto &list : threadIslands) list.clear();
+            std::vector<uint32_t> islands(islandCount);
+            std::iota(islands.begin(), islands.end(), 0u);
+            auto islandSize = [&](uint32_t i) { return islandStart[i + 1] - islandStart[i]; };
+            std::sort(islands.begin(), islands.end(), [&](uint32_t x, uint32_t y) { return islandSize(x) > islandSize(y); });
+            std::vector<std::size_t> load(threads, 0);
+            for (uint32_t island : islands) {
+                const std::size_t t = std::min_element(load.begin(), load.end()) - load.begin();
+                threadIslands[t].push_back(island);
+                load[t] += islandSize(island);
+            }
+        }
+
+        void solve(float dt, unsigned threads) {
+            using namespace Physics2D;
+            const std::size_t n = size();
+            const float invDt = 1.0f / dt;
+
+            // Integrate forces
+            const float linDamp = 1.0f / (1.0f + dt * linearDamping), angDamp = 1.0f / (1.0f + dt * angularDamping);
+            parallelFor(0, n, [&](std::size_t begin, std::size_t end, unsigned) {
+                for (std::size_t i = begin; i < end; i++) {
+                    if (invMasses[i] == 0.0f) continue;
+                    velocities[i] = (velocities[i] + gravity * dt) * linDamp;
+                    angularVelocities[i] *= angDamp;
+                }
+            }, threads, 8192);
+
+            threads = (unsigned)std::clamp<std::size_t>(contactCount / 1024, 1, threads);
+            assign_islands(threads);
+            parallelFor(0, threads, [&](std::size_t begin, std::size_t end, unsigned) {
+                for (std::size_t t = begin; t < end; t++)
+                    for (uint32_t island : threadIslands[t])
+                        solve_island(islandContacts.data() + islandStart[island], islandStart[island + 1] - islandStart[island], invDt);
+            }, threads, 1);
+
+            // Store impulses for warm starting, sorted by key
+            cacheKeys.resize(contactCount);
+            cacheImpulses.resize(contactCount);
+            for (std::size_t i = 0; i < contactCount; i++) {
+                const uint32_t c = keyOrder[i];
+                cacheKeys[i] = cKey[c];
+                cacheImpulses[i] = vec2(cPn[c], cPt[c]);
+            }
+
+            // Integrate velocities
+            parallelFor(0, n, [&](std::size_t begin, std::size_t end, unsigned) {
+                for (std::size_t i = begin; i < end; i++) {
+                    positions[i] += velocities[i] * dt;
+                    angles[i] += angularVelocities[i] * dt;
+                }
+            }, threads, 8192);
+        }
+
+        // Static bodies are shared between islands, only dynamic bodies are written
+        void apply(BodyId body, const vec2 &impulse, const vec2 &r, float sign) {
+            if (invMasses[body] == 0.0f) return;
+            velocities[body] += impulse * (sign * invMasses[body]);
+            angularVelocities[body] += sign * invInertias[body] * Physics2D::cross(r, impulse);
+        }
+
+        void solve_island(const uint32_t * contacts, std::size_t count, float invDt) {
+            using namespace Physics2D;
+
+            // Pre step: effective masses, bias, restitution, then warm start
+            for (std::size_t k = 0; k < count; k++) {
+                const uint32_t c = contacts[k];
+                const BodyId a = cA[c], b = cB[c];
+                const vec2 n = cNormal[c], t(n.y, -n.x), rA = cRA[c], rB = cRB[c];
+                const float rnA = rA.dot(n), rnB = rB.dot(n), rtA = rA.dot(t), rtB = rB.dot(t);
+                const float mA = invMasses[a], mB = invMasses[b], iA = invInertias[a], iB = invInertias[b];
+                cMassNormal[c] = 1.0f / (mA + mB + iA * (rA.dot(rA) - rnA * rnA) + iB * (rB.dot(rB) - rnB * rnB));
+                cMassTangent[c] = 1.0f / (mA + mB + iA * (rA.dot(rA) - rtA * rtA) + iB * (rB.dot(rB) - rtB * rtB));
+
+                const vec2 dv = velocities[b] + cross(angularVelocities[b], rB) - velocities[a] - cross(angularVelocities[a], rA);
+                const float vn = dv.dot(n);
+                float bias = -biasFactor * invDt * std::min(0.0f, cSeparation[c] + allowedPenetration);
+                if (vn < -restitutionThreshold) bias = std::max(bias, -cRestitution[c] * vn);
+                cBias[c] = bias;
+
+                const vec2 P = n * cPn[c] + t * cPt[c];
+                apply(a, P, rA, -1.0f);
+                apply(b, P, rB, 1.0f);
+            }
+
+            for (int iteration = 0; iteration < velocityIterations; iteration++) {
+                for (std::size_t k = 0; k < count; k++) {
+                    const uint32_t c = contacts[k];
+                    const BodyId a = cA[c], b = cB[c];
+                    const vec2 n = cNormal[c], t(n.y, -n.x), rA = cRA[c], rB = cRB[c];
+
+                    vec2 dv = velocities[b] + cross(angularVelocities[b], rB) - velocities[a] - cross(angularVelocities[a], rA);
+                    float dPn = cMassNormal[c] * (-dv.dot(n) + cBias[c]);
+                    const float pn = std::max(cPn[c] + dPn, 0.0f);
+                    dPn = pn - cPn[c];
+                    cPn[c] = pn;
+                    apply(a, n * dPn, rA, -1.0f);
+                    apply(b, n * dPn, rB, 1.0f);
+
+                    dv = velocities[b] + cross(angularVelocities[b], rB) - velocities[a] - cross(angularVelocities[a], rA);
+                    float dPt = cMassTangent[c] * -dv.dot(t);
+                    const float maxPt = cFriction[c] * cPn[c];
+                    const float pt = std::clamp(cPt[c] + dPt, -maxPt, maxPt);
+                    dPt = pt - cPt[c];
+                    cPt[c] = pt;
+                    apply(a, t * dPt, rA, -1.0f);
+                    apply(b, t * dPt, rB, 1.0f);
+                }
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,325 @@
+#ifndef BOWSER_UTIL_POLYGON_H
+#define BOWSER_UTIL_POLYGON_H
+
+#include "stdint.h"
+#include "types/vector.h"
+#include "hull.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#ifdef DEBUG
+#include <stdexcept>
+#endif
+
+namespace bowser_util {
+    /**
+     * @brief Reusable working memory for triangulatePolygon, keep one per thread and reuse it: the first
+     *        calls grow the vectors, triangulation only stops allocating once they fit the largest input
+     */
+    struct TriangulateScratch {
+        std::vector<uint32_t> prev, next;
+        std::vector<uint8_t> reflex;      // 1 while a vertex is reflex (reflex vertices only ever become convex)
+        std::vector<uint32_t> cellStart;  // Uniform grid of the reflex vertices (compressed rows)
+        std::vector<uint32_t> cellEnd;    // End of the live entries of each cell, dead ones are swapped past it
+        std::vector<uint32_t> cellItems;
+    };
+
+    namespace Polygon {
+        using Hull::cross2; // > 0 if p is left of a -> b
+
+        // Inclusive point in triangle test, triangle winding given by orient (+1 ccw, -1 cw)
+        inline bool in_triangle(const vec2 &a, const vec2 &b, const vec2 &c, const vec2 &p, float orient) {
+            return orient * cross2(a, b, p) >= 0.0f && orient * cross2(b, c, p) >= 0.0f && orient * cross2(c, a, p) >= 0.0f;
+        }
+
+        // Clipped polygon doesn't fit the caller's buffers
+        inline std::size_t clip_overflow() {
+            #ifdef DEBUG
+            throw std::length_error("Clipped polygon doesn't fit in out / scratch");
+            #endif
+            return 0;
+        }
+
+        struct Grid {
+            vec2 origin, invCell;
+            int size;
+
+            int cell(float v, float origin, float inv) const {
+                return std::clamp((int)((v - origin) * inv), 0, size - 1);
+            }
+
+            // y range of a row, padded by 1% of a cell against rounding, the edge rows reach infinity since
+            // cell() clamps
+            float row_min(int y) const { return y > 0 && invCell.y > 0.0f ? origin.y + (y - 0.01f) / invCell.y : -INFINITY; }
+            float row_max(int y) const { return y < size - 1 && invCell.y > 0.0f ? origin.y + (y + 1.01f) / invCell.y : INFINITY; }
+        };
+
+        // x range of triangle abc between y = yMin and y = yMax, false if it doesn't reach the band
+        inline bool triangle_row_span(const vec2 &a, const vec2 &b, const vec2 &c, float yMin, float yMax, float &xmin, float &xmax) {
+            xmin = INFINITY;
+            xmax = -INFINITY;
+            const vec2 * corners[3] = { &a, &b, &c };
+            for (int e = 0; e < 3; e++) {
+                const vec2 &p = *corners[e], &q = *corners[(e + 1) % 3];
+                if (p.y >= yMin && p.y <= yMax) {
+                    xmin = std::min(xmin, p.x);
+                    xmax = std::max(xmax, p.x);
+                }
+                // Where the edge crosses the band limits
+                for (float limit : { yMin, yMax }) {
+                    if ((p.y < limit) == (q.y < limit)) continue;
+                    const float x = p.x + (q.x - p.x) * ((limit - p.y) / (q.y - p.y));
+                    xmin = std::min(xmin, x);
+                    xmax = std::max(xmax, x);
+                }
+            }
+            return xmin <= xmax;
+        }
+    }
+
+    /**
+     * @brief Signed area of a polygon, > 0 if counter clockwise
+     */
+    inline float polygonArea(std::span<const vec2> polygon) {
+        float area = 0.0f;
+        for (std::size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
+            area += polygon[j].x * polygon[i].y - polygon[i].x * polygon[j].y;
+        return area * 0.5f;
+    }
+
+    /**
+     * @brief Triangulate a simple polygon (no self intersections) with ear clipping
+     *        Only reflex vertices can be inside an ear, so they are put in a uniform grid and each
+     *        ear test only checks the reflex vertices in the cells the ear crosses. Vertices that
+     *        stop being reflex are dropped from their cell when an ear test walks over them, so the
+     *        big ears at the end of a star polygon don't rescan every dead entry
+     * @param polygon Polygon vertices, either winding
+     * @param outIndices Output triangles as indices into polygon, same winding as the polygon.
+     *        Needs 3 * (polygon.size() - 2) entries
+     * @param scratch Working memory, only stops allocating once it has grown to the largest polygon
+     * @return std::size_t Number of indices written
+     */
+    inline std::size_t triangulatePolygon(std::span<const vec2> polygon, std::span<uint32_t> outIndices, TriangulateScratch &scratch) {
+        using namespace Polygon;
+        const uint32_t n = (uint32_t)polygon.size();
+        if (n < 3) return 0;
+        const float orient = polygonArea(polygon) >= 0.0f ? 1.0f : -1.0f;
+
+        TriangulateScratch &s = scratch;
+        s.prev.resize(n);
+        s.next.resize(n);
+        s.reflex.assign(n, 0);
+        for (uint32_t i = 0; i < n; i++) {
+            s.prev[i] = i ? i - 1 : n - 1;
+            s.next[i] = i + 1 < n ? i + 1 : 0;
+        }
+
+        auto is_reflex = [&](uint32_t i) {
+            return orient * cross2(polygon[s.prev[i]], polygon[i], polygon[s.next[i]]) <= 0.0f;
+        };
+
+        uint32_t liveReflex = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            s.reflex[i] = is_reflex(i);
+            liveReflex += s.reflex[i];
+        }
+
+        // Grid over the reflex vertices still in the polygon (walking count vertices from first), about 2 per cell
+        Grid grid;
+        uint32_t gridReflex = 0;
+        auto cell_of = [&](const vec2 &p) {
+            return (std::size_t)grid.cell(p.y, grid.origin.y, grid.invCell.y) * grid.size + grid.cell(p.x, grid.origin.x, grid.invCell.x);
+        };
+        auto build_grid = [&](uint32_t first, uint32_t count) {
+            vec2 lo(INFINITY), hi(-INFINITY);
+            for (uint32_t k = 0, i = first; k < count; k++, i = s.next[i]) {
+                if (!s.reflex[i]) continue;
+                lo = vec2(std::min(lo.x, polygon[i].x), std::min(lo.y, polygon[i].y));
+                hi = vec2(std::max(hi.x, polygon[i].x), std::max(hi.y, polygon[i].y));
+            }
+            gridReflex = liveReflex;
+            grid.size = std::max(1, (int)std::sqrt(gridReflex / 2.0f));
+            grid.origin = lo;
+            grid.invCell = vec2(hi.x > lo.x ? grid.size / (hi.x - lo.x) : 0.0f, hi.y > lo.y ? grid.size / (hi.y - lo.y) : 0.0f);
+
+            const std::size_t cells = (std::size_t)grid.size * grid.size;
+            s.cellStart.assign(cells + 1, 0);
+            s.cellItems.resize(gridReflex);
+            for (uint32_t k = 0, i = first; k < count; k++, i = s.next[i])
+                if (s.reflex[i]) s.cellStart[cell_of(polygon[i]) + 1]++;
+            for (std::size_t c = 0; c < cells; c++) s.cellStart[c + 1] += s.cellStart[c];
+            for (uint32_t k = 0, i = first; k < count; k++, i = s.next[i])
+                if (s.reflex[i]) s.cellItems[s.cellStart[cell_of(polygon[i])]++] = i;
+            for (std::size_t c = cells; c > 0; c--) s.cellStart[c] = s.cellStart[c - 1];
+            s.cellStart[0] = 0;
+            s.cellEnd.assign(s.cellStart.begin() + 1, s.cellStart.end());
+        };
+        build_grid(0, n);
+
+        auto is_ear = [&](uint32_t i) {
+            if (s.reflex[i]) return false;
+            const uint32_t ia = s.prev[i], ic = s.next[i];
+            const vec2 &a = polygon[ia], &b = polygon[i], &c = polygon[ic];
+            if (!liveReflex) return true;
+
+            const int y0 = grid.cell(std::min({ a.y, b.y, c.y }), grid.origin.y, grid.invCell.y);
+            const int y1 = grid.cell(std::max({ a.y, b.y, c.y }), grid.origin.y, grid.invCell.y);
+            for (int y = y0; y <= y1; y++) {
+                // Only the cells the triangle crosses in this row, long thin ears at an angle would
+                // otherwise scan most of their bounding box
+                float xmin, xmax;
+                if (!triangle_row_span(a, b, c, grid.row_min(y), grid.row_max(y), xmin, xmax)) continue;
+                const int x0 = grid.cell(xmin, grid.origin.x, grid.invCell.x);
+                const int x1 = grid.cell(xmax, grid.origin.x, grid.invCell.x);
+                for (int x = x0; x <= x1; x++) {
+                    const std::size_t cell = (std::size_t)y * grid.size + x;
+                    for (uint32_t k = s.cellStart[cell]; k < s.cellEnd[cell];) {
+                        const uint32_t v = s.cellItems[k];
+                        if (!s.reflex[v]) {
+                            s.cellItems[k] = s.cellItems[--s.cellEnd[cell]];
+                            continue;
+                        }
+                        k++;
+                        if (v == ia || v == ic) continue;
+                        const vec2 &p = polygon[v];
+                        if (p == a || p == b || p == c) continue; // Duplicated vertices (ie bridged holes)
+                        if (in_triangle(a, b, c, p, orient)) return false;
+                    }
+                }
+            }
+            return true;
+        };
+
+        std::size_t written = 0;
+        uint32_t remaining = n, cur = 0, stall = 0;
+        while (remaining > 3) {
+            const uint32_t a = s.prev[cur], c = s.next[cur];
+            // No ear found in a whole loop means the polygon is degenerate, clip anyway so it terminates
+            if (is_ear(cur) || stall > remaining) {
+                outIndices[written++] = a;
+                outIndices[written++] = cur;
+                outIndices[written++] = c;
+                s.next[a] = c;
+                s.prev[c] = a;
+                liveReflex -= s.reflex[cur];
+                s.reflex[cur] = 0;
+                remaining--;
+                // Neighbours can only go from reflex to convex
+                for (uint32_t neighbour : { a, c }) {
+                    if (s.reflex[neighbour] && !is_reflex(neighbour)) {
+                        s.reflex[neighbour] = 0;
+                        liveReflex--;
+                    }
+                }
+                // Skipping a vertex moves on instead of fanning out of a: each ear clipped at c would
+                // share a with the last one and grow towards a sliver covering the whole grid
+                cur = s.next[c];
+                stall = 0;
+                // Rebuild over the remaining reflex vertices once half are gone, the cells (and the empty
+                // cells a big ear's bounding box covers) shrink with them
+                if (gridReflex > 64 && liveReflex * 2 < gridReflex) build_grid(cur, remaining);
+            } else {
+                cur = c;
+                stall++;
+            }
+        }
+        outIndices[written++] = s.prev[cur];
+        outIndices[written++] = cur;
+        outIndices[written++] = s.next[cur];
+        return written;
+    }
+
+    /**
+     * @brief Clip a polygon against a convex polygon (Sutherland-Hodgman)
+     * @param subject Polygon to clip, any winding. A concave subject is clipped as one polygon: pieces that
+     *        the clip separates stay joined by degenerate edges along the clip boundary
+     * @param clip Convex clip polygon, counter clockwise
+     * @param out Output polygon. A convex subject needs subject.size() + clip.size() entries, a concave one
+     *        gains one vertex per crossing on every clip edge (up to subject.size() * 2^clip.size())
+     * @param scratch Working memory, at least as large as out
+     * @return std::size_t Number of vertices of the clipped polygon, 0 if fully outside or if the result
+     *         doesn't fit in out / scratch
+     */
+    inline std::size_t clipPolygon(std::span<const vec2> subject, std::span<const vec2> clip, std::span<vec2> out, std::span<vec2> scratch) {
+        using Polygon::cross2;
+        const std::size_t edges = clip.size();
+        if (edges < 3) return 0;
+        const std::size_t capacity = std::min(out.size(), scratch.size());
+
+        // Ping pong between the buffers so the last edge writes into out
+        vec2 * dst = edges % 2 ? out.data() : scratch.data();
+        vec2 * other = edges % 2 ? scratch.data() : out.data();
+        const vec2 * src = subject.data();
+        std::size_t count = subject.size();
+
+        for (std::size_t e = 0; e < edges && count; e++) {
+            const vec2 &a = clip[e], &b = clip[(e + 1) % edges];
+            std::size_t written = 0;
+            for (std::size_t i = 0; i < count; i++) {
+                const vec2 &p = src[i], &q = src[(i + 1) % count];
+                const float dp = cross2(a, b, p), dq = cross2(a, b, q);
+                const std::size_t emit = (dp >= 0.0f) + ((dp >= 0.0f) != (dq >= 0.0f));
+                if (written + emit > capacity) return Polygon::clip_overflow();
+                if (dp >= 0.0f) dst[written++] = p;
+                if ((dp >= 0.0f) != (dq >= 0.0f))
+                    dst[written++] = p + (q - p) * (dp / (dp - dq));
+            }
+            count = written;
+            src = dst;
+            std::swap(dst, other);
+        }
+        if (count && src != out.data()) std::copy(src, src + count, out.data());
+        return count;
+    }
+
+    /**
+     * @brief Clip a 3D polygon against planes (Sutherland-Hodgman), ie frustum planes from
+     *        GPUCuller::extractFrustumPlanes
+     * @param subject Polygon to clip
+     * @param planes Planes, xyz = normal, w = distance, points with dot(normal, p) + w >= 0 are kept
+     * @param out Output polygon. A convex subject needs subject.size() + planes.size() entries, a concave
+     *        one gains one vertex per crossing on every plane (up to subject.size() * 2^planes.size())
+     * @param scratch Working memory, at least as large as out
+     * @return std::size_t Number of vertices of the clipped polygon, 0 if fully outside or if the result
+     *         doesn't fit in out / scratch
+     */
+    inline std::size_t clipPolygonPlanes(std::span<const vec3> subject, std::span<const vec4> planes, std::span<vec3> out, std::span<vec3> scratch) {
+        const std::size_t count0 = subject.size();
+        const std::size_t capacity = std::min(out.size(), scratch.size());
+        if (planes.empty()) {
+            if (count0 > out.size()) return Polygon::clip_overflow();
+            std::copy(subject.begin(), subject.end(), out.begin());
+            return count0;
+        }
+
+        vec3 * dst = planes.size() % 2 ? out.data() : scratch.data();
+        vec3 * other = planes.size() % 2 ? scratch.data() : out.data();
+        const vec3 * src = subject.data();
+        std::size_t count = count0;
+
+        for (std::size_t e = 0; e < planes.size() && count; e++) {
+            const vec4 &pl = planes[e];
+            std::size_t written = 0;
+            for (std::size_t i = 0; i < count; i++) {
+                const vec3 &p = src[i], &q = src[(i + 1) % count];
+                const float dp = pl.x * p.x + pl.y * p.y + pl.z * p.z + pl.w;
+                const float dq = pl.x * q.x + pl.y * q.y + pl.z * q.z + pl.w;
+                const std::size_t emit = (dp >= 0.0f) + ((dp >= 0.0f) != (dq >= 0.0f));
+                if (written + emit > capacity) return Polygon::clip_overflow();
+                if (dp >= 0.0f) dst[written++] = p;
+                if ((dp >= 0.0f) != (dq >= 0.0f))
+                    dst[written++] = p + (q - p) * (dp / (dp - dq));
+            }
+            count = written;
+            src = dst;
+            std::swap(dst, other);
+        }
+        if (count && src != out.data()) std::copy(src, src + count, out.data());
+        return count;
+    }
+}
+
+#endif
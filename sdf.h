@@ -0,0 +1,439 @@
+#ifndef BOWSER_UTIL_SDF_H
+#define BOWSER_UTIL_SDF_H
+
+#include "stdint.h"
+#include "types/vector.h"
+#include "parallel.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#ifdef DEBUG
+#include <stdexcept>
+#endif
+
+namespace bowser_util {
+    enum class SDFMethod {
+        EXACT,          // Felzenszwalb & Huttenlocher separable transform, exact, O(cells)
+        JUMP_FLOOD,     // Jump flooding (+1 pass), approximate, O(cells * log(size))
+        BRUTE_FORCE     // Every cell against every boundary cell, exact, reference for the other two
+    };
+
+    /**
+     * @brief Stats of the last SDFGenerator::generate()
+     */
+    struct SDFStats {
+        ivec3 size = ivec3(0);
+        std::size_t cells = 0;
+        SDFMethod method = SDFMethod::EXACT;
+        int passes = 0;                 // Axes for EXACT, flood passes per sign for JUMP_FLOOD
+        unsigned threads = 0;
+        double transformSeconds = 0.0;  // Both distance transforms (inside and outside)
+        double outputSeconds = 0.0;     // Square roots, sign and quantization into the caller's buffer
+        double totalSeconds = 0.0;
+
+        double cellsPerMs() const { return totalSeconds > 0.0 ? cells / (totalSeconds * 1000.0) : 0.0; }
+    };
+
+    namespace SDF {
+        constexpr float INF = 1e20f;                    // Squared distance of a cell without any seed
+        constexpr int MAX_SIZE = 8192;                  // Per axis, keeps jump flood distances in 32 bit ints
+        constexpr int16_t NO_SEED = -16384;             // Jump flood seed coordinate of a cell without a seed yet
+        constexpr int32_t NO_SEED_D2 = 16384 * 16384;   // Any real seed is closer than this
+        constexpr int TILE = 16;                        // Columns gathered together by the exact transform
+
+        /**
+         * @brief Squared distance along a row to the nearest cell with (mask != 0) == seed, INF if none
+         */
+        inline void row_distance(const uint8_t * mask, bool seed, float * out, int n) {
+            constexpr int FAR = 1 << 20;
+            int last = -FAR;
+            for (int x = 0; x < n; x++) {
+                if ((mask[x] != 0) == seed) last = x;
+                out[x] = (float)(x - last);
+            }
+            int next = FAR + n;
+            for (int x = n - 1; x >= 0; x--) {
+                if ((mask[x] != 0) == seed) next = x;
+                const int d = std::min((int)out[x], next - x);
+                out[x] = d >= FAR ? INF : (float)d * (float)d;
+            }
+        }
+
+        /**
+         * @brief 1D squared distance transform of sampled function f: d[q] = min_p (q - p)^2 + f[p] through the
+         *        lower envelope of the parabolas rooted at each p (Felzenszwalb & Huttenlocher 2012)
+         * @param v, z Scratch, n and n + 1 entries
+         */
+        inline void envelope_1d(const float * f, float * d, int * v, float * z, int n) {
+            int k = -1;
+            for (int q = 0; q < n; q++) {
+                if (f[q] >= INF) continue;
+                float s = -INF;
+                while (k >= 0) {
+                    const int p = v[k];
+                    // (q - p) * (q + p) in ints, the squares alone lose precision in floats past 4096
+                    s = ((f[q] - f[p]) + (float)((q - p) * (q + p))) / (float)(2 * (q - p));
+                    if (s > z[k]) break;
+                    k--;
+                }
+                k++;
+                v[k] = q;
+                z[k] = k ? s : -INF;
+                z[k + 1] = INF;
+            }
+            if (k < 0) {
+                std::fill(d, d + n, INF);
+                return;
+            }
+            k = 0;
+            for (int q = 0; q < n; q++) {
+                while (z[k + 1] < (float)q) k++;
+                const int p = v[k];
+                d[q] = f[p] + (float)((q - p) * (q - p));
+            }
+        }
+
+        /**
+         * @brief envelope_1d() over every line along a strided axis. Lines are gathered TILE at a time from
+         *        consecutive x so the strided reads stay within cache lines
+         * @param data Squared distances, line (o, x) element i at o * outerStride + i * stride + x
+         * @param n Line length
+         * @param width Lines per outer index (consecutive x)
+         */
+        inline void column_pass(float * data, int n, std::size_t stride, std::size_t outerCount, std::size_t outerStride,
+                int width, unsigned threads) {
+            const std::size_t tiles = (width + TILE - 1) / TILE;
+            parallelFor(0, outerCount * tiles, [&](std::size_t begin, std::size_t end, unsigned) {
+                std::vector<float> in((std::size_t)TILE * n), out((std::size_t)TILE * n), z(n + 1);
+                std::vector<int> v(n);
+                for (std::size_t task = begin; task < end; task++) {
+                    const int x0 = (int)(task % tiles) * TILE, columns = std::min(TILE, width - x0);
+                    float * base = data + (task / tiles) * outerStride + x0;
+                    for (int i = 0; i < n; i++)
+                        for (int c = 0; c < columns; c++) in[(std::size_t)c * n + i] = base[i * stride + c];
+                    for (int c = 0; c < columns; c++)
+                        envelope_1d(in.data() + (std::size_t)c * n, out.data() + (std::size_t)c * n, v.data(), z.data(), n);
+                    // Scattered back a row at a time too, column by column would revisit every line TILE times
+                    for (int i = 0; i < n; i++)
+                        for (int c = 0; c < columns; c++) base[i * stride + c] = out[(std::size_t)c * n + i];
+                }
+            }, threads, 1);
+        }
+
+        /**
+         * @brief One jump flood offset over a row: keep the source seed if it's closer than the current one
+         *        (a free function so the restrict qualifiers reach the vectorizer)
+         * @param x0 x of the first destination cell
+         */
+        template <int D>
+        inline void flood_row(int count, int x0, int y, int z,
+                const int16_t * __restrict sx, const int16_t * __restrict sy, const int16_t * __restrict sz,
+                int16_t * __restrict dx, int16_t * __restrict dy, int16_t * __restrict dz, int32_t * __restrict best) {
+            for (int i = 0; i < count; i++) {
+                const int ex = x0 + i - sx[i], ey = y - sy[i];
+                int d2 = ex * ex + ey * ey;
+                if constexpr (D == 3) {
+                    const int ez = z - sz[i];
+                    d2 += ez * ez;
+                }
+                // Loaded up front, selects between two loaded values if-convert where conditional stores don't
+                const int current = best[i];
+                const int16_t cx = dx[i], cy = dy[i];
+                const bool closer = d2 < current;
+                best[i] = closer ? d2 : current;
+                dx[i] = closer ? sx[i] : cx;
+                dy[i] = closer ? sy[i] : cy;
+                if constexpr (D == 3) {
+                    const int16_t cz = dz[i];
+                    dz[i] = closer ? sz[i] : cz;
+                }
+            }
+        }
+
+    }
+
+    /**
+     * @brief Signed distance fields from binary masks, 2D (fonts, sprites) or 3D (voxels, collision)
+     *
+     *        Distances are in cells, negative inside (mask != 0) and positive outside, with the edge halfway
+     *        between cell centres: a cell next to the edge is at +-0.5. Each field is two unsigned transforms,
+     *        distance to the nearest inside cell and to the nearest outside cell, in squared floats
+     *
+     *        EXACT runs the Felzenszwalb transform one axis at a time (rows first, then columns, then slices),
+     *        JUMP_FLOOD propagates the nearest seed over log2(size) + 1 passes, each row of a pass being one
+     *        vectorized loop per neighbour offset. Rows / columns are split across threads in both cases
+     *
+     *        One generator per thread, the scratch buffers are reused between calls
+     */
+    class SDFGenerator {
+    public:
+        /**
+         * @brief Float signed distances
+         * @param mask size.x * size.y (* size.z) cells indexed x + y * size.x (+ z * size.x * size.y), non zero = inside
+         * @param size Grid size, each axis in [1, 8192]
+         * @param out Same layout as mask, distances in cells
+         * @param method See SDFMethod
+         * @param threads Number of threads, 0 = hardwareThreadCount()
+         * @return const SDFStats& Timings of this call
+         */
+        const SDFStats &generate(const uint8_t * mask, ivec2 size, float * out, SDFMethod method = SDFMethod::EXACT, unsigned threads = 0) {
+            return generate(mask, ivec3(size.x, size.y, 1), out, method, threads);
+        }
+
+        const SDFStats &generate(const uint8_t * mask, ivec3 size, float * out, SDFMethod method = SDFMethod::EXACT, unsigned threads = 0) {
+            const auto start = std::chrono::steady_clock::now();
+            if (!transform(mask, size, method, threads)) return stats;
+            const auto outputStart = std::chrono::steady_clock::now();
+            const int width = size.x;
+            parallelFor(0, rows(), [&](std::size_t begin, std::size_t end, unsigned) {
+                for (std::size_t r = begin; r < end; r++) {
+                    const std::size_t row = r * width;
+                    float * outside = this->outside.data() + row, * inside = this->inside.data() + row;
+                    sqrtInPlace(outside, width);
+                    sqrtInPlace(inside, width);
+                    const uint8_t * m = mask + row;
+                    float * o = out + row;
+                    for (int x = 0; x < width; x++) o[x] = outside[x] - inside[x] + ((float)(m[x] != 0) - 0.5f);
+                }
+            }, this->threads, minRows(size));
+            finish(start, outputStart);
+            return stats;
+        }
+
+        /**
+         * @brief 8 bit signed distances, 127.5 + distance * 127.5 / spread rounded and clamped to [0, 255]
+         * @param spread Distance mapped to 255 (and -spread to 0), negative to get inside > 128 as most font
+         *        atlases expect
+         * @see generate(const uint8_t *, ivec3, float *, SDFMethod, unsigned)
+         */
+        const SDFStats &generate(const uint8_t * mask, ivec2 size, uint8_t * out, float spread, SDFMethod method = SDFMethod::EXACT, unsigned threads = 0) {
+            return generate(mask, ivec3(size.x, size.y, 1), out, spread, method, threads);
+        }
+
+        const SDFStats &generate(const uint8_t * mask, ivec3 size, uint8_t * out, float spread, SDFMethod method = SDFMethod::EXACT, unsigned threads = 0) {
+            const auto start = std::chrono::steady_clock::now();
+            if (!transform(mask, size, method, threads)) return stats;
+            const auto outputStart = std::chrono::steady_clock::now();
+            const float scale = spread != 0.0f ? 127.5f / spread : 0.0f;
+            const int width = size.x;   // Local copy, the 8 bit stores could alias size and stop the loop from vectorizing
+            parallelFor(0, rows(), [&](std::size_t begin, std::size_t end, unsigned) {
+                for (std::size_t r = begin; r < end; r++) {
+                    const std::size_t row = r * width;
+                    float * outside = this->outside.data() + row, * inside = this->inside.data() + row;
+                    sqrtInPlace(outside, width);
+                    sqrtInPlace(inside, width);
+                    const uint8_t * m = mask + row;
+                    uint8_t * o = out + row;
+                    for (int x = 0; x < width; x++) {
+                        const float d = outside[x] - inside[x] + ((float)(m[x] != 0) - 0.5f);
+                        const float v = 255.0f - positivePart(255.0f - positivePart(127.5f + d * scale));
+                        o[x] = (uint8_t)(int)(v + 0.5f);
+                    }
+                }
+            }, this->threads, minRows(size));
+            finish(start, outputStart);
+            return stats;
+        }
+
+        const SDFStats &getStats() const { return stats; }
+
+    private:
+        ivec3 size = ivec3(0);
+        unsigned threads = 0;
+        // outside: squared distance of each cell to the nearest inside (mask != 0) cell, 0 on inside cells.
+        // inside: squared distance to the nearest outside cell, 0 on outside cells. After the sqrt the
+        // output is outside - inside, so swapping them flips the sign
+        std::vector<float> outside, inside;
+        std::vector<int16_t> seeds[2][3];           // Jump flood nearest seed coordinates, ping-pong
+        std::vector<int32_t> best;                  // Jump flood squared distance to seeds[1]
+        SDFStats stats;
+
+        std::size_t rows() const { return (std::size_t)size.y * size.z; }
+        std::size_t cells() const { return rows() * size.x; }
+
+        // Keep at least ~16k cells per thread
+        static std::size_t minRows(ivec3 size) { return std::max<std::size_t>(1, 16384 / size.x); }
+
+        // Fills outside / inside, false on invalid input
+        bool transform(const uint8_t * mask, ivec3 gridSize, SDFMethod method, unsigned threadCount) {
+            const auto start = std::chrono::steady_clock::now();
+            stats = SDFStats();
+            if (!mask || gridSize.x < 1 || gridSize.y < 1 || gridSize.z < 1 ||
+                    gridSize.x > SDF::MAX_SIZE || gridSize.y > SDF::MAX_SIZE || gridSize.z > SDF::MAX_SIZE) {
+                #ifdef DEBUG
+                throw std::invalid_argument("SDF grid axes must be in [1, 8192]");
+                #endif
+                return false;
+            }
+            size = gridSize;
+            threads = threadCount ? threadCount : hardwareThreadCount();
+            outside.resize(cells());
+            inside.resize(cells());
+            stats.size = size;
+            stats.cells = cells();
+            stats.method = method;
+            stats.threads = threads;
+            if (method == SDFMethod::JUMP_FLOOD) {
+                jump_flood(mask, true, outside);
+                stats.passes = jump_flood(mask, false, inside);
+            } else if (method == SDFMethod::BRUTE_FORCE) {
+                brute_force(mask);
+                stats.passes = 1;
+            } else {
+                stats.passes = exact(mask);
+            }
+            stats.transformSeconds = secondsSince(start);
+            return true;
+        }
+
+        void finish(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point outputStart) {
+            stats.outputSeconds = secondsSince(outputStart);
+            stats.totalSeconds = secondsSince(start);
+        }
+
+        // Exact transform: 1D distances along the rows straight from the mask, then envelopes along y and z
+        int exact(const uint8_t * mask) {
+            parallelFor(0, rows(), [&](std::size_t begin, std::size_t end, unsigned) {
+                for (std::size_t r = begin; r < end; r++) {
+                    const std::size_t row = r * size.x;
+                    SDF::row_distance(mask + row, true, outside.data() + row, size.x);
+                    SDF::row_distance(mask + row, false, inside.data() + row, size.x);
+                }
+            }, threads, minRows(size));
+            int passes = 1;
+            const std::size_t slice = (std::size_t)size.x * size.y;
+            if (size.y > 1) {
+                for (auto *data : { &outside, &inside }) SDF::column_pass(data->data(), size.y, size.x, size.z, slice, size.x, threads);
+                passes++;
+            }
+            if (size.z > 1) {
+                for (auto *data : { &outside, &inside }) SDF::column_pass(data->data(), size.z, slice, 1, 0, (int)slice, threads);
+                passes++;
+            }
+            return passes;
+        }
+
+        /**
+         * @brief Jump flood from every cell with (mask != 0) == seed, writes the squared distance to the
+         *        nearest seed found into out
+         * @return int Number of passes
+         */
+        int jump_flood(const uint8_t * mask, bool seed, std::vector<float> &out) {
+            for (auto &buffers : seeds)
+                for (auto &axis : buffers) axis.resize(cells());
+            best.resize(cells());
+            // Seed cells point to themselves
+            parallelFor(0, rows(), [&](std::size_t begin, std::size_t end, unsigned) {
+                for (std::size_t r = begin; r < end; r++) {
+                    const std::size_t row = r * size.x;
+                    const int16_t y = (int16_t)(r % size.y), z = (int16_t)(r / size.y);
+                    const uint8_t * m = mask + row;
+                    int16_t * sx = seeds[0][0].data() + row, * sy = seeds[0][1].data() + row, * sz = seeds[0][2].data() + row;
+                    for (int x = 0; x < size.x; x++) {
+                        const bool isSeed = (m[x] != 0) == seed;
+                        sx[x] = isSeed ? (int16_t)x : SDF::NO_SEED;
+                        sy[x] = isSeed ? y : SDF::NO_SEED;
+                        sz[x] = isSeed ? z : SDF::NO_SEED;
+                    }
+                }
+            }, threads, minRows(size));
+
+            // Steps of half the (power of two) size down to 1, then 1 again to fix most of the leftover errors
+            std::vector<int> steps;
+            for (int step = (int)std::bit_ceil((unsigned)std::max({ size.x, size.y, size.z })) / 2; step >= 1; step /= 2) steps.push_back(step);
+            steps.push_back(1);
+            for (int step : steps) {
+                if (size.z > 1) flood_pass<3>(step);
+                else flood_pass<2>(step);
+                for (int axis = 0; axis < 3; axis++) std::swap(seeds[0][axis], seeds[1][axis]);
+            }
+
+            parallelFor(0, cells(), [&](std::size_t begin, std::size_t end, unsigned) {
+                for (std::size_t i = begin; i < end; i++) out[i] = best[i] >= SDF::NO_SEED_D2 ? SDF::INF : (float)best[i];
+            }, threads, 16384);
+            return (int)steps.size();
+        }
+
+        // One flood pass from seeds[0] into seeds[1] / best
+        template <int D>
+        void flood_pass(int step) {
+            parallelFor(0, rows(), [&](std::size_t begin, std::size_t end, unsigned) {
+                for (std::size_t r = begin; r < end; r++) {
+                    const int y = (int)(r % size.y), z = (int)(r / size.y);
+                    const std::size_t row = r * size.x;
+                    std::fill(best.begin() + row, best.begin() + row + size.x, INT32_MAX);
+                    for (int oz = (D == 3 ? -1 : 0); oz <= (D == 3 ? 1 : 0); oz++) {
+                        const int nz = z + oz * step;
+                        if (nz < 0 || nz >= size.z) continue;
+                        for (int oy = -1; oy <= 1; oy++) {
+                            const int ny = y + oy * step;
+                            if (ny < 0 || ny >= size.y) continue;
+                            const std::size_t sourceRow = ((std::size_t)nz * size.y + ny) * size.x;
+                            for (int ox = -1; ox <= 1; ox++) {
+                                const int shift = ox * step;
+                                const int first = std::max(0, -shift), last = std::min(size.x, size.x - shift);
+                                if (first >= last) continue;
+                                const std::size_t source = sourceRow + first + shift, target = row + first;
+                                SDF::flood_row<D>(last - first, first, y, z,
+                                    seeds[0][0].data() + source, seeds[0][1].data() + source, seeds[0][2].data() + source,
+                                    seeds[1][0].data() + target, seeds[1][1].data() + target, seeds[1][2].data() + target,
+                                    best.data() + target);
+                            }
+                        }
+                    }
+                }
+            }, threads, minRows(size));
+        }
+
+        /**
+         * @brief Reference: every cell against every boundary cell of the other side (the nearest cell of a side
+         *        always has a neighbour on the other side, so the rest can't be closer)
+         */
+        void brute_force(const uint8_t * mask) {
+            std::vector<int> boundary[2][3];
+            const int stride[3] = { 1, size.x, size.x * size.y }, extent[3] = { size.x, size.y, size.z };
+            for (int z = 0; z < size.z; z++) {
+                for (int y = 0; y < size.y; y++) {
+                    for (int x = 0; x < size.x; x++) {
+                        const int coord[3] = { x, y, z };
+                        const std::size_t i = ((std::size_t)z * size.y + y) * size.x + x;
+                        const bool in = mask[i] != 0;
+                        bool edge = false;
+                        for (int axis = 0; axis < 3; axis++) {
+                            if (coord[axis] > 0) edge |= (mask[i - stride[axis]] != 0) != in;
+                            if (coord[axis] + 1 < extent[axis]) edge |= (mask[i + stride[axis]] != 0) != in;
+                        }
+                        if (!edge) continue;
+                        for (int axis = 0; axis < 3; axis++) boundary[in][axis].push_back(coord[axis]);
+                    }
+                }
+            }
+            parallelFor(0, rows(), [&](std::size_t begin, std::size_t end, unsigned) {
+                for (std::size_t r = begin; r < end; r++) {
+                    const int y = (int)(r % size.y), z = (int)(r / size.y);
+                    const std::size_t row = r * size.x;
+                    for (int x = 0; x < size.x; x++) {
+                        const bool in = mask[row + x] != 0;
+                        // Inside cells look for the nearest outside cell and the other way around
+                        const auto &other = boundary[!in];
+                        const int * bx = other[0].data(), * by = other[1].data(), * bz = other[2].data();
+                        int d2 = INT32_MAX;
+                        for (std::size_t b = 0; b < other[0].size(); b++) {
+                            const int ex = x - bx[b], ey = y - by[b], ez = z - bz[b];
+                            d2 = std::min(d2, ex * ex + ey * ey + ez * ez);
+                        }
+                        const float d = d2 == INT32_MAX ? SDF::INF : (float)d2;
+                        outside[row + x] = in ? 0.0f : d;
+                        inside[row + x] = in ? d : 0.0f;
+                    }
+                }
+            }, threads, 1);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,309 @@
+#ifndef BOWSER_UTIL_SKINNING_H
+#define BOWSER_UTIL_SKINNING_H
+
+#include "raylib.h"
+#include "stdint.h"
+#include "types/vector.h"
+#include "types/persistent_buffer.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace bowser_util {
+    enum class SkinningMethod { LINEAR, DUAL_QUATERNION };
+
+    // Output vertex, matches a VBO with position (location 0) and normal (location 1) interleaved
+    struct SkinnedVertex {
+        vec3 position;
+        vec3 normal;
+    };
+
+    /**
+     * @brief Stats of the last skinVertices()
+     */
+    struct SkinningStats {
+        std::size_t vertices = 0;
+        std::size_t bones = 0;
+        unsigned threads = 0;
+        double seconds = 0.0;
+
+        double verticesPerMs() const { return seconds > 0.0 ? vertices / (seconds * 1000.0) : 0.0; }
+    };
+
+    /**
+     * @brief Bind pose of a skinned mesh as SoA streams (one array per component), up to 4 weights per vertex
+     */
+    struct SkinnedMesh {
+        std::vector<float> px, py, pz;
+        std::vector<float> nx, ny, nz;
+        std::vector<uint16_t> joints[4];
+        std::vector<float> weights[4];
+
+        void resize(std::size_t count) {
+            for (auto * stream : { &px, &py, &pz, &nx, &ny, &nz }) stream->resize(count, 0.0f);
+            for (int k = 0; k < 4; k++) {
+                joints[k].resize(count, 0);
+                weights[k].resize(count, 0.0f);
+            }
+        }
+
+        std::size_t size() const { return px.size(); }
+
+        /**
+         * @brief Set a vertex, weights are normalized to sum to 1 (unused influences have weight 0)
+         */
+        void set(std::size_t i, const vec3 &position, const vec3 &normal, const uint16_t joint[4], const vec4 &weight) {
+            px[i] = position.x; py[i] = position.y; pz[i] = position.z;
+            nx[i] = normal.x; ny[i] = normal.y; nz[i] = normal.z;
+            const float sum = weight.x + weight.y + weight.z + weight.w;
+            const float inv = sum > 0.0f ? 1.0f / sum : 0.0f;
+            const float w[4] = { weight.x * inv, weight.y * inv, weight.z * inv, weight.w * inv };
+            for (int k = 0; k < 4; k++) {
+                joints[k][i] = joint[k];
+                weights[k][i] = w[k];
+            }
+        }
+    };
+
+    /**
+     * @brief Skinning matrices (joint world * inverse bind) converted for the kernels: SoA 3x4 matrices for
+     *        linear blend skinning and dual quaternions (rotation + translation only, scale is ignored) for
+     *        dual quaternion skinning. Update once per frame before skinning
+     */
+    class SkinningPalette {
+    public:
+        void setMatrices(std::span<const Matrix> bones) {
+            count = bones.size();
+            linear.resize(12 * count);
+            dual.resize(8 * count);
+            for (std::size_t j = 0; j < count; j++) {
+                const Matrix &m = bones[j];
+                const float rows[12] = { m.m0, m.m4, m.m8, m.m12, m.m1, m.m5, m.m9, m.m13, m.m2, m.m6, m.m10, m.m14 };
+                for (int c = 0; c < 12; c++) linear[c * count + j] = rows[c];
+
+                vec4 qr = rotation_of(m);
+                // Dual part = 0.5 * (t, 0) * qr
+                const vec3 t(m.m12, m.m13, m.m14);
+                const vec4 qd(
+                    0.5f * (t.x * qr.w + t.y * qr.z - t.z * qr.y),
+                    0.5f * (-t.x * qr.z + t.y * qr.w + t.z * qr.x),
+                    0.5f * (t.x * qr.y - t.y * qr.x + t.z * qr.w),
+                    -0.5f * (t.x * qr.x + t.y * qr.y + t.z * qr.z));
+                const float comps[8] = { qr.x, qr.y, qr.z, qr.w, qd.x, qd.y, qd.z, qd.w };
+                for (int c = 0; c < 8; c++) dual[c * count + j] = comps[c];
+            }
+        }
+
+        std::size_t size() const { return count; }
+        const float * getLinear() const { return linear.data(); }   // [12][size()], rows of the 3x4 matrices
+        const float * getDual() const { return dual.data(); }       // [8][size()], real xyzw then dual xyzw
+
+    private:
+        std::vector<float> linear;
+        std::vector<float> dual;
+        std::size_t count = 0;
+
+        // Rotation quaternion of the (scale removed) upper 3x3
+        static vec4 rotation_of(const Matrix &m) {
+            const float sx = std::sqrt(m.m0 * m.m0 + m.m1 * m.m1 + m.m2 * m.m2);
+            const float sy = std::sqrt(m.m4 * m.m4 + m.m5 * m.m5 + m.m6 * m.m6);
+            const float sz = std::sqrt(m.m8 * m.m8 + m.m9 * m.m9 + m.m10 * m.m10);
+            const float r00 = m.m0 / sx, r10 = m.m1 / sx, r20 = m.m2 / sx;
+            const float r01 = m.m4 / sy, r11 = m.m5 / sy, r21 = m.m6 / sy;
+            const float r02 = m.m8 / sz, r12 = m.m9 / sz, r22 = m.m10 / sz;
+
+            vec4 q;
+            const float trace = r00 + r11 + r22;
+            if (trace > 0.0f) {
+                const float s = 0.5f / std::sqrt(trace + 1.0f);
+                q = vec4((r21 - r12) * s, (r02 - r20) * s, (r10 - r01) * s, 0.25f / s);
+            } else if (r00 > r11 && r00 > r22) {
+                const float s = 2.0f * std::sqrt(1.0f + r00 - r11 - r22);
+                q = vec4(0.25f * s, (r01 + r10) / s, (r02 + r20) / s, (r21 - r12) / s);
+            } else if (r11 > r22) {
+                const float s = 2.0f * std::sqrt(1.0f + r11 - r00 - r22);
+                q = vec4((r01 + r10) / s, 0.25f * s, (r12 + r21) / s, (r02 - r20) / s);
+            } else {
+                const float s = 2.0f * std::sqrt(1.0f + r22 - r00 - r11);
+                q = vec4((r02 + r20) / s, (r12 + r21) / s, 0.25f * s, (r10 - r01) / s);
+            }
+            const float len = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+            return q / len;
+        }
+    };
+
+    namespace Skinning {
+        // Vertices per block: blended transforms are computed into SoA arrays on the stack, then applied,
+        // so each inner loop is a flat branch free loop over the block that the compiler can vectorize
+        constexpr std::size_t BLOCK = 64;
+
+        inline void skin_linear(const SkinnedMesh &mesh, const SkinningPalette &palette, SkinnedVertex * out,
+                std::size_t begin, std::size_t end) {
+            const std::size_t bones = palette.size();
+            const float * L = palette.getLinear();
+            alignas(32) float M[12][BLOCK];
+            alignas(32) float X[3][BLOCK], N[3][BLOCK];
+
+            for (std::size_t base = begin; base < end; base += BLOCK) {
+                const std::size_t n = std::min(BLOCK, end - base);
+                const uint16_t * j0 = mesh.joints[0].data() + base, * j1 = mesh.joints[1].data() + base;
+                const uint16_t * j2 = mesh.joints[2].data() + base, * j3 = mesh.joints[3].data() + base;
+                const float * w0 = mesh.weights[0].data() + base, * w1 = mesh.weights[1].data() + base;
+                const float * w2 = mesh.weights[2].data() + base, * w3 = mesh.weights[3].data() + base;
+
+                // Blend the 4 bone matrices (gathers, vectorized with AVX2)
+                for (int c = 0; c < 12; c++) {
+                    const float * row = L + c * bones;
+                    for (std::size_t i = 0; i < n; i++)
+                        M[c][i] = w0[i] * row[j0[i]] + w1[i] * row[j1[i]] + w2[i] * row[j2[i]] + w3[i] * row[j3[i]];
+                }
+
+                // Transform
+                const float * px = mesh.px.data() + base, * py = mesh.py.data() + base, * pz = mesh.pz.data() + base;
+                const float * nx = mesh.nx.data() + base, * ny = mesh.ny.data() + base, * nz = mesh.nz.data() + base;
+                for (std::size_t i = 0; i < n; i++) {
+                    X[0][i] = M[0][i] * px[i] + M[1][i] * py[i] + M[2][i] * pz[i] + M[3][i];
+                    X[1][i] = M[4][i] * px[i] + M[5][i] * py[i] + M[6][i] * pz[i] + M[7][i];
+                    X[2][i] = M[8][i] * px[i] + M[9][i] * py[i] + M[10][i] * pz[i] + M[11][i];
+                    N[0][i] = M[0][i] * nx[i] + M[1][i] * ny[i] + M[2][i] * nz[i];
+                    N[1][i] = M[4][i] * nx[i] + M[5][i] * ny[i] + M[6][i] * nz[i];
+                    N[2][i] = M[8][i] * nx[i] + M[9][i] * ny[i] + M[10][i] * nz[i];
+                }
+                // Separate loop for the sqrt, see sqrtInPlace() in parallel.h
+                for (std::size_t i = 0; i < n; i++) {
+                    const float inv = 1.0f / std::sqrt(N[0][i] * N[0][i] + N[1][i] * N[1][i] + N[2][i] * N[2][i] + 1e-20f);
+                    N[0][i] *= inv;
+                    N[1][i] *= inv;
+                    N[2][i] *= inv;
+                }
+
+                // Interleave, sequential writes so write combined (mapped) memory is filled in order
+                SkinnedVertex * dst = out + base;
+                for (std::size_t i = 0; i < n; i++) {
+                    dst[i].position = vec3(X[0][i], X[1][i], X[2][i]);
+                    dst[i].normal = vec3(N[0][i], N[1][i], N[2][i]);
+                }
+            }
+        }
+
+        inline void skin_dual_quaternion(const SkinnedMesh &mesh, const SkinningPalette &palette, SkinnedVertex * out,
+                std::size_t begin, std::size_t end) {
+            const std::size_t bones = palette.size();
+            const float * D = palette.getDual();
+            alignas(32) float Q[8][BLOCK];
+            alignas(32) float S[4][BLOCK]; // Signed weights
+            alignas(32) float X[3][BLOCK], N[3][BLOCK], invLength[BLOCK];
+
+            for (std::size_t base = begin; base < end; base += BLOCK) {
+                const std::size_t n = std::min(BLOCK, end - base);
+                const uint16_t * j[4] = { mesh.joints[0].data() + base, mesh.joints[1].data() + base,
+                    mesh.joints[2].data() + base, mesh.joints[3].data() + base };
+                const float * w[4] = { mesh.weights[0].data() + base, mesh.weights[1].data() + base,
+                    mesh.weights[2].data() + base, mesh.weights[3].data() + base };
+
+                // Flip influences in the other hemisphere than the first one (shortest path blending)
+                for (std::size_t i = 0; i < n; i++) S[0][i] = w[0][i];
+                for (int k = 1; k < 4; k++) {
+                    for (std::size_t i = 0; i < n; i++) {
+                        const uint16_t a = j[0][i], b = j[k][i];
+                        const float d = D[a] * D[b] + D[bones + a] * D[bones + b]
+                                      + D[2 * bones + a] * D[2 * bones + b] + D[3 * bones + a] * D[3 * bones + b];
+                        S[k][i] = d < 0.0f ? -w[k][i] : w[k][i];
+                    }
+                }
+
+                for (int c = 0; c < 8; c++) {
+                    const float * comp = D + c * bones;
+                    for (std::size_t i = 0; i < n; i++)
+                        Q[c][i] = S[0][i] * comp[j[0][i]] + S[1][i] * comp[j[1][i]] + S[2][i] * comp[j[2][i]] + S[3][i] * comp[j[3][i]];
+                }
+
+                // Separate loop for the sqrt, see sqrtInPlace() in parallel.h
+                for (std::size_t i = 0; i < n; i++)
+                    invLength[i] = 1.0f / std::sqrt(Q[0][i] * Q[0][i] + Q[1][i] * Q[1][i] + Q[2][i] * Q[2][i] + Q[3][i] * Q[3][i] + 1e-20f);
+
+                const float * px = mesh.px.data() + base, * py = mesh.py.data() + base, * pz = mesh.pz.data() + base;
+                const float * nx = mesh.nx.data() + base, * ny = mesh.ny.data() + base, * nz = mesh.nz.data() + base;
+                for (std::size_t i = 0; i < n; i++) {
+                    const float inv = invLength[i];
+                    const float rx = Q[0][i] * inv, ry = Q[1][i] * inv, rz = Q[2][i] * inv, rw = Q[3][i] * inv;
+                    const float dx = Q[4][i] * inv, dy = Q[5][i] * inv, dz = Q[6][i] * inv, dw = Q[7][i] * inv;
+
+                    // Translation = 2 * (rw * d.xyz - dw * r.xyz + cross(r.xyz, d.xyz))
+                    const float tx = 2.0f * (rw * dx - dw * rx + ry * dz - rz * dy);
+                    const float ty = 2.0f * (rw * dy - dw * ry + rz * dx - rx * dz);
+                    const float tz = 2.0f * (rw * dz - dw * rz + rx * dy - ry * dx);
+
+                    // Rotate: v + 2 * cross(r.xyz, cross(r.xyz, v) + rw * v)
+                    const float cx = ry * pz[i] - rz * py[i] + rw * px[i];
+                    const float cy = rz * px[i] - rx * pz[i] + rw * py[i];
+                    const float cz = rx * py[i] - ry * px[i] + rw * pz[i];
+                    X[0][i] = px[i] + 2.0f * (ry * cz - rz * cy) + tx;
+                    X[1][i] = py[i] + 2.0f * (rz * cx - rx * cz) + ty;
+                    X[2][i] = pz[i] + 2.0f * (rx * cy - ry * cx) + tz;
+
+                    const float ex = ry * nz[i] - rz * ny[i] + rw * nx[i];
+                    const float ey = rz * nx[i] - rx * nz[i] + rw * ny[i];
+                    const float ez = rx * ny[i] - ry * nx[i] + rw * nz[i];
+                    N[0][i] = nx[i] + 2.0f * (ry * ez - rz * ey);
+                    N[1][i] = ny[i] + 2.0f * (rz * ex - rx * ez);
+                    N[2][i] = nz[i] + 2.0f * (rx * ey - ry * ex);
+                }
+
+                SkinnedVertex * dst = out + base;
+                for (std::size_t i = 0; i < n; i++) {
+                    dst[i].position = vec3(X[0][i], X[1][i], X[2][i]);
+                    dst[i].normal = vec3(N[0][i], N[1][i], N[2][i]);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Skin a mesh on the CPU, split over threads by vertex range
+     * @param mesh Bind pose
+     * @param palette Skinning matrices of this frame
+     * @param method Linear blend (supports scale) or dual quaternion (no candy wrapper artifacts, rigid bones only)
+     * @param out Output vertices, mesh.size() entries (can be mapped GPU memory, written sequentially)
+     * @param threads Number of threads, 0 = hardwareThreadCount()
+     * @param stats Optional output stats
+     */
+    inline void skinVertices(const SkinnedMesh &mesh, const SkinningPalette &palette, SkinningMethod method,
+            SkinnedVertex * out, unsigned threads = 0, SkinningStats * stats = nullptr) {
+        const auto start = std::chrono::steady_clock::now();
+        if (!threads) threads = hardwareThreadCount();
+        threads = (unsigned)std::clamp<std::size_t>(mesh.size() / 4096, 1, threads);
+
+        parallelFor(0, mesh.size(), [&](std::size_t begin, std::size_t end, unsigned) {
+            if (method == SkinningMethod::LINEAR) Skinning::skin_linear(mesh, palette, out, begin, end);
+            else Skinning::skin_dual_quaternion(mesh, palette, out, begin, end);
+        }, threads, Skinning::BLOCK);
+
+        if (stats) {
+            stats->vertices = mesh.size();
+            stats->bones = palette.size();
+            stats->threads = threads;
+            stats->seconds = secondsSince(start);
+        }
+    }
+
+    /**
+     * @brief Skin a mesh straight into a mapped PersistentBuffer (created with PBFlags::WRITE and at least
+     *        mesh.size() * sizeof(SkinnedVertex) bytes). Waits for the buffer to be free, lock() and
+     *        advance_cycle() it after issuing the draw as usual
+     * @param buffer Buffer to write to
+     * @param index Buffer index (relative to the current cycle)
+     */
+    template <std::size_t bufferCount>
+    void skinVertices(const SkinnedMesh &mesh, const SkinningPalette &palette, SkinningMethod method,
+            PersistentBuffer<bufferCount> &buffer, std::size_t index = 0, unsigned threads = 0, SkinningStats * stats = nullptr) {
+        buffer.wait(index);
+        skinVertices(mesh, palette, method, buffer.template get<SkinnedVertex>(index), threads, stats);
+    }
+}
+
+#endif
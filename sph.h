@@ -0,0 +1,452 @@
+#ifndef BOWSER_UTIL_SPH_H
+#define BOWSER_UTIL_SPH_H
+
+#include "stdint.h"
+#include "types/vector.h"
+#include "morton.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <numbers>
+#include <numeric>
+#include <span>
+#include <vector>
+
+namespace bowser_util {
+    /**
+     * @brief Simulation parameters of SPHFluid
+     */
+    template <class V>
+    struct SPHParams {
+        float smoothingRadius = 1.0f;  // Kernel radius h, also the grid cell size
+        float particleMass = 1.0f;
+        float restDensity = 1.0f;
+        float stiffness = 50.0f;       // Pressure = stiffness * (density - restDensity), clamped at 0
+        float viscosity = 0.5f;
+        float boundaryDamping = 0.5f;  // Velocity kept (reflected) when hitting the bounds
+        V gravity = V(0.0f);
+    };
+
+    /**
+     * @brief Stats of the last SPHFluid::step()
+     */
+    struct SPHStats {
+        std::size_t particles = 0;
+        std::size_t occupiedCells = 0;
+        double averageNeighbours = 0.0;  // Particles within the smoothing radius (including itself)
+        unsigned threads = 0;
+        double sortSeconds = 0.0;
+        double densitySeconds = 0.0;
+        double forceSeconds = 0.0;
+        double integrateSeconds = 0.0;
+        double totalSeconds = 0.0;
+
+        double particlesPerSecond() const { return totalSeconds > 0.0 ? particles / totalSeconds : 0.0; }
+    };
+
+    namespace SPH {
+        constexpr std::size_t LANES = 8; // Independent accumulators of lane_sum()
+
+        // Sum of n floats through independent lanes, so it vectorizes without -ffast-math
+        inline float lane_sum(const float * values, std::size_t n) {
+            float lanes[LANES] = {};
+            std::size_t i = 0;
+            for (; i + LANES <= n; i += LANES)
+                for (std::size_t l = 0; l < LANES; l++) lanes[l] += values[i + l];
+            for (std::size_t l = 0; i < n; i++, l++) lanes[l] += values[i];
+            float sum = 0.0f;
+            for (std::size_t l = 0; l < LANES; l++) sum += lanes[l];
+            return sum;
+        }
+
+        /**
+         * @brief Pressure + viscosity force of every neighbour j on particle i (a free function so the
+         *        restrict qualifiers reach the vectorizer, there are too many streams for alias checks)
+         * @param pressureScale particleMass * spiky gradient constant
+         * @param viscosityScale viscosity * particleMass * viscosity laplacian constant
+         */
+        template <int D>
+        inline void force_terms(std::size_t count, float xi, float yi, float zi, float vxi, float vyi, float vzi, float pi,
+                const float * __restrict x, const float * __restrict y, const float * __restrict z,
+                const float * __restrict vx, const float * __restrict vy, const float * __restrict vz,
+                const float * __restrict pressure, const float * __restrict invDensity, const float * __restrict dist,
+                float * __restrict fx, float * __restrict fy, float * __restrict fz,
+                float h, float pressureScale, float viscosityScale) {
+            for (std::size_t j = 0; j < count; j++) {
+                const float dx = xi - x[j], dy = yi - y[j], dz = D == 3 ? zi - z[j] : 0.0f;
+                const float r = dist[j];
+                // Zero outside the radius, the particle itself cancels out through dx = 0 and v_j - v_i = 0
+                const float w = positivePart(h - r);
+                // Pressure: -m (p_i + p_j) / (2 rho_j) grad W, grad W = spiky (h - r)^2 r_hat
+                const float press = -pressureScale * (pi + pressure[j]) * 0.5f * invDensity[j] * w * w / (r + 1e-12f);
+                // Viscosity: mu m (v_j - v_i) / rho_j lap W
+                const float visc = viscosityScale * invDensity[j] * w;
+                fx[j] = press * dx + visc * (vx[j] - vxi);
+                fy[j] = press * dy + visc * (vy[j] - vyi);
+                if constexpr (D == 3) fz[j] = press * dz + visc * (vz[j] - vzi);
+            }
+        }
+
+        // Per thread copy of the particles around a cell, plus per neighbour terms
+        struct Neighbourhood {
+            std::vector<float> pos[3], vel[3], invDensity, pressure, terms[4];
+
+            void resize(std::size_t n) {
+                if (n <= pressure.size()) return;
+                for (int k = 0; k < 3; k++) {
+                    pos[k].resize(n);
+                    vel[k].resize(n);
+                }
+                for (auto &t : terms) t.resize(n);
+                invDensity.resize(n);
+                pressure.resize(n);
+            }
+        };
+
+        template <class V> constexpr int dimensions() { return sizeof(V) / sizeof(float); }
+    }
+
+    /**
+     * @brief Smoothed particle hydrodynamics (Müller et al. 2003: poly6 density, spiky pressure, viscosity
+     *        laplacian) in a bounded box, on vec2 or vec3
+     *
+     *        Particles are stored SoA and re-sorted every step by grid cell (cell size = smoothing radius) with
+     *        a counting sort, cells are ranked in Morton order so neighbouring cells are mostly close in memory.
+     *        Density / force passes run over the occupied cells in parallel: the particles of the 3^D
+     *        neighbouring cells are copied into contiguous buffers once per cell, then every particle of the
+     *        cell runs branch free loops over them that auto vectorize
+     *
+     *        Particle indices change every step (sorting), use getIds() to track particles
+     *
+     * @tparam V vec2 or vec3
+     */
+    template <class V>
+    class SPHFluid {
+    public:
+        static constexpr int D = SPH::dimensions<V>();
+
+        /**
+         * @param boundsMin Minimum corner of the simulation box
+         * @param boundsMax Maximum corner of the simulation box
+         * @param params Simulation parameters, the grid is sized by params.smoothingRadius
+         */
+        SPHFluid(const V &boundsMin, const V &boundsMax, const SPHParams<V> &params): params(params) {
+            const float lo[3] = { boundsMin.x, boundsMin.y, D == 3 ? component(boundsMin, 2) : 0.0f };
+            const float hi[3] = { boundsMax.x, boundsMax.y, D == 3 ? component(boundsMax, 2) : 0.0f };
+            invCell = 1.0f / params.smoothingRadius;
+            for (int k = 0; k < 3; k++) {
+                this->lo[k] = lo[k];
+                this->hi[k] = hi[k];
+                dims[k] = k < D ? std::clamp((int)std::ceil((hi[k] - lo[k]) * invCell), 1, 65535) : 1;
+            }
+
+            // Morton rank of every cell, so the counting sort lays cells out along a Z curve
+            const std::size_t cells = (std::size_t)dims[0] * dims[1] * dims[2];
+            std::vector<uint64_t> keys(cells);
+            for (int z = 0; z < dims[2]; z++)
+                for (int y = 0; y < dims[1]; y++)
+                    for (int x = 0; x < dims[0]; x++)
+                        keys[linear(x, y, z)] = morton_encode16((uint16_t)x, (uint16_t)y, (uint16_t)z);
+            rankToCell.resize(cells);
+            std::iota(rankToCell.begin(), rankToCell.end(), 0u);
+            std::sort(rankToCell.begin(), rankToCell.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+            cellRank.resize(cells);
+            for (uint32_t r = 0; r < cells; r++) cellRank[rankToCell[r]] = r;
+            cellStart.resize(cells + 1);
+        }
+
+        // Add a particle, its id is the number of particles added before it (since the last clear())
+        void addParticle(const V &position, const V &velocity = V(0.0f)) {
+            for (int k = 0; k < D; k++) {
+                pos[k].push_back(component(position, k));
+                vel[k].push_back(component(velocity, k));
+            }
+            ids.push_back(nextId++);
+        }
+
+        void clear() {
+            for (int k = 0; k < D; k++) {
+                pos[k].clear();
+                vel[k].clear();
+            }
+            ids.clear();
+            nextId = 0;
+        }
+
+        /**
+         * @brief Advance the simulation
+         * @param dt Time step
+         * @param threads Number of threads, 0 = hardwareThreadCount()
+         * @return const SPHStats& Stats of this step
+         */
+        const SPHStats &step(float dt, unsigned threads = 0) {
+            const auto totalStart = std::chrono::steady_clock::now();
+            stats = SPHStats();
+            stats.particles = size();
+            if (!threads) threads = hardwareThreadCount();
+            stats.threads = threads;
+            if (!size()) return stats;
+
+            auto start = std::chrono::steady_clock::now();
+            sort_particles();
+            stats.occupiedCells = occupied.size();
+            stats.sortSeconds = secondsSince(start);
+
+            start = std::chrono::steady_clock::now();
+            neighbourCounts.assign(threads, 0);
+            neighbourhoods.resize(std::max<std::size_t>(neighbourhoods.size(), threads));
+            for_each_cell(threads, [&](uint32_t cell, const uint32_t * ranges, int rangeCount, unsigned thread) {
+                compute_density(cell, ranges, rangeCount, thread);
+            });
+            stats.densitySeconds = secondsSince(start);
+            for (std::size_t count : neighbourCounts) stats.averageNeighbours += count;
+            stats.averageNeighbours /= size();
+
+            start = std::chrono::steady_clock::now();
+            for_each_cell(threads, [&](uint32_t cell, const uint32_t * ranges, int rangeCount, unsigned thread) {
+                compute_forces(cell, ranges, rangeCount, thread);
+            });
+            stats.forceSeconds = secondsSince(start);
+
+            start = std::chrono::steady_clock::now();
+            integrate(dt, threads);
+            stats.integrateSeconds = secondsSince(start);
+
+            stats.totalSeconds = secondsSince(totalStart);
+            return stats;
+        }
+
+        std::size_t size() const { return ids.size(); }
+        V getPosition(std::size_t i) const { return make(pos, i); }
+        V getVelocity(std::size_t i) const { return make(vel, i); }
+        float getDensity(std::size_t i) const { return density[i]; }
+
+        // SoA streams, axis 0 = x, 1 = y, 2 = z
+        std::span<const float> getPositions(int axis) const { return pos[axis]; }
+        std::span<const float> getVelocities(int axis) const { return vel[axis]; }
+        std::span<const float> getDensities() const { return density; }
+        // Id (order of addParticle) of each particle, particles are reordered every step
+        std::span<const uint32_t> getIds() const { return ids; }
+        const SPHStats &getStats() const { return stats; }
+
+        SPHParams<V> params; // Can be changed between steps, except smoothingRadius (sizes the grid)
+
+    private:
+        float lo[3], hi[3], invCell;
+        int dims[3];
+
+        std::vector<float> pos[D], vel[D], acc[D];
+        std::vector<float> density, invDensity, pressure;
+        std::vector<uint32_t> ids;
+        uint32_t nextId = 0;
+
+        // Grid
+        std::vector<uint32_t> cellRank, rankToCell;   // Linear cell <-> Morton rank
+        std::vector<uint32_t> cellStart;              // By rank, particles of rank r are [cellStart[r], cellStart[r + 1])
+        std::vector<uint32_t> occupied;               // Ranks of non empty cells
+        std::vector<uint32_t> particleRank, sortOrder;
+        std::vector<float> scratch;
+        std::vector<uint32_t> scratchIds;
+        std::vector<std::size_t> neighbourCounts;
+        std::vector<SPH::Neighbourhood> neighbourhoods;
+
+        SPHStats stats;
+
+        static float component(const V &v, int k) {
+            if constexpr (D == 3) return k == 0 ? v.x : k == 1 ? v.y : v.z;
+            else return k == 0 ? v.x : v.y;
+        }
+
+        static V make(const std::vector<float> (&data)[D], std::size_t i) {
+            if constexpr (D == 3) return V(data[0][i], data[1][i], data[2][i]);
+            else return V(data[0][i], data[1][i]);
+        }
+
+        std::size_t linear(int x, int y, int z) const { return ((std::size_t)z * dims[1] + y) * dims[0] + x; }
+
+        int cell_coord(float p, int k) const { return std::clamp((int)((p - lo[k]) * invCell), 0, dims[k] - 1); }
+
+        // Counting sort by Morton rank, then permute every stream
+        void sort_particles() {
+            const std::size_t n = size();
+            particleRank.resize(n);
+            std::fill(cellStart.begin(), cellStart.end(), 0u);
+            for (std::size_t i = 0; i < n; i++) {
+                const int x = cell_coord(pos[0][i], 0), y = cell_coord(pos[1][i], 1);
+                const int z = D == 3 ? cell_coord(pos[D - 1][i], 2) : 0;
+                particleRank[i] = cellRank[linear(x, y, z)];
+                cellStart[particleRank[i] + 1]++;
+            }
+            occupied.clear();
+            for (std::size_t r = 0; r + 1 < cellStart.size(); r++) {
+                if (cellStart[r + 1]) occupied.push_back((uint32_t)r);
+                cellStart[r + 1] += cellStart[r];
+            }
+
+            sortOrder.resize(n);
+            {
+                std::vector<uint32_t> &cursor = scratchIds;
+                cursor.assign(cellStart.begin(), cellStart.end() - 1);
+                for (std::size_t i = 0; i < n; i++) sortOrder[cursor[particleRank[i]]++] = (uint32_t)i;
+            }
+
+            scratch.resize(n);
+            auto permute = [&](std::vector<float> &data) {
+                for (std::size_t i = 0; i < n; i++) scratch[i] = data[sortOrder[i]];
+                data.swap(scratch);
+            };
+            for (int k = 0; k < D; k++) {
+                permute(pos[k]);
+                permute(vel[k]);
+                acc[k].resize(n);
+            }
+            scratchIds.resize(n);
+            for (std::size_t i = 0; i < n; i++) scratchIds[i] = ids[sortOrder[i]];
+            ids.swap(scratchIds);
+            density.resize(n);
+            invDensity.resize(n);
+            pressure.resize(n);
+        }
+
+        // Calls func(rank, neighbourRanges, rangeCount, thread) for every occupied cell, ranges = [begin, end) pairs
+        template <class F>
+        void for_each_cell(unsigned threads, F &&func) {
+            parallelFor(0, occupied.size(), [&](std::size_t begin, std::size_t end, unsigned thread) {
+                uint32_t ranges[2 * 27];
+                for (std::size_t c = begin; c < end; c++) {
+                    const uint32_t rank = occupied[c];
+                    const std::size_t cell = rankToCell[rank];
+                    const int x = (int)(cell % dims[0]), y = (int)(cell / dims[0] % dims[1]), z = (int)(cell / ((std::size_t)dims[0] * dims[1]));
+                    int count = 0;
+                    for (int dz = D == 3 ? -1 : 0; dz <= (D == 3 ? 1 : 0); dz++) {
+                        if (z + dz < 0 || z + dz >= dims[2]) continue;
+                        for (int dy = -1; dy <= 1; dy++) {
+                            if (y + dy < 0 || y + dy >= dims[1]) continue;
+                            for (int dx = -1; dx <= 1; dx++) {
+                                if (x + dx < 0 || x + dx >= dims[0]) continue;
+                                const uint32_t r = cellRank[linear(x + dx, y + dy, z + dz)];
+                                if (cellStart[r] == cellStart[r + 1]) continue;
+                                ranges[2 * count] = cellStart[r];
+                                ranges[2 * count + 1] = cellStart[r + 1];
+                                count++;
+                            }
+                        }
+                    }
+                    func(rank, ranges, count, thread);
+                }
+            }, threads, 64);
+        }
+
+        // Copies the particles of the neighbouring cells into contiguous per thread buffers so every
+        // particle of the cell runs one straight loop over them
+        std::size_t gather(const uint32_t * ranges, int rangeCount, SPH::Neighbourhood &nb, bool forces) const {
+            std::size_t count = 0;
+            for (int r = 0; r < rangeCount; r++) count += ranges[2 * r + 1] - ranges[2 * r];
+            nb.resize(count);
+            std::size_t o = 0;
+            for (int r = 0; r < rangeCount; r++) {
+                const uint32_t begin = ranges[2 * r], n = ranges[2 * r + 1] - begin;
+                for (int k = 0; k < D; k++) std::copy_n(pos[k].data() + begin, n, nb.pos[k].data() + o);
+                if (forces) {
+                    for (int k = 0; k < D; k++) std::copy_n(vel[k].data() + begin, n, nb.vel[k].data() + o);
+                    std::copy_n(invDensity.data() + begin, n, nb.invDensity.data() + o);
+                    std::copy_n(pressure.data() + begin, n, nb.pressure.data() + o);
+                }
+                o += n;
+            }
+            return count;
+        }
+
+        void compute_density(uint32_t rank, const uint32_t * ranges, int rangeCount, unsigned thread) {
+            SPH::Neighbourhood &nb = neighbourhoods[thread];
+            const std::size_t count = gather(ranges, rangeCount, nb, false);
+            const float h = params.smoothingRadius, h2 = h * h;
+            const float poly6 = D == 3 ? 315.0f / (64.0f * std::numbers::pi_v<float> * std::pow(h, 9.0f))
+                                       : 4.0f / (std::numbers::pi_v<float> * std::pow(h, 8.0f));
+            const float * __restrict nx = nb.pos[0].data();
+            const float * __restrict ny = nb.pos[1].data();
+            const float * __restrict nz = nb.pos[D - 1].data();
+            float * __restrict w = nb.terms[0].data();
+            std::size_t neighbours = 0;
+
+            for (uint32_t i = cellStart[rank]; i < cellStart[rank + 1]; i++) {
+                const float xi = pos[0][i], yi = pos[1][i], zi = pos[D - 1][i];
+                for (std::size_t j = 0; j < count; j++) {
+                    const float dx = nx[j] - xi, dy = ny[j] - yi, dz = D == 3 ? nz[j] - zi : 0.0f;
+                    const float t = positivePart(h2 - (dx * dx + dy * dy + dz * dz));
+                    w[j] = t * t * t;
+                }
+                uint32_t inside = 0;
+                for (std::size_t j = 0; j < count; j++) inside += w[j] > 0.0f;
+                neighbours += inside;
+                density[i] = params.particleMass * poly6 * SPH::lane_sum(w, count);
+                invDensity[i] = 1.0f / density[i];
+                pressure[i] = std::max(params.stiffness * (density[i] - params.restDensity), 0.0f);
+            }
+            neighbourCounts[thread] += neighbours;
+        }
+
+        void compute_forces(uint32_t rank, const uint32_t * ranges, int rangeCount, unsigned thread) {
+            SPH::Neighbourhood &nb = neighbourhoods[thread];
+            const std::size_t count = gather(ranges, rangeCount, nb, true);
+            const float h = params.smoothingRadius, pi = std::numbers::pi_v<float>;
+            const float spiky = D == 3 ? -45.0f / (pi * std::pow(h, 6.0f)) : -30.0f / (pi * std::pow(h, 5.0f));
+            const float viscLap = D == 3 ? 45.0f / (pi * std::pow(h, 6.0f)) : 40.0f / (pi * std::pow(h, 5.0f));
+            const float m = params.particleMass, mu = params.viscosity;
+            const float * __restrict nx = nb.pos[0].data();
+            const float * __restrict ny = nb.pos[1].data();
+            const float * __restrict nz = nb.pos[D - 1].data();
+            const float * __restrict nvx = nb.vel[0].data();
+            const float * __restrict nvy = nb.vel[1].data();
+            const float * __restrict nvz = nb.vel[D - 1].data();
+            const float * __restrict nInvRho = nb.invDensity.data();
+            const float * __restrict nPressure = nb.pressure.data();
+            float * __restrict dist = nb.terms[0].data();
+            float * __restrict fx = nb.terms[1].data();
+            float * __restrict fy = nb.terms[2].data();
+            float * __restrict fz = nb.terms[3].data();
+
+            for (uint32_t i = cellStart[rank]; i < cellStart[rank + 1]; i++) {
+                const float xi = pos[0][i], yi = pos[1][i], zi = pos[D - 1][i];
+                const float vxi = vel[0][i], vyi = vel[1][i], vzi = vel[D - 1][i];
+                for (std::size_t j = 0; j < count; j++) {
+                    const float dx = xi - nx[j], dy = yi - ny[j], dz = D == 3 ? zi - nz[j] : 0.0f;
+                    dist[j] = dx * dx + dy * dy + dz * dz;
+                }
+                sqrtInPlace(dist, count);
+                SPH::force_terms<D>(count, xi, yi, zi, vxi, vyi, vzi, pressure[i], nx, ny, nz, nvx, nvy, nvz, nPressure, nInvRho,
+                    dist, fx, fy, fz, h, m * spiky, mu * m * viscLap);
+                const float invRhoI = invDensity[i];
+                acc[0][i] = SPH::lane_sum(fx, count) * invRhoI + params.gravity.x;
+                acc[1][i] = SPH::lane_sum(fy, count) * invRhoI + params.gravity.y;
+                if constexpr (D == 3) acc[2][i] = SPH::lane_sum(fz, count) * invRhoI + component(params.gravity, 2);
+            }
+        }
+
+        // Semi implicit Euler, particles leaving the box are clamped and their velocity reflected
+        void integrate(float dt, unsigned threads) {
+            const float damping = params.boundaryDamping;
+            parallelFor(0, size(), [&](std::size_t begin, std::size_t end, unsigned) {
+                for (int k = 0; k < D; k++) {
+                    float * p = pos[k].data(), * v = vel[k].data();
+                    const float * a = acc[k].data();
+                    const float low = lo[k], high = hi[k];
+                    for (std::size_t i = begin; i < end; i++) {
+                        v[i] += a[i] * dt;
+                        p[i] += v[i] * dt;
+                        const bool out = p[i] < low || p[i] > high;
+                        v[i] = out ? -v[i] * damping : v[i];
+                        p[i] = std::clamp(p[i], low, high);
+                    }
+                }
+            }, threads, 16384);
+        }
+    };
+
+    using SPHFluid2D = SPHFluid<vec2>;
+    using SPHFluid3D = SPHFluid<vec3>;
+}
+
+#endif
@@ -0,0 +1,285 @@
+#ifndef BOWSER_UTIL_SPLINE_H
+#define BOWSER_UTIL_SPLINE_H
+
+#include "types/vector.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#ifdef DEBUG
+#include <stdexcept>
+#endif
+
+namespace bowser_util {
+    namespace Splines {
+        // 5 point Gauss-Legendre quadrature on [0, 1]
+        constexpr float GAUSS_X[5] = { 0.0469100770f, 0.2307653449f, 0.5f, 0.7692346551f, 0.9530899230f };
+        constexpr float GAUSS_W[5] = { 0.1184634425f, 0.2393143352f, 0.2844444444f, 0.2393143352f, 0.1184634425f };
+
+        // Knot interval of centripetal / chordal Catmull-Rom, never 0 so duplicated points don't divide by 0
+        template <class V>
+        inline float knot_interval(const V &a, const V &b, float alpha) {
+            return std::max(std::pow(a.distanceSqr(b), alpha * 0.5f), 1e-6f);
+        }
+    }
+
+    /**
+     * @brief Piecewise cubic spline over vec2 / vec3 built from Catmull-Rom points or cubic Bezier
+     *        control points, with an arc length lookup table for constant speed evaluation
+     *
+     *        Parameters:
+     *        - t: spline parameter in [0, 1], segments are equally long in t but not in distance
+     *        - distance: arc length in [0, getLength()]
+     *        - u: normalized arc length in [0, 1], use this for constant speed (ie u = time / duration,
+     *          or eased with easing.h: u = easeInOutCubic(time / duration))
+     *
+     * @tparam V vec2 or vec3
+     */
+    template <class V>
+    class Spline {
+    public:
+        Spline() {}
+
+        /**
+         * @brief Build a Catmull-Rom spline through points, reuses the spline's memory
+         * @param points Points to pass through, at least 2
+         * @param alpha 0 = uniform, 0.5 = centripetal (no cusps or self intersections in a segment), 1 = chordal
+         * @param closed Loop back from the last point to the first
+         * @param samplesPerSegment Arc length table samples per segment
+         */
+        void buildCatmullRom(std::span<const V> points, float alpha = 0.5f, bool closed = false, int samplesPerSegment = 16) {
+            const std::size_t n = points.size();
+            #ifdef DEBUG
+            if (n < 2) throw std::invalid_argument("Catmull-Rom spline needs at least 2 points");
+            #endif
+            segments.clear();
+            if (n < 2) {
+                build_table(samplesPerSegment);
+                return;
+            }
+
+            // Open splines extrapolate the end points so the curve starts and ends at the first / last point
+            auto point = [&](std::ptrdiff_t i) -> V {
+                if (closed) return points[(i % (std::ptrdiff_t)n + n) % n];
+                if (i < 0) return points[0] * 2.0f - points[1];
+                if (i >= (std::ptrdiff_t)n) return points[n - 1] * 2.0f - points[n - 2];
+                return points[i];
+            };
+
+            const std::size_t count = closed ? n : n - 1;
+            segments.reserve(count);
+            for (std::size_t i = 0; i < count; i++) {
+                const V p0 = point((std::ptrdiff_t)i - 1), p1 = point(i), p2 = point(i + 1), p3 = point(i + 2);
+                const float d01 = Splines::knot_interval(p0, p1, alpha);
+                const float d12 = Splines::knot_interval(p1, p2, alpha);
+                const float d23 = Splines::knot_interval(p2, p3, alpha);
+
+                // Tangents of the non uniform Catmull-Rom, scaled to the [0, 1] segment parameter
+                const V m1 = ((p1 - p0) / d01 - (p2 - p0) / (d01 + d12) + (p2 - p1) / d12) * d12;
+                const V m2 = ((p2 - p1) / d12 - (p3 - p1) / (d12 + d23) + (p3 - p2) / d23) * d12;
+                add_hermite(p1, p2, m1, m2);
+            }
+            build_table(samplesPerSegment);
+        }
+
+        /**
+         * @brief Build a spline from cubic Bezier segments sharing end points, reuses the spline's memory
+         * @param controls 3 * segments + 1 control points: start, control, control, end (= next start), ...
+         * @param samplesPerSegment Arc length table samples per segment
+         */
+        void buildBezier(std::span<const V> controls, int samplesPerSegment = 16) {
+            #ifdef DEBUG
+            if (controls.size() < 4 || (controls.size() - 1) % 3)
+                throw std::invalid_argument("Bezier spline needs 3 * segments + 1 control points");
+            #endif
+            segments.clear();
+            const std::size_t count = controls.size() >= 4 ? (controls.size() - 1) / 3 : 0;
+            segments.reserve(count);
+            for (std::size_t i = 0; i < count; i++) {
+                const V &p0 = controls[i * 3], &p1 = controls[i * 3 + 1], &p2 = controls[i * 3 + 2], &p3 = controls[i * 3 + 3];
+                segments.push_back({ p0, (p1 - p0) * 3.0f, (p0 - p1 * 2.0f + p2) * 3.0f, p3 - p0 + (p1 - p2) * 3.0f });
+            }
+            build_table(samplesPerSegment);
+        }
+
+        /**
+         * @brief Position at spline parameter t in [0, 1] (not constant speed), zero on an empty spline
+         */
+        V position(float t) const {
+            if (segments.empty()) return V();
+            float local;
+            const Segment &s = segments[segment_at(t, local)];
+            return ((s.d * local + s.c) * local + s.b) * local + s.a;
+        }
+
+        /**
+         * @brief Derivative at spline parameter t in [0, 1], with respect to the segment parameter, zero on an empty spline
+         */
+        V tangent(float t) const {
+            if (segments.empty()) return V();
+            float local;
+            const Segment &s = segments[segment_at(t, local)];
+            return (s.d * (3.0f * local) + s.c * 2.0f) * local + s.b;
+        }
+
+        /**
+         * @brief Spline parameter t at the given arc length (clamped to the spline)
+         */
+        float parameterAtDistance(float distance) const {
+            std::size_t hint = 0;
+            return parameter_at(distance, hint);
+        }
+
+        V positionAtDistance(float distance) const { return position(parameterAtDistance(distance)); }
+        V tangentAtDistance(float distance) const { return tangent(parameterAtDistance(distance)); }
+
+        /**
+         * @brief Position at normalized arc length u in [0, 1], moving u at a constant rate moves at a constant speed
+         */
+        V positionUniform(float u) const { return positionAtDistance(u * getLength()); }
+
+        /**
+         * @brief Position at time in [0, 1], eased along the arc length, ie positionEased(time, easeInOutSine)
+         * @param ease float(float) mapping [0, 1] -> [0, 1], ie an easing.h function
+         */
+        template <class Ease>
+        V positionEased(float time, Ease &&ease) const { return positionUniform(ease(time)); }
+
+        // Batch evaluation: out[i] = f(in[i]). Sorted (ascending) arc length inputs skip the table search
+
+        void positions(std::span<const float> t, std::span<V> out) const {
+            for (std::size_t i = 0; i < t.size(); i++) out[i] = position(t[i]);
+        }
+
+        void tangents(std::span<const float> t, std::span<V> out) const {
+            for (std::size_t i = 0; i < t.size(); i++) out[i] = tangent(t[i]);
+        }
+
+        /**
+         * @brief Positions (and optionally tangents) at normalized arc lengths u in [0, 1]
+         * @param u Normalized arc lengths
+         * @param out Output positions, u.size() entries
+         * @param outTangents Optional output tangents, u.size() entries (empty = skip)
+         */
+        void positionsUniform(std::span<const float> u, std::span<V> out, std::span<V> outTangents = {}) const {
+            std::size_t hint = 0;
+            const float length = getLength();
+            for (std::size_t i = 0; i < u.size(); i++) {
+                const float t = parameter_at(u[i] * length, hint);
+                out[i] = position(t);
+                if (!outTangents.empty()) outTangents[i] = tangent(t);
+            }
+        }
+
+        /**
+         * @brief Positions at eased times, see positionEased()
+         */
+        template <class Ease>
+        void positionsEased(std::span<const float> times, std::span<V> out, Ease &&ease) const {
+            std::size_t hint = 0;
+            const float length = getLength();
+            for (std::size_t i = 0; i < times.size(); i++)
+                out[i] = position(parameter_at(ease(times[i]) * length, hint));
+        }
+
+        /**
+         * @brief Evenly spaced points along the spline, first and last at the spline's ends
+         * @param out Output positions (at least 2 for both ends)
+         * @param outTangents Optional output tangents, out.size() entries (empty = skip)
+         */
+        void sampleUniform(std::span<V> out, std::span<V> outTangents = {}) const {
+            if (out.empty()) return;
+            std::size_t hint = 0;
+            const float step = out.size() > 1 ? getLength() / (out.size() - 1) : 0.0f;
+            for (std::size_t i = 0; i < out.size(); i++) {
+                const float t = parameter_at(step * i, hint);
+                out[i] = position(t);
+                if (!outTangents.empty()) outTangents[i] = tangent(t);
+            }
+        }
+
+        float getLength() const { return table.empty() ? 0.0f : table.back(); }
+        std::size_t getSegmentCount() const { return segments.size(); }
+        bool empty() const { return segments.empty(); }
+
+    private:
+        // p(t) = a + b t + c t^2 + d t^3, t in [0, 1]
+        struct Segment {
+            V a, b, c, d;
+        };
+
+        std::vector<Segment> segments;
+        std::vector<float> table; // Arc length at every 1 / samplesPerSegment of each segment, table[0] = 0
+        int samples = 16;
+
+        void add_hermite(const V &p1, const V &p2, const V &m1, const V &m2) {
+            segments.push_back({ p1, m1, (p2 - p1) * 3.0f - m1 * 2.0f - m2, (p1 - p2) * 2.0f + m1 + m2 });
+        }
+
+        float speed(const Segment &s, float local) const {
+            return ((s.d * (3.0f * local) + s.c * 2.0f) * local + s.b).length();
+        }
+
+        // Arc length of a segment from t0 to t1
+        float integrate(const Segment &s, float t0, float t1) const {
+            float sum = 0.0f;
+            for (int i = 0; i < 5; i++)
+                sum += Splines::GAUSS_W[i] * speed(s, t0 + (t1 - t0) * Splines::GAUSS_X[i]);
+            return sum * (t1 - t0);
+        }
+
+        void build_table(int samplesPerSegment) {
+            samples = std::max(samplesPerSegment, 1);
+            table.resize(segments.size() * samples + 1);
+            table[0] = 0.0f;
+            const float step = 1.0f / samples;
+            for (std::size_t i = 0, k = 1; i < segments.size(); i++)
+                for (int j = 0; j < samples; j++, k++)
+                    table[k] = table[k - 1] + integrate(segments[i], j * step, (j + 1) * step);
+        }
+
+        std::size_t segment_at(float t, float &local) const {
+            const float scaled = std::clamp(t, 0.0f, 1.0f) * segments.size();
+            const std::size_t index = std::min((std::size_t)scaled, segments.size() - 1);
+            local = scaled - index;
+            return index;
+        }
+
+        // Invert the table: find the sample interval (walking forward from hint if the inputs are
+        // increasing, binary search otherwise), interpolate, then refine with a Newton step
+        float parameter_at(float distance, std::size_t &hint) const {
+            if (segments.empty() || table.back() <= 0.0f) return 0.0f;
+            distance = std::clamp(distance, 0.0f, table.back());
+
+            std::size_t k = std::min(hint, table.size() - 2);
+            if (table[k] <= distance) {
+                std::size_t steps = 0;
+                while (k + 2 < table.size() && table[k + 1] < distance && ++steps < 8) k++;
+                if (k + 2 < table.size() && table[k + 1] < distance)
+                    k = std::upper_bound(table.begin() + k, table.end() - 1, distance) - table.begin() - 1;
+            } else {
+                k = std::upper_bound(table.begin(), table.begin() + k, distance) - table.begin() - 1;
+            }
+            hint = k;
+
+            const std::size_t segment = k / samples;
+            const float step = 1.0f / samples;
+            const float t0 = (k % samples) * step;
+            const float span = table[k + 1] - table[k];
+            float local = t0 + (span > 0.0f ? (distance - table[k]) / span : 0.0f) * step;
+
+            const Segment &s = segments[segment];
+            const float v = speed(s, local);
+            if (v > 1e-6f)
+                local = std::clamp(local - (table[k] + integrate(s, t0, local) - distance) / v, t0, t0 + step);
+            return (segment + local) / segments.size();
+        }
+    };
+
+    using Spline2D = Spline<vec2>;
+    using Spline3D = Spline<vec3>;
+}
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef BOWSER_UTIL_SPRING_H
+#define BOWSER_UTIL_SPRING_H
+
+#include "types/vector.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <numbers>
+#include <span>
+
+namespace bowser_util {
+    /**
+     * @brief Exact step of a damped spring for a fixed frequency, damping and dt. With e = x - target:
+     *        x' = target + xx * e + xv * v
+     *        v' = vx * e + vv * v
+     *        The step is the analytic solution of the spring over dt (target held constant over the
+     *        step), so the result doesn't depend on the frame rate. Compute once per frame, then apply
+     *        to any number of values
+     */
+    struct SpringCoefficients {
+        float xx = 1.0f, xv = 0.0f;
+        float vx = 0.0f, vv = 1.0f;
+        float targetVelocityGain = 0.0f; // Target is offset by targetVelocity * this (anticipation, see SecondOrderDynamics)
+    };
+
+    /**
+     * @brief Coefficients of a second order system y + k1 y' + k2 y'' = x + k3 x' stepped by dt
+     * @param frequency Natural frequency in Hz (speed of the response)
+     * @param damping 0 = oscillates forever, < 1 overshoots, 1 = critically damped, > 1 slow without overshoot
+     * @param dt Time step
+     * @param response Initial response to the target's velocity: 0 = eases in, 1 = immediate, > 1 overshoots,
+     *        < 0 anticipates. Only used when a target velocity is given
+     */
+    inline SpringCoefficients springCoefficients(float frequency, float damping, float dt, float response = 0.0f) {
+        SpringCoefficients c;
+        if (frequency <= 0.0f || dt <= 0.0f) return c;
+        const double w = 2.0 * std::numbers::pi * frequency, z = std::max(damping, 0.0f), t = dt;
+
+        double xx, xv, vx, vv;
+        if (std::abs(z - 1.0) < 1e-4) {
+            const double e = std::exp(-w * t);
+            xx = (1.0 + w * t) * e;
+            xv = t * e;
+            vx = -w * w * t * e;
+            vv = (1.0 - w * t) * e;
+        } else if (z < 1.0) {
+            const double wd = w * std::sqrt(1.0 - z * z), e = std::exp(-z * w * t);
+            const double cs = std::cos(wd * t), sn = std::sin(wd * t);
+            xx = e * (cs + z * w / wd * sn);
+            xv = e * sn / wd;
+            vx = -e * w * w / wd * sn;
+            vv = e * (cs - z * w / wd * sn);
+        } else {
+            const double s = std::sqrt(z * z - 1.0);
+            const double r1 = -w * (z - s), r2 = -w * (z + s);
+            const double e1 = std::exp(r1 * t), e2 = std::exp(r2 * t), inv = 1.0 / (r1 - r2);
+            xx = (r1 * e2 - r2 * e1) * inv;
+            xv = (e1 - e2) * inv;
+            vx = r1 * r2 * (e2 - e1) * inv;
+            vv = (r1 * e1 - r2 * e2) * inv;
+        }
+        c.xx = (float)xx;
+        c.xv = (float)xv;
+        c.vx = (float)vx;
+        c.vv = (float)vv;
+        c.targetVelocityGain = (float)(response * z / w);
+        return c;
+    }
+
+    /**
+     * @brief Coefficients of a critically damped spring (fastest without overshoot)
+     * @param halfLife Time for the distance to the target to halve (roughly, ignoring the initial velocity)
+     * @param dt Time step
+     */
+    inline SpringCoefficients criticalSpringCoefficients(float halfLife, float dt) {
+        // Critically damped decay is (1 + w t) e^(-w t), ~halves at t = 1.678 / w
+        constexpr float HALF = 1.67834699f;
+        return springCoefficients(halfLife > 0.0f ? HALF / (halfLife * 2.0f * std::numbers::pi_v<float>) : 0.0f, 1.0f, dt);
+    }
+
+    /**
+     * @brief Step one spring, T = float, vec2, vec3 or vec4
+     * @param x Value, updated
+     * @param v Velocity, updated
+     * @param target Target value
+     * @param c Coefficients from springCoefficients() / criticalSpringCoefficients()
+     */
+    template <class T>
+    inline void springUpdate(T &x, T &v, const T &target, const SpringCoefficients &c) {
+        const T e = x - target;
+        x = target + e * c.xx + v * c.xv;
+        v = e * c.vx + v * c.vv;
+    }
+
+    // Critically damped spring towards target, frame rate independent
+    template <class T>
+    inline void springCriticallyDamped(T &x, T &v, const T &target, float halfLife, float dt) {
+        springUpdate(x, v, target, criticalSpringCoefficients(halfLife, dt));
+    }
+
+    /**
+     * @brief Step many springs sharing the same coefficients (SoA). The loop is branch free so it
+     *        auto vectorizes. The system is the same on every axis, so vector values can be passed
+     *        as their components, ie a std::vector<vec3> as 3 * size() floats
+     * @param x Values, updated
+     * @param v Velocities, updated
+     * @param target Targets
+     * @param c Coefficients
+     * @param targetVelocity Optional target velocities (empty = 0), scaled by c.targetVelocityGain
+     */
+    inline void springUpdate(std::span<float> x, std::span<float> v, std::span<const float> target,
+            const SpringCoefficients &c, std::span<const float> targetVelocity = {}) {
+        const std::size_t n = x.size();
+        float * __restrict px = x.data();
+        float * __restrict pv = v.data();
+        const float * __restrict pt = target.data();
+        const float xx = c.xx, xv = c.xv, vx = c.vx, vv = c.vv;
+
+        if (targetVelocity.empty() || c.targetVelocityGain == 0.0f) {
+            for (std::size_t i = 0; i < n; i++) {
+                const float e = px[i] - pt[i], vel = pv[i];
+                px[i] = pt[i] + xx * e + xv * vel;
+                pv[i] = vx * e + vv * vel;
+            }
+        } else {
+            const float * __restrict ptv = targetVelocity.data();
+            const float gain = c.targetVelocityGain;
+            for (std::size_t i = 0; i < n; i++) {
+                const float goal = pt[i] + gain * ptv[i];
+                const float e = px[i] - goal, vel = pv[i];
+                px[i] = goal + xx * e + xv * vel;
+                pv[i] = vx * e + vv * vel;
+            }
+        }
+    }
+
+    /**
+     * @brief Second order dynamics following a target (procedural animation / camera follow), parameterized by
+     *        frequency, damping and initial response. The target's velocity is estimated from its previous value
+     *        unless given. Steps are exact for any dt, so the motion is the same at any frame rate
+     * @tparam T float, vec2, vec3 or vec4
+     */
+    template <class T>
+    class SecondOrderDynamics {
+    public:
+        /**
+         * @param frequency Natural frequency in Hz
+         * @param damping 0 = oscillates forever, < 1 overshoots, 1 = critically damped, > 1 slow without overshoot
+         * @param response 0 = eases in, 1 = responds immediately, > 1 overshoots, < 0 anticipates
+         * @param initial Initial value (and target)
+         */
+        SecondOrderDynamics(float frequency, float damping, float response, const T &initial):
+            value(initial), velocity(initial * 0.0f), previousTarget(initial) {
+            setParameters(frequency, damping, response);
+        }
+
+        void setParameters(float frequency, float damping, float response) {
+            this->frequency = frequency;
+            this->damping = damping;
+            this->response = response;
+            cachedDt = -1.0f;
+        }
+
+        // Step towards target, estimating its velocity from the previous target
+        const T &update(float dt, const T &target) {
+            if (dt <= 0.0f) return value;
+            const T targetVelocity = (target - previousTarget) / dt;
+            return update(dt, target, targetVelocity);
+        }
+
+        // Step towards target with a known target velocity
+        const T &update(float dt, const T &target, const T &targetVelocity) {
+            previousTarget = target;
+            if (dt <= 0.0f) return value;
+            if (dt != cachedDt) { // Coefficients only change with dt, fixed timesteps compute them once
+                coefficients = springCoefficients(frequency, damping, dt, response);
+                cachedDt = dt;
+            }
+            springUpdate(value, velocity, target + targetVelocity * coefficients.targetVelocityGain, coefficients);
+            return value;
+        }
+
+        // Jump to a value without any motion
+        void reset(const T &v) {
+            value = previousTarget = v;
+            velocity = v * 0.0f;
+        }
+
+        const T &getValue() const { return value; }
+        const T &getVelocity() const { return velocity; }
+
+    private:
+        T value, velocity, previousTarget;
+        float frequency, damping, response;
+        float cachedDt = -1.0f;
+        SpringCoefficients coefficients;
+    };
+}
+
+#endif
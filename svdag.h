@@ -0,0 +1,332 @@
+#ifndef BOWSER_UTIL_SVDAG_H
+#define BOWSER_UTIL_SVDAG_H
+
+#include "stdint.h"
+#include "types/bitset8.h"
+#include "types/vector.h"
+#include "morton.h"
+#include "parallel.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#ifdef DEBUG
+#include <stdexcept>
+#endif
+
+namespace bowser_util {
+    /**
+     * @brief Sparse octree stored as sorted Morton keys per level, level 0 is the root (key 0) and level
+     *        depth - 1 holds the masks of the voxels themselves
+     */
+    struct MortonOctree {
+        int depth = 0;                                  // Grid of 2^depth voxels per axis
+        std::vector<std::vector<uint64_t>> keys;        // Per level, sorted, key = voxel Morton code >> 3 * (depth - level)
+        std::vector<std::vector<Bitset8>> childMasks;   // Per level, bit = child octant (x << 2 | y << 1 | z)
+
+        /**
+         * @brief Build from voxel Morton codes (morton_encode16), duplicates are fine
+         * @param codes Morton codes of the solid voxels, must be below 2^(3 * depth) (voxels inside the
+         *        2^depth grid). Codes outside throw under DEBUG, otherwise they're dropped
+         * @param depth Levels, 2 - 16
+         */
+        static MortonOctree fromMorton(std::vector<uint64_t> codes, int depth) {
+            MortonOctree tree;
+            tree.depth = std::clamp(depth, 2, 16);
+            tree.keys.resize(tree.depth);
+            tree.childMasks.resize(tree.depth);
+            std::sort(codes.begin(), codes.end());
+            codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+            // Codes outside the grid would leave more than one root key
+            const uint64_t limit = 1ull << (3 * tree.depth);
+            #ifdef DEBUG
+            if (!codes.empty() && codes.back() >= limit)
+                throw std::out_of_range("Morton code outside the 2^depth voxel grid");
+            #endif
+            codes.erase(std::lower_bound(codes.begin(), codes.end(), limit), codes.end());
+            // Each level groups the keys of the level below by parent
+            const std::vector<uint64_t> * children = &codes;
+            for (int level = tree.depth - 1; level >= 0; level--) {
+                auto &keys = tree.keys[level];
+                auto &masks = tree.childMasks[level];
+                for (uint64_t child : *children) {
+                    if (keys.empty() || keys.back() != child >> 3) {
+                        keys.push_back(child >> 3);
+                        masks.push_back(Bitset8());
+                    }
+                    masks.back().set(child & 7);
+                }
+                children = &keys;
+            }
+            return tree;
+        }
+
+        /**
+         * @brief Build from voxel coordinates, see fromMorton()
+         * @param voxels Solid voxels, each component in [0, 2^depth). Voxels outside throw under DEBUG,
+         *        otherwise they're dropped
+         * @param depth Levels, 2 - 16
+         */
+        static MortonOctree fromVoxels(std::span<const ivec3> voxels, int depth) {
+            const int size = 1 << std::clamp(depth, 2, 16);
+            std::vector<uint64_t> codes;
+            codes.reserve(voxels.size());
+            for (const ivec3 &v : voxels) {
+                if (v.x < 0 || v.y < 0 || v.z < 0 || v.x >= size || v.y >= size || v.z >= size) {
+                    #ifdef DEBUG
+                    throw std::out_of_range("Voxel outside the 2^depth grid");
+                    #endif
+                    continue;
+                }
+                codes.push_back(morton_encode16((uint16_t)v.x, (uint16_t)v.y, (uint16_t)v.z));
+            }
+            return fromMorton(std::move(codes), depth);
+        }
+
+        std::size_t nodeCount() const {
+            std::size_t n = 0;
+            for (const auto &level : keys) n += level.size();
+            return n;
+        }
+    };
+
+    /**
+     * @brief Stats of SparseVoxelDAG::build()
+     */
+    struct SVDAGStats {
+        int depth = 0;
+        std::size_t voxels = 0;
+        std::size_t octreeNodes = 0;        // Above the voxel masks
+        std::size_t dagNodes = 0;
+        std::size_t octreeBytes = 0;        // Same format without deduplication
+        std::size_t dagBytes = 0;
+        std::vector<std::size_t> levelNodes, levelUniqueNodes;
+        unsigned threads = 0;
+        double dedupSeconds = 0.0;          // Hashing and merging identical subtrees
+        double writeSeconds = 0.0;          // Laying out the final words
+        double totalSeconds = 0.0;
+
+        double compression() const { return dagBytes ? (double)octreeBytes / dagBytes : 0.0; }
+    };
+
+    namespace SVDAG {
+        inline uint64_t mix(uint64_t h) {
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            return h ^ (h >> 33);
+        }
+    }
+
+    /**
+     * @brief Sparse voxel DAG (Kämpe et al. 2013): an octree where identical subtrees are stored once
+     *
+     *        Built bottom-up from a MortonOctree: the nodes of a level are hashed from their child mask and the
+     *        ids of their (already merged) children, then merged per hash shard in parallel. Ids follow the
+     *        first occurrence, so the result doesn't depend on the thread count
+     *
+     *        Format, one array of 32 bit words, root at 0: a node is a header word (child mask in the low 8 bits)
+     *        followed by one word per child with the child's word offset. Nodes of the level above the voxels
+     *        store their children's voxel masks inline instead, 4 per word
+     */
+    class SparseVoxelDAG {
+    public:
+        /**
+         * @brief Build from an octree
+         * @param tree Octree, see MortonOctree::fromMorton()
+         * @param threads Number of threads, 0 = hardwareThreadCount()
+         * @return const SVDAGStats& Memory / time report
+         */
+        const SVDAGStats &build(const MortonOctree &tree, unsigned threads = 0) {
+            const auto totalStart = std::chrono::steady_clock::now();
+            if (!threads) threads = hardwareThreadCount();
+            depth = tree.depth;
+            words.clear();
+            stats = SVDAGStats();
+            stats.depth = depth;
+            stats.threads = threads;
+            if (depth < 2 || tree.keys[0].empty()) return stats;
+            for (const Bitset8 &mask : tree.childMasks[depth - 1]) stats.voxels += std::popcount((unsigned)(uint8_t)mask);
+
+            // Levels 0 .. depth - 2 become nodes, level depth - 1 (voxel masks) is inlined
+            const int levels = depth - 1;
+            std::vector<std::vector<uint32_t>> ids(levels), firstChild(levels);
+            std::vector<std::vector<uint32_t>> uniqueNodes(levels);
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<uint32_t> voxelMasks(tree.childMasks[depth - 1].begin(), tree.childMasks[depth - 1].end());
+            for (int level = levels - 1; level >= 0; level--) {
+                const auto &masks = tree.childMasks[level];
+                const std::size_t n = masks.size();
+                // Children of a node are contiguous in the level below
+                auto &first = firstChild[level];
+                first.resize(n + 1);
+                first[0] = 0;
+                for (std::size_t i = 0; i < n; i++) first[i + 1] = first[i] + std::popcount((unsigned)(uint8_t)masks[i]);
+
+                // Content of a node: its mask + the ids of its children (the voxel masks for the last level)
+                dedup(masks, first, level == levels - 1 ? voxelMasks : ids[level + 1], threads, ids[level], uniqueNodes[level]);
+                stats.levelNodes.insert(stats.levelNodes.begin(), n);
+                stats.levelUniqueNodes.insert(stats.levelUniqueNodes.begin(), uniqueNodes[level].size());
+                stats.octreeNodes += n;
+                stats.dagNodes += uniqueNodes[level].size();
+            }
+            stats.dedupSeconds = secondsSince(start);
+
+            start = std::chrono::steady_clock::now();
+            write(tree, firstChild, ids, uniqueNodes, threads);
+            stats.writeSeconds = secondsSince(start);
+
+            // Same format without sharing: every octree node written once
+            for (int level = 0; level < levels; level++) {
+                const std::size_t children = firstChild[level].back();
+                stats.octreeBytes += 4 * (tree.keys[level].size() + (level == levels - 1 ? leaf_words(tree, level) : children));
+            }
+            stats.dagBytes = words.size() * 4;
+            stats.totalSeconds = secondsSince(totalStart);
+            return stats;
+        }
+
+        // Voxel lookup, coordinates in [0, 2^depth)
+        bool isSolid(uint32_t x, uint32_t y, uint32_t z) const {
+            if (words.empty() || (x | y | z) >> depth) return false;
+            uint32_t node = 0;
+            for (int level = 0; level < depth - 1; level++) {
+                const int shift = depth - 1 - level;
+                const uint32_t octant = ((x >> shift) & 1) << 2 | ((y >> shift) & 1) << 1 | ((z >> shift) & 1);
+                const uint32_t mask = words[node] & 0xFF;
+                if (!(mask >> octant & 1)) return false;
+                const uint32_t slot = std::popcount(mask & ((1u << octant) - 1));
+                if (level == depth - 2) {
+                    const uint32_t voxels = (words[node + 1 + slot / 4] >> (8 * (slot % 4))) & 0xFF;
+                    return voxels >> ((x & 1) << 2 | (y & 1) << 1 | (z & 1)) & 1;
+                }
+                node = words[node + 1 + slot];
+            }
+            return false;
+        }
+
+        int getDepth() const { return depth; }
+        std::span<const uint32_t> getWords() const { return words; }
+        std::size_t getBytes() const { return words.size() * 4; }
+        const SVDAGStats &getStats() const { return stats; }
+
+    private:
+        int depth = 0;
+        std::vector<uint32_t> words;
+        SVDAGStats stats;
+
+        static std::size_t leaf_words(const MortonOctree &tree, int level) {
+            std::size_t n = 0;
+            for (const Bitset8 &mask : tree.childMasks[level]) n += (std::popcount((unsigned)(uint8_t)mask) + 3) / 4;
+            return n;
+        }
+
+        /**
+         * @brief Merge identical nodes of one level
+         * @param masks Child masks
+         * @param first Children of node i are childIds[first[i], first[i + 1])
+         * @param childIds Merged ids of the children (or voxel masks)
+         * @param outIds Id of every node after merging, ids count first occurrences in order
+         * @param outUnique Index of the first occurrence of every id
+         */
+        static void dedup(const std::vector<Bitset8> &masks, const std::vector<uint32_t> &first, const std::vector<uint32_t> &childIds,
+                unsigned threads, std::vector<uint32_t> &outIds, std::vector<uint32_t> &outUnique) {
+            const std::size_t n = masks.size();
+            std::vector<uint64_t> hashes(n);
+            parallelFor(0, n, [&](std::size_t begin, std::size_t end, unsigned) {
+                for (std::size_t i = begin; i < end; i++) {
+                    uint64_t h = SVDAG::mix((uint8_t)masks[i] + 0x9e3779b97f4a7c15ull);
+                    for (uint32_t c = first[i]; c < first[i + 1]; c++) h = SVDAG::mix(h ^ childIds[c]);
+                    hashes[i] = h;
+                }
+            }, threads, 4096);
+
+            auto equal = [&](uint32_t a, uint32_t b) {
+                if (!(masks[a] == masks[b])) return false;
+                return std::equal(childIds.begin() + first[a], childIds.begin() + first[a + 1], childIds.begin() + first[b]);
+            };
+
+            // Bucket by shard (stable, so every shard sees its nodes in order), then merge shards in parallel
+            const std::size_t shards = std::max<std::size_t>(1, std::min<std::size_t>(threads * 4, n / 1024 + 1));
+            std::vector<uint32_t> shardStart(shards + 1, 0), order(n);
+            for (std::size_t i = 0; i < n; i++) shardStart[hashes[i] % shards + 1]++;
+            for (std::size_t s = 0; s < shards; s++) shardStart[s + 1] += shardStart[s];
+            {
+                std::vector<uint32_t> cursor(shardStart.begin(), shardStart.end() - 1);
+                for (uint32_t i = 0; i < n; i++) order[cursor[hashes[i] % shards]++] = i;
+            }
+
+            std::vector<uint32_t> representative(n);
+            parallelFor(0, shards, [&](std::size_t begin, std::size_t end, unsigned) {
+                std::vector<uint32_t> table;
+                for (std::size_t s = begin; s < end; s++) {
+                    const uint32_t count = shardStart[s + 1] - shardStart[s];
+                    const std::size_t size = std::bit_ceil<std::size_t>(std::max<std::size_t>(count * 2, 16));
+                    table.assign(size, UINT32_MAX);
+                    for (uint32_t k = shardStart[s]; k < shardStart[s + 1]; k++) {
+                        const uint32_t i = order[k];
+                        // Open addressing on the high hash bits (the low ones picked the shard)
+                        std::size_t slot = (hashes[i] >> 20) & (size - 1);
+                        while (table[slot] != UINT32_MAX && !(hashes[table[slot]] == hashes[i] && equal(table[slot], i)))
+                            slot = (slot + 1) & (size - 1);
+                        if (table[slot] == UINT32_MAX) table[slot] = i;
+                        representative[i] = table[slot];
+                    }
+                }
+            }, threads, 1);
+
+            outIds.resize(n);
+            outUnique.clear();
+            for (uint32_t i = 0; i < n; i++) {
+                if (representative[i] == i) {
+                    outIds[i] = (uint32_t)outUnique.size();
+                    outUnique.push_back(i);
+                } else {
+                    outIds[i] = outIds[representative[i]];
+                }
+            }
+        }
+
+        // Lay out the unique nodes level by level from the root, so traversal only moves forward
+        void write(const MortonOctree &tree, const std::vector<std::vector<uint32_t>> &firstChild, const std::vector<std::vector<uint32_t>> &ids,
+                const std::vector<std::vector<uint32_t>> &uniqueNodes, unsigned threads) {
+            const int levels = depth - 1;
+            std::vector<std::vector<uint32_t>> offsets(levels);
+            uint32_t total = 0;
+            for (int level = 0; level < levels; level++) {
+                const auto &masks = tree.childMasks[level];
+                auto &offset = offsets[level];
+                offset.resize(uniqueNodes[level].size());
+                for (std::size_t u = 0; u < offset.size(); u++) {
+                    offset[u] = total;
+                    const uint32_t children = std::popcount((unsigned)(uint8_t)masks[uniqueNodes[level][u]]);
+                    total += 1 + (level == levels - 1 ? (children + 3) / 4 : children);
+                }
+            }
+            words.assign(total, 0);
+
+            for (int level = 0; level < levels; level++) {
+                const auto &masks = tree.childMasks[level];
+                const auto &first = firstChild[level];
+                parallelFor(0, uniqueNodes[level].size(), [&](std::size_t begin, std::size_t end, unsigned) {
+                    for (std::size_t u = begin; u < end; u++) {
+                        const uint32_t node = uniqueNodes[level][u];
+                        uint32_t * out = words.data() + offsets[level][u];
+                        out[0] = (uint8_t)masks[node];
+                        for (uint32_t c = first[node], slot = 0; c < first[node + 1]; c++, slot++) {
+                            if (level == levels - 1) out[1 + slot / 4] |= (uint32_t)(uint8_t)tree.childMasks[depth - 1][c] << (8 * (slot % 4));
+                            else out[1 + slot] = offsets[level + 1][ids[level + 1][c]];
+                        }
+                    }
+                }, threads, 4096);
+            }
+        }
+    };
+}
+
+#endif
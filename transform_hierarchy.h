@@ -0,0 +1,361 @@
+#ifndef BOWSER_UTIL_TRANSFORM_HIERARCHY_H
+#define BOWSER_UTIL_TRANSFORM_HIERARCHY_H
+
+#include "raylib.h"
+#include "stdint.h"
+#include "types/vector.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#ifdef DEBUG
+#include <stdexcept>
+#endif
+
+namespace bowser_util {
+    /**
+     * @brief Stats of the last TransformHierarchy::update()
+     */
+    struct TransformHierarchyStats {
+        std::size_t nodes = 0;
+        std::size_t levels = 0;
+        std::size_t updatedNodes = 0;  // World matrices recomputed (dirty nodes + their subtrees)
+        bool rebuilt = false;          // Structure changed, nodes were re-sorted by depth
+        double rebuildSeconds = 0.0;
+        double propagateSeconds = 0.0;
+
+        double nodesPerMs() const { return propagateSeconds > 0.0 ? updatedNodes / (propagateSeconds * 1000.0) : 0.0; }
+    };
+
+    namespace Transforms {
+        // Affine matrix T * R * S from translation, rotation quaternion (x, y, z, w) and scale
+        inline Matrix trs_matrix(const vec3 &t, const vec4 &q, const vec3 &s) {
+            const float x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
+            const float xx = q.x * x2, yy = q.y * y2, zz = q.z * z2;
+            const float xy = q.x * y2, xz = q.x * z2, yz = q.y * z2;
+            const float wx = q.w * x2, wy = q.w * y2, wz = q.w * z2;
+
+            Matrix m;
+            m.m0 = (1.0f - yy - zz) * s.x; m.m4 = (xy - wz) * s.y;         m.m8 = (xz + wy) * s.z;         m.m12 = t.x;
+            m.m1 = (xy + wz) * s.x;        m.m5 = (1.0f - xx - zz) * s.y;  m.m9 = (yz - wx) * s.z;         m.m13 = t.y;
+            m.m2 = (xz - wy) * s.x;        m.m6 = (yz + wx) * s.y;         m.m10 = (1.0f - xx - yy) * s.z; m.m14 = t.z;
+            m.m3 = 0.0f;                   m.m7 = 0.0f;                    m.m11 = 0.0f;                   m.m15 = 1.0f;
+            return m;
+        }
+
+        // a * b for affine matrices (last row 0 0 0 1), straight line code so the compiler can vectorize it
+        inline Matrix mul_affine(const Matrix &a, const Matrix &b) {
+            Matrix m;
+            m.m0 = a.m0 * b.m0 + a.m4 * b.m1 + a.m8 * b.m2;
+            m.m1 = a.m1 * b.m0 + a.m5 * b.m1 + a.m9 * b.m2;
+            m.m2 = a.m2 * b.m0 + a.m6 * b.m1 + a.m10 * b.m2;
+            m.m4 = a.m0 * b.m4 + a.m4 * b.m5 + a.m8 * b.m6;
+            m.m5 = a.m1 * b.m4 + a.m5 * b.m5 + a.m9 * b.m6;
+            m.m6 = a.m2 * b.m4 + a.m6 * b.m5 + a.m10 * b.m6;
+            m.m8 = a.m0 * b.m8 + a.m4 * b.m9 + a.m8 * b.m10;
+            m.m9 = a.m1 * b.m8 + a.m5 * b.m9 + a.m9 * b.m10;
+            m.m10 = a.m2 * b.m8 + a.m6 * b.m9 + a.m10 * b.m10;
+            m.m12 = a.m0 * b.m12 + a.m4 * b.m13 + a.m8 * b.m14 + a.m12;
+            m.m13 = a.m1 * b.m12 + a.m5 * b.m13 + a.m9 * b.m14 + a.m13;
+            m.m14 = a.m2 * b.m12 + a.m6 * b.m13 + a.m10 * b.m14 + a.m14;
+            m.m3 = m.m7 = m.m11 = 0.0f;
+            m.m15 = 1.0f;
+            return m;
+        }
+    }
+
+    /**
+     * @brief Flat transform hierarchy: nodes are stored in arrays sorted by depth with parent indices,
+     *        so world matrices are propagated level by level (parents are always computed before their
+     *        children) instead of recursing through pointers. Only dirty nodes and their subtrees are
+     *        recomputed, large levels are split across threads
+     *
+     *        Nodes are referred to by handles, which stay valid until the node is removed. Structural
+     *        changes (add / remove / setParent) are applied by re-sorting at the next update()
+     *
+     * Example:
+     * TransformHierarchy scene;
+     * auto body = scene.add(TransformHierarchy::NONE, vec3(0, 1, 0));
+     * auto arm = scene.add(body, vec3(0.5f, 0, 0));
+     * scene.setRotation(body, rotation);
+     * scene.update();
+     * Matrix armWorld = scene.getWorld(arm);
+     */
+    class TransformHierarchy {
+    public:
+        using Handle = uint32_t;
+        static constexpr Handle NONE = UINT32_MAX;
+
+        TransformHierarchy() {}
+
+        /**
+         * @brief Add a node
+         * @param parent Parent handle, NONE for a root
+         * @param position Local translation
+         * @param rotation Local rotation quaternion (x, y, z, w)
+         * @param scale Local scale
+         * @return Handle Handle of the new node
+         */
+        Handle add(Handle parent, const vec3 &position = vec3(0.0f), const vec4 &rotation = vec4(0.0f, 0.0f, 0.0f, 1.0f),
+                const vec3 &scale = vec3(1.0f)) {
+            #ifdef DEBUG
+            if (parent != NONE && !valid(parent)) throw std::invalid_argument("Invalid parent handle");
+            #endif
+            Handle handle;
+            if (!freeHandles.empty()) {
+                handle = freeHandles.back();
+                freeHandles.pop_back();
+            } else {
+                handle = (Handle)parents.size();
+                parents.push_back(NONE);
+                slots.push_back(NONE);
+                alive.push_back(0);
+            }
+            parents[handle] = parent;
+            alive[handle] = 1;
+            slots[handle] = (uint32_t)handles.size();
+
+            // Appended unsorted, the next update() sorts it into its level
+            handles.push_back(handle);
+            parentSlots.push_back(NONE);
+            positions.push_back(position);
+            rotations.push_back(rotation);
+            scales.push_back(scale);
+            worlds.push_back(Transforms::trs_matrix(position, rotation, scale));
+            dirty.push_back(1);
+            dirtyCount++;
+            structureChanged = true;
+            return handle;
+        }
+
+        /**
+         * @brief Remove a node and its whole subtree (their handles become invalid after the next update())
+         */
+        void remove(Handle handle) {
+            if (!valid(handle)) return;
+            alive[handle] = 0;
+            structureChanged = true;
+        }
+
+        /**
+         * @brief Move a node (and its subtree) under another parent, keeping its local transform.
+         *        Ignored if parent is inside the node's subtree
+         */
+        void setParent(Handle handle, Handle parent) {
+            if (!valid(handle) || (parent != NONE && !valid(parent))) return;
+            for (Handle p = parent; p != NONE; p = parents[p])
+                if (p == handle) return; // Would create a cycle
+            parents[handle] = parent;
+            mark_dirty(slots[handle]);
+            structureChanged = true;
+        }
+
+        void setPosition(Handle handle, const vec3 &position) {
+            positions[slots[handle]] = position;
+            mark_dirty(slots[handle]);
+        }
+
+        void setRotation(Handle handle, const vec4 &rotation) {
+            rotations[slots[handle]] = rotation;
+            mark_dirty(slots[handle]);
+        }
+
+        void setScale(Handle handle, const vec3 &scale) {
+            scales[slots[handle]] = scale;
+            mark_dirty(slots[handle]);
+        }
+
+        void setLocal(Handle handle, const vec3 &position, const vec4 &rotation, const vec3 &scale) {
+            const uint32_t slot = slots[handle];
+            positions[slot] = position;
+            rotations[slot] = rotation;
+            scales[slot] = scale;
+            mark_dirty(slot);
+        }
+
+        /**
+         * @brief Re-sort if the structure changed, then recompute the world matrices of dirty nodes and
+         *        their subtrees, level by level
+         * @param threads Number of threads, 0 = hardwareThreadCount()
+         * @param minNodesPerThread Levels are only split across threads in ranges of at least this many nodes
+         * @return const TransformHierarchyStats& Stats of this update
+         */
+        const TransformHierarchyStats &update(unsigned threads = 0, std::size_t minNodesPerThread = 4096) {
+            stats = TransformHierarchyStats();
+            auto start = std::chrono::steady_clock::now();
+            if (structureChanged) {
+                rebuild();
+                stats.rebuilt = true;
+                stats.rebuildSeconds = secondsSince(start);
+                start = std::chrono::steady_clock::now();
+            }
+            stats.nodes = handles.size();
+            stats.levels = levelStarts.empty() ? 0 : levelStarts.size() - 1;
+            if (!dirtyCount) return stats;
+
+            if (!threads) threads = hardwareThreadCount();
+            updatedCounts.assign(threads, 0);
+
+            // Skip the levels above the first dirty node
+            std::size_t level = 0;
+            while (level + 1 < levelStarts.size() && firstDirtySlot >= levelStarts[level + 1]) level++;
+
+            for (; level + 1 < levelStarts.size(); level++) {
+                parallelFor(levelStarts[level], levelStarts[level + 1], [&](std::size_t begin, std::size_t end, unsigned thread) {
+                    std::size_t updated = 0;
+                    for (std::size_t i = begin; i < end; i++) {
+                        const uint32_t parent = parentSlots[i];
+                        const uint8_t d = dirty[i] | (parent != NONE ? dirty[parent] : 0);
+                        if (!d) continue;
+                        dirty[i] = 1;
+                        const Matrix local = Transforms::trs_matrix(positions[i], rotations[i], scales[i]);
+                        worlds[i] = parent != NONE ? Transforms::mul_affine(worlds[parent], local) : local;
+                        updated++;
+                    }
+                    updatedCounts[thread] += updated;
+                }, threads, minNodesPerThread);
+            }
+            std::memset(dirty.data(), 0, dirty.size());
+            dirtyCount = 0;
+            firstDirtySlot = NONE;
+
+            for (std::size_t count : updatedCounts) stats.updatedNodes += count;
+            stats.propagateSeconds = secondsSince(start);
+            return stats;
+        }
+
+        // World matrix, as of the last update()
+        const Matrix &getWorld(Handle handle) const { return worlds[slots[handle]]; }
+        vec3 getWorldPosition(Handle handle) const {
+            const Matrix &m = getWorld(handle);
+            return vec3(m.m12, m.m13, m.m14);
+        }
+
+        const vec3 &getPosition(Handle handle) const { return positions[slots[handle]]; }
+        const vec4 &getRotation(Handle handle) const { return rotations[slots[handle]]; }
+        const vec3 &getScale(Handle handle) const { return scales[slots[handle]]; }
+        Handle getParent(Handle handle) const { return parents[handle]; }
+        bool valid(Handle handle) const { return handle < alive.size() && alive[handle]; }
+
+        // World matrices of every node in depth order (ie for instanced drawing), getHandles()[i] is the node of getWorlds()[i]
+        std::span<const Matrix> getWorlds() const { return worlds; }
+        std::span<const Handle> getHandles() const { return handles; }
+
+        std::size_t size() const { return handles.size(); }
+        const TransformHierarchyStats &getStats() const { return stats; }
+
+    private:
+        // Per handle
+        std::vector<Handle> parents;
+        std::vector<uint32_t> slots;
+        std::vector<uint8_t> alive;
+        std::vector<Handle> freeHandles;
+
+        // Per slot, sorted by depth after rebuild()
+        std::vector<Handle> handles;
+        std::vector<uint32_t> parentSlots;
+        std::vector<vec3> positions;
+        std::vector<vec4> rotations;
+        std::vector<vec3> scales;
+        std::vector<Matrix> worlds;
+        std::vector<uint8_t> dirty;
+        std::vector<std::size_t> levelStarts; // Slot ranges of each depth, levelStarts.back() = size()
+
+        std::size_t dirtyCount = 0;
+        uint32_t firstDirtySlot = NONE;
+        bool structureChanged = false;
+        std::vector<std::size_t> updatedCounts;
+        TransformHierarchyStats stats;
+
+        // Scratch for rebuild()
+        std::vector<int32_t> depths;
+        std::vector<Handle> walk;
+        std::vector<uint32_t> order;
+
+        void mark_dirty(uint32_t slot) {
+            if (!dirty[slot]) {
+                dirty[slot] = 1;
+                dirtyCount++;
+            }
+            firstDirtySlot = std::min(firstDirtySlot, slot);
+        }
+
+        template <class T>
+        void permute(std::vector<T> &data) {
+            std::vector<T> sorted(order.size());
+            for (std::size_t i = 0; i < order.size(); i++) sorted[i] = data[order[i]];
+            data.swap(sorted);
+        }
+
+        // Drop removed subtrees, compute depths and counting sort the slots by depth (stable, so siblings keep their order)
+        void rebuild() {
+            structureChanged = false;
+            const std::size_t handleCount = parents.size();
+
+            // Depth of each live node, -1 = unknown, -2 = removed (or under a removed node)
+            depths.assign(handleCount, -1);
+            for (Handle h = 0; h < handleCount; h++)
+                if (!alive[h]) depths[h] = -2;
+            for (Handle h = 0; h < handleCount; h++) {
+                if (depths[h] != -1) continue;
+                walk.clear();
+                Handle p = h;
+                while (p != NONE && depths[p] == -1) {
+                    walk.push_back(p);
+                    p = parents[p];
+                }
+                int32_t depth = p == NONE ? -1 : depths[p];
+                for (std::size_t i = walk.size(); i-- > 0;) {
+                    depth = depth == -2 ? -2 : depth + 1;
+                    depths[walk[i]] = depth;
+                }
+            }
+
+            int32_t maxDepth = -1;
+            for (Handle handle : handles) maxDepth = std::max(maxDepth, depths[handle]);
+            levelStarts.assign(maxDepth + 2, 0);
+            for (Handle handle : handles)
+                if (depths[handle] >= 0) levelStarts[depths[handle] + 1]++;
+            for (std::size_t l = 1; l < levelStarts.size(); l++) levelStarts[l] += levelStarts[l - 1];
+
+            // order[newSlot] = oldSlot
+            order.resize(levelStarts.back());
+            std::vector<std::size_t> cursor(levelStarts.begin(), levelStarts.end() - 1);
+            for (uint32_t slot = 0; slot < handles.size(); slot++) {
+                const Handle handle = handles[slot];
+                if (depths[handle] >= 0) order[cursor[depths[handle]]++] = slot;
+                else { // Removed, free the handle
+                    alive[handle] = 0;
+                    slots[handle] = NONE;
+                    freeHandles.push_back(handle);
+                }
+            }
+
+            permute(handles);
+            permute(positions);
+            permute(rotations);
+            permute(scales);
+            permute(worlds);
+            permute(dirty);
+
+            dirtyCount = 0;
+            firstDirtySlot = NONE;
+            for (uint32_t slot = 0; slot < handles.size(); slot++) slots[handles[slot]] = slot;
+            parentSlots.resize(handles.size());
+            for (uint32_t slot = 0; slot < handles.size(); slot++) {
+                const Handle parent = parents[handles[slot]];
+                parentSlots[slot] = parent == NONE ? NONE : slots[parent];
+                if (dirty[slot]) {
+                    dirtyCount++;
+                    firstDirtySlot = std::min(firstDirtySlot, slot);
+                }
+            }
+        }
+    };
+}
+
+#endif
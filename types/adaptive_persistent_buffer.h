@@ -0,0 +1,295 @@
+#ifndef BOWSER_UTIL_ADAPTIVE_PERSISTENT_BUFFER_H
+#define BOWSER_UTIL_ADAPTIVE_PERSISTENT_BUFFER_H
+
+#include <glad.h>
+#include "rlgl.h"
+#include "persistent_buffer.h"
+#include "gl_state.h"
+#include "../parallel.h"
+#include <cstddef>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+namespace bowser_util {
+    /**
+     * @brief Fence statistics for an AdaptivePersistentBuffer, accumulated until resetStats()
+     */
+    struct PersistentBufferStats {
+        std::size_t waits = 0;       // Number of wait() calls on a locked buffer
+        std::size_t stalls = 0;      // wait() calls where the fence wasn't signaled yet (CPU blocked)
+        double stallSeconds = 0.0;   // Total time blocked in wait()
+        std::size_t grows = 0;       // Times buffers were added
+        std::size_t shrinks = 0;     // Times buffers were removed
+        std::size_t peakBufferCount = 0;
+
+        double stallRatio() const { return waits ? (double)stalls / waits : 0.0; }
+    };
+
+    /**
+     * @brief Same as PersistentBuffer, but the number of buffers is chosen at runtime
+     * Measures how often wait() actually blocks and adds buffers when it stalls too often, or
+     * removes buffers when a smaller ring wouldn't have stalled either (the fence of the buffer
+     * that would have been reused with fewer buffers was already signaled).
+     *
+     * The count only changes inside advance_cycle(), so pointers from get() should not be
+     * kept across cycles. For the WRITE_ALT_READ / READ_ALT_WRITE flags buffers are added and
+     * removed in pairs to keep the alternating pattern.
+     */
+    class AdaptivePersistentBuffer {
+    public:
+        /**
+         * @brief Tuning parameters for when to grow / shrink
+         */
+        struct Tuning {
+            std::size_t window = 60;       // Number of cycles between adjustments
+            float growStallRatio = 0.05f;  // Grow if more than this fraction of waits in a window stalled
+        };
+
+        // Create an adaptive persistent buffer
+        // @param target: Target buffer binding ie GL_SHADER_STORAGE_BUFFER
+        // @param size: Size of each buffer in bytes
+        // @param rwFlag: Additional flags, see the PBFlags enum
+        // @param minCount: Minimum number of buffers, at least 1 (2 for the alternating flags)
+        // @param maxCount: Maximum number of buffers, raised to minCount
+        // Limits that aren't positive multiples of 2 for the alternating flags throw under DEBUG, otherwise they're rounded
+        // @param initialCount: Number of buffers to start with (clamped to [minCount, maxCount])
+        AdaptivePersistentBuffer(GLenum target, GLsizeiptr size, PBFlags rwFlag,
+                std::size_t minCount = 2, std::size_t maxCount = 8, std::size_t initialCount = 3);
+        AdaptivePersistentBuffer() {}
+        ~AdaptivePersistentBuffer();
+
+        AdaptivePersistentBuffer(const AdaptivePersistentBuffer &other) = delete;
+        AdaptivePersistentBuffer(AdaptivePersistentBuffer &&other) { if (this != &other) swap(other); }
+        AdaptivePersistentBuffer &operator=(const AdaptivePersistentBuffer &other) = delete;
+        AdaptivePersistentBuffer &operator=(AdaptivePersistentBuffer &&other) {
+            if (this != &other) swap(other);
+            return *this;
+        }
+
+        std::size_t getBufferCount() const { return slots.size(); }
+        std::size_t size() const { return _size; }
+
+        void swap(AdaptivePersistentBuffer &other) noexcept {
+            std::swap(target, other.target);
+            std::swap(flag, other.flag);
+            std::swap(slots, other.slots);
+            std::swap(cycle, other.cycle);
+            std::swap(_size, other._size);
+            std::swap(minCount, other.minCount);
+            std::swap(maxCount, other.maxCount);
+            std::swap(step, other.step);
+            std::swap(tuning, other.tuning);
+            std::swap(window, other.window);
+            std::swap(stats, other.stats);
+        }
+
+        void lock(std::size_t i = 0);
+        void wait(std::size_t i = 0);
+
+        // Cycle forward all the ids, may add or remove buffers
+        void advance_cycle();
+
+        // Get buffer at id, also taking into account cycle
+        GLuint getId(std::size_t i) const { return slots[(cycle + i) % slots.size()].id; }
+
+        // Get pointer at index i, respecting cycle
+        template <class T = void>
+        T * get(std::size_t i) { return (T*)slots[(cycle + i) % slots.size()].ptr; }
+
+        // Get target binding
+        GLenum getTarget() const { return target; }
+
+        void setTuning(const Tuning &tuning) { this->tuning = tuning; }
+        const Tuning &getTuning() const { return tuning; }
+
+        const PersistentBufferStats &getStats() const { return stats; }
+        void resetStats() {
+            stats = PersistentBufferStats{};
+            stats.peakBufferCount = slots.size();
+        }
+    private:
+        struct Slot {
+            GLuint id = 0;
+            void * ptr = nullptr;
+            GLsync sync = 0;
+        };
+
+        // Counters for the current tuning window
+        struct Window {
+            std::size_t cycles = 0;
+            std::size_t waits = 0;
+            std::size_t stalls = 0;
+            std::size_t slack = 0; // Waits where a smaller ring wouldn't have stalled
+        };
+
+        GLenum target = 0;
+        PBFlags flag = PBFlags::NONE;
+        std::vector<Slot> slots;
+        std::size_t cycle = 0;
+        std::size_t _size = 0;
+        std::size_t minCount = 0, maxCount = 0;
+        std::size_t step = 1;
+        Tuning tuning;
+        Window window;
+        PersistentBufferStats stats;
+
+        Slot create_slot(std::size_t index) const;
+        void destroy_slot(Slot &slot);
+        void grow();
+        void shrink();
+
+        static bool is_signaled(GLsync sync) {
+            const GLenum ret = glClientWaitSync(sync, 0, 0);
+            return ret == GL_ALREADY_SIGNALED || ret == GL_CONDITION_SATISFIED;
+        }
+    };
+
+
+    inline AdaptivePersistentBuffer::AdaptivePersistentBuffer(GLenum target, GLsizeiptr size, PBFlags flag,
+            std::size_t minCount, std::size_t maxCount, std::size_t initialCount):
+        target(target), flag(flag), _size(size), minCount(minCount), maxCount(std::max(minCount, maxCount))
+    {
+        step = (flag == PBFlags::WRITE_ALT_READ || flag == PBFlags::READ_ALT_WRITE) ? 2 : 1;
+        #ifdef DEBUG
+        if (minCount == 0 || minCount % step || this->maxCount % step)
+            throw std::invalid_argument("Buffer count limits must be positive (and even for alternating flags)");
+        #endif
+        // Otherwise round the limits to whole steps, wait() and advance_cycle() need at least one buffer
+        this->minCount = std::max(step, minCount + minCount % step);
+        this->maxCount = std::max(this->minCount, this->maxCount - this->maxCount % step);
+
+        if (size > 0) {
+            std::size_t count = std::clamp(initialCount, this->minCount, this->maxCount);
+            count = std::max(count - count % step, this->minCount);
+            for (std::size_t i = 0; i < count; i++)
+                slots.push_back(create_slot(i));
+        }
+        stats.peakBufferCount = slots.size();
+    }
+
+    inline AdaptivePersistentBuffer::~AdaptivePersistentBuffer() {
+        for (auto &slot : slots)
+            destroy_slot(slot);
+        slots.clear();
+    }
+
+    inline void AdaptivePersistentBuffer::lock(std::size_t i) {
+        Slot &slot = slots[(cycle + i) % slots.size()];
+        if (slot.sync) glDeleteSync(slot.sync);
+        slot.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    inline void AdaptivePersistentBuffer::wait(std::size_t i) {
+        const std::size_t n = slots.size();
+        const std::size_t index = (cycle + i) % n;
+        Slot &slot = slots[index];
+        if (!slot.sync) return;
+
+        stats.waits++;
+        window.waits++;
+
+        if (is_signaled(slot.sync)) {
+            // With step fewer buffers the buffer reused now would have been the one
+            // locked step cycles later. If that one is done too we have buffers to spare
+            const Slot &younger = slots[(index + step) % n];
+            if (n > minCount && younger.sync && is_signaled(younger.sync))
+                window.slack++;
+            return;
+        }
+
+        stats.stalls++;
+        window.stalls++;
+        const auto start = std::chrono::steady_clock::now();
+        while (true) {
+            GLenum waitReturn = glClientWaitSync(slot.sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1);
+            if (waitReturn == GL_ALREADY_SIGNALED || waitReturn == GL_CONDITION_SATISFIED || waitReturn == GL_WAIT_FAILED)
+                break;
+        }
+        stats.stallSeconds += secondsSince(start);
+    }
+
+    inline void AdaptivePersistentBuffer::advance_cycle() {
+        if (slots.empty()) return;
+        cycle = (cycle + 1) % slots.size();
+        window.cycles++;
+
+        // Only resize on a step boundary so alternating read / write pairs stay aligned
+        if (window.cycles < tuning.window || cycle % step != 0) return;
+
+        if (window.waits && window.stalls > tuning.growStallRatio * window.waits) {
+            if (slots.size() + step <= maxCount) grow();
+        } else if (window.waits && window.stalls == 0 && window.slack == window.waits) {
+            if (slots.size() >= minCount + step) shrink();
+        }
+        window = Window{};
+    }
+
+    // Insert fresh buffers at the current position, so they are used next
+    // and the buffer that was about to be reused gets more time
+    inline void AdaptivePersistentBuffer::grow() {
+        for (std::size_t k = 0; k < step; k++)
+            slots.insert(slots.begin() + cycle + k, create_slot(cycle + k));
+        stats.grows++;
+        stats.peakBufferCount = std::max(stats.peakBufferCount, slots.size());
+    }
+
+    // Remove the oldest buffers (the ones about to be reused)
+    inline void AdaptivePersistentBuffer::shrink() {
+        std::vector<std::size_t> indices;
+        for (std::size_t k = 0; k < step; k++)
+            indices.push_back((cycle + k) % slots.size());
+        std::sort(indices.begin(), indices.end(), std::greater<std::size_t>());
+
+        for (std::size_t index : indices) {
+            Slot &slot = slots[index];
+            if (slot.sync) {
+                while (true) {
+                    GLenum waitReturn = glClientWaitSync(slot.sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1);
+                    if (waitReturn != GL_TIMEOUT_EXPIRED) break;
+                }
+            }
+            destroy_slot(slot);
+            slots.erase(slots.begin() + index);
+            if (index < cycle) cycle--;
+        }
+        cycle %= slots.size();
+        stats.shrinks++;
+    }
+
+    inline AdaptivePersistentBuffer::Slot AdaptivePersistentBuffer::create_slot(std::size_t index) const {
+        GLbitfield rwFlag = 0;
+        if (flag == PBFlags::READ || flag == PBFlags::READ_AND_WRITE)
+            rwFlag |= GL_MAP_READ_BIT;
+        if (flag == PBFlags::WRITE || flag == PBFlags::READ_AND_WRITE)
+            rwFlag |= GL_MAP_WRITE_BIT;
+        if (flag == PBFlags::WRITE_ALT_READ)
+            rwFlag = index % 2 == 0 ? GL_MAP_WRITE_BIT : GL_MAP_READ_BIT;
+        else if (flag == PBFlags::READ_ALT_WRITE)
+            rwFlag = index % 2 == 1 ? GL_MAP_WRITE_BIT : GL_MAP_READ_BIT;
+
+        Slot slot;
+        glGenBuffers(1, &slot.id);
+        glState().bindBuffer(target, slot.id);
+        auto flags = rwFlag | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, _size, NULL, flags);
+
+        slot.ptr = glMapBufferRange(target, 0, _size, flags);
+        #ifdef DEBUG
+        if (!slot.ptr) throw std::runtime_error("Failed to map buffer range");
+        #endif
+        return slot;
+    }
+
+    inline void AdaptivePersistentBuffer::destroy_slot(Slot &slot) {
+        if (slot.sync) glDeleteSync(slot.sync);
+        glState().bindBuffer(target, slot.id);
+        glUnmapBuffer(target);
+        glState().deleteBuffers(1, &slot.id);
+        slot = Slot{};
+    }
+}
+
+#endif
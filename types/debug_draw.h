@@ -0,0 +1,299 @@
+#ifndef BOWSER_UTIL_DEBUG_DRAW_H
+#define BOWSER_UTIL_DEBUG_DRAW_H
+
+#include <glad.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "rlgl.h"
+#include "stdint.h"
+#include "persistent_buffer.h"
+#include "spinlock.h"
+#include "gl_state.h"
+#include "vector.h"
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <memory>
+#include <numbers>
+#include <thread>
+#include <vector>
+
+namespace bowser_util {
+    // Vertex format of the debug line list
+    struct DebugVertex {
+        vec3 pos;
+        Color color;
+    };
+
+    /**
+     * @brief Immediate mode debug draw batcher
+     * Lines and wire primitives can be added from any thread, each thread appends to its own
+     * buffer (guarded by an uncontended spinlock). Once per frame submit() gathers all thread
+     * buffers into one PersistentBuffer-backed line list and draws it in a single draw call.
+     * Buffers that stay empty for RELEASE_AFTER_SUBMITS submits free their memory and are handed
+     * to the next new thread, so short lived worker threads don't pile up buffers.
+     *
+     * MUST BE CONSTRUCTED AFTER OPENGL CONTEXT IS INITIALIZED
+     *
+     * Example:
+     * DebugDraw<> debug(1 << 20); // Up to 1M vertices per frame
+     *
+     * // From any thread
+     * debug.box(vec3(0), vec3(1), RED);
+     * debug.sphere(vec3(0, 2, 0), 1.0f, GREEN);
+     *
+     * // Render thread, inside BeginMode3D
+     * debug.submit();
+     *
+     * @tparam bufferCount Number of vertex buffers to cycle through
+     */
+    template <std::size_t bufferCount = 3>
+    class DebugDraw {
+    public:
+        /**
+         * @brief Construct a new debug draw batcher
+         * @param maxVertices Max vertices (2 per line) drawn per frame, extra lines are dropped
+         */
+        DebugDraw(std::size_t maxVertices):
+                maxVertices(maxVertices),
+                vertices(GL_ARRAY_BUFFER, maxVertices * sizeof(DebugVertex), PBFlags::WRITE),
+                instanceId(next_instance_id()) {
+            program = rlLoadShaderCode(VS_CODE, FS_CODE);
+            mvpLoc = glGetUniformLocation(program, "mvp");
+            glGenVertexArrays(1, &vao);
+        }
+        ~DebugDraw() {
+            if (vao) glDeleteVertexArrays(1, &vao);
+            if (program) rlUnloadShaderProgram(program);
+        }
+
+        DebugDraw(const DebugDraw &other) = delete;
+        DebugDraw &operator=(const DebugDraw &other) = delete;
+
+        void line(const vec3 &a, const vec3 &b, Color color) {
+            ThreadBuffer &buf = thread_buffer();
+            unique_spinlock _tmp(buf.lock);
+            buf.data.push_back({ a, color });
+            buf.data.push_back({ b, color });
+        }
+
+        // Add multiple lines at once, points = [a0, b0, a1, b1, ...]
+        void lines(const vec3 * points, std::size_t pointCount, Color color) {
+            ThreadBuffer &buf = thread_buffer();
+            unique_spinlock _tmp(buf.lock);
+            for (std::size_t i = 0; i + 1 < pointCount; i += 2) {
+                buf.data.push_back({ points[i], color });
+                buf.data.push_back({ points[i + 1], color });
+            }
+        }
+
+        // Wire axis aligned box
+        void box(const vec3 &min, const vec3 &max, Color color) {
+            vec3 c[8];
+            for (int i = 0; i < 8; i++)
+                c[i] = vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+            box_edges(c, color);
+        }
+        void box(const BoundingBox &bb, Color color) { box(bb.min, bb.max, color); }
+
+        // Wire sphere drawn as 3 axis aligned circles
+        void sphere(const vec3 &center, float radius, Color color, int segments = 24) {
+            ThreadBuffer &buf = thread_buffer();
+            unique_spinlock _tmp(buf.lock);
+            const float step = 2.0f * std::numbers::pi_v<float> / segments;
+            for (int i = 0; i < segments; i++) {
+                const float c0 = radius * std::cos(i * step), s0 = radius * std::sin(i * step);
+                const float c1 = radius * std::cos((i + 1) * step), s1 = radius * std::sin((i + 1) * step);
+                buf.data.push_back({ center + vec3(c0, s0, 0), color });
+                buf.data.push_back({ center + vec3(c1, s1, 0), color });
+                buf.data.push_back({ center + vec3(c0, 0, s0), color });
+                buf.data.push_back({ center + vec3(c1, 0, s1), color });
+                buf.data.push_back({ center + vec3(0, c0, s0), color });
+                buf.data.push_back({ center + vec3(0, c1, s1), color });
+            }
+        }
+
+        // Wire frustum of a view projection matrix, ie MatrixMultiply(view, projection)
+        void frustum(const Matrix &viewProj, Color color) {
+            const Matrix inv = MatrixInvert(viewProj);
+            vec3 c[8];
+            for (int i = 0; i < 8; i++) {
+                const vec4 p = vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f).transform(inv);
+                c[i] = vec3(p.x / p.w, p.y / p.w, p.z / p.w);
+            }
+            box_edges(c, color);
+        }
+
+        // Camera frustum, aspect defaults to the screen's aspect ratio
+        void frustum(const Camera3D &camera, float nearPlane, float farPlane, Color color, float aspect = 0.0f) {
+            if (aspect <= 0.0f) aspect = (float)GetScreenWidth() / GetScreenHeight();
+            const Matrix view = MatrixLookAt(camera.position, camera.target, camera.up);
+            const Matrix proj = MatrixPerspective(camera.fovy * DEG2RAD, aspect, nearPlane, farPlane);
+            frustum(MatrixMultiply(view, proj), color);
+        }
+
+        /**
+         * @brief Draw everything added since the last submit with the current rlgl
+         *        modelview / projection matrices (ie inside BeginMode3D)
+         */
+        void submit() {
+            submit(MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection()));
+        }
+
+        /**
+         * @brief Draw everything added since the last submit in one draw call and clear the buffers
+         * @param mvp Model view projection matrix
+         */
+        void submit(const Matrix &mvp) {
+            if (!maxVertices) return;
+            vertices.wait(0);
+            DebugVertex * dst = vertices.template get<DebugVertex>(0);
+
+            std::size_t count = 0;
+            lastDropped = 0;
+            {
+                unique_spinlock _tmp(buffersLock);
+                for (auto &buf : threadBuffers) {
+                    unique_spinlock _tmpBuf(buf->lock);
+                    if (buf->data.empty()) {
+                        if (buf->owner != std::thread::id() && ++buf->idleSubmits >= RELEASE_AFTER_SUBMITS)
+                            release(*buf);
+                        continue;
+                    }
+                    buf->idleSubmits = 0;
+                    const std::size_t n = std::min(buf->data.size(), maxVertices - count);
+                    std::copy(buf->data.begin(), buf->data.begin() + n, dst + count);
+                    count += n;
+                    lastDropped += buf->data.size() - n;
+                    buf->data.clear();
+                }
+            }
+            lastVertexCount = count;
+            if (!count) return;
+
+            rlDrawRenderBatchActive(); // Keep ordering with raylib's own batched draws
+            glState().useProgram(program);
+            rlSetUniformMatrix(mvpLoc, mvp);
+
+            glBindVertexArray(vao);
+            glState().bindBuffer(GL_ARRAY_BUFFER, vertices.getId(0));
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex), (void*)offsetof(DebugVertex, pos));
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(DebugVertex), (void*)offsetof(DebugVertex, color));
+            glEnableVertexAttribArray(1);
+            glDrawArrays(GL_LINES, 0, (GLsizei)count);
+            glBindVertexArray(0);
+            glState().useProgram(0);
+
+            vertices.lock(0);
+            vertices.advance_cycle();
+        }
+
+        // Number of vertices drawn / dropped (over maxVertices) in the last submit
+        std::size_t getLastVertexCount() const { return lastVertexCount; }
+        std::size_t getLastDroppedCount() const { return lastDropped; }
+
+        // Submits a thread's buffer has to stay empty before it is released for reuse
+        static constexpr std::size_t RELEASE_AFTER_SUBMITS = 120;
+    private:
+        static constexpr const char * VS_CODE = R"(#version 330
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec4 vertexColor;
+uniform mat4 mvp;
+out vec4 fragColor;
+void main() {
+    fragColor = vertexColor;
+    gl_Position = mvp * vec4(vertexPosition, 1.0);
+}
+)";
+        static constexpr const char * FS_CODE = R"(#version 330
+in vec4 fragColor;
+out vec4 finalColor;
+void main() { finalColor = fragColor; }
+)";
+
+        // Never freed before the batcher, released buffers (no owner) are reused by new threads.
+        // generation changes on release so the old owner's cached pointer misses
+        struct ThreadBuffer {
+            Spinlock lock;
+            std::thread::id owner;
+            std::atomic<uint32_t> generation{0};
+            std::size_t idleSubmits = 0;
+            std::vector<DebugVertex> data;
+        };
+
+        std::size_t maxVertices = 0;
+        PersistentBuffer<bufferCount> vertices;
+        GLuint program = 0, vao = 0;
+        GLint mvpLoc = -1;
+        std::size_t lastVertexCount = 0, lastDropped = 0;
+
+        uint64_t instanceId;
+        Spinlock buffersLock;
+        std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+
+        // Find (or register) the calling thread's buffer, cached per thread
+        ThreadBuffer &thread_buffer() {
+            struct Cache {
+                uint64_t instanceId = 0;
+                ThreadBuffer * buffer = nullptr;
+                uint32_t generation = 0;
+            };
+            thread_local Cache cache;
+            // A buffer released right after this check still exists, the lines just get drawn from it once more
+            if (cache.instanceId == instanceId && cache.generation == cache.buffer->generation.load(std::memory_order_relaxed))
+                return *cache.buffer;
+
+            // Cache miss, this thread might still have a buffer if it used another batcher in between
+            const auto self = std::this_thread::get_id();
+            unique_spinlock _tmp(buffersLock);
+            ThreadBuffer * found = nullptr;
+            for (auto &buf : threadBuffers) {
+                if (buf->owner == self) {
+                    found = buf.get();
+                    break;
+                }
+                if (!found && buf->owner == std::thread::id()) found = buf.get();
+            }
+            if (!found) {
+                threadBuffers.push_back(std::make_unique<ThreadBuffer>());
+                found = threadBuffers.back().get();
+            }
+            if (found->owner != self) {
+                found->owner = self;
+                found->idleSubmits = 0;
+            }
+            cache = Cache{ instanceId, found, found->generation.load(std::memory_order_relaxed) };
+            return *found;
+        }
+
+        // Called from submit() with buffersLock and the buffer's lock held
+        static void release(ThreadBuffer &buf) {
+            buf.owner = std::thread::id();
+            buf.idleSubmits = 0;
+            buf.generation.fetch_add(1, std::memory_order_relaxed);
+            std::vector<DebugVertex>().swap(buf.data);
+        }
+
+        void box_edges(const vec3 c[8], Color color) {
+            static constexpr int EDGES[24] = {
+                0, 1, 2, 3, 4, 5, 6, 7, // x edges
+                0, 2, 1, 3, 4, 6, 5, 7, // y edges
+                0, 4, 1, 5, 2, 6, 3, 7  // z edges
+            };
+            ThreadBuffer &buf = thread_buffer();
+            unique_spinlock _tmp(buf.lock);
+            for (int i = 0; i < 24; i++)
+                buf.data.push_back({ c[EDGES[i]], color });
+        }
+
+        // Ids are never reused, so a thread's cached buffer can't point into a destroyed batcher
+        static uint64_t next_instance_id() {
+            static std::atomic<uint64_t> counter{1};
+            return counter++;
+        }
+    };
+}
+
+#endif
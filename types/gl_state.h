@@ -0,0 +1,194 @@
+#ifndef BOWSER_UTIL_GL_STATE_H
+#define BOWSER_UTIL_GL_STATE_H
+
+#include <glad.h>
+#include <cstddef>
+#include <algorithm>
+#include <iterator>
+
+namespace bowser_util {
+    /**
+     * @brief Number of GL calls that went through the state cache
+     */
+    struct GLStateCounters {
+        std::size_t issued = 0;    // Calls actually sent to the driver
+        std::size_t avoided = 0;   // Calls skipped because the state was already set
+        std::size_t redundant = 0; // Calls that matched the cached state, skipped or not (what enabling would save)
+    };
+
+    /**
+     * @brief Lightweight tracker of GL binding state, used by the library's GL helpers
+     * (PersistentBuffer, UBOBlockWriter, TextureUploader, ...) to skip redundant binds.
+     * Tracks bound buffers per target, indexed buffer ranges, the current program
+     * and textures per texture unit.
+     *
+     * The cache only knows about calls made through it, so anything else that changes
+     * GL state (ie raylib's own draw calls) makes it stale. For that reason skipping is
+     * off by default: calls are always issued, and the ones matching the cached state are
+     * counted as redundant, so you can see what enabling it would save. If you enable it, call
+     * invalidate() after any GL code that doesn't go through the cache, ie once after
+     * EndDrawing() or after raylib draws and before the library's helpers are used.
+     *
+     * Each thread gets its own cache since GL contexts are per thread, use glState()
+     */
+    class GLStateCache {
+    public:
+        static constexpr std::size_t MAX_INDEXED_BINDINGS = 16;
+        static constexpr std::size_t MAX_TEXTURE_UNITS = 32;
+
+        GLStateCache() { invalidate(); }
+        GLStateCache(const GLStateCache &other) = delete;
+        GLStateCache &operator=(const GLStateCache &other) = delete;
+
+        // Enable / disable skipping redundant calls (disabled by default)
+        void setEnabled(bool enabled) { this->enabled = enabled; invalidate(); }
+        bool isEnabled() const { return enabled; }
+
+        // Forget all cached state, next call of each kind is always issued
+        void invalidate() {
+            std::fill(std::begin(buffers), std::end(buffers), UNKNOWN);
+            std::fill(std::begin(textures), std::end(textures), UNKNOWN);
+            for (auto &bindings : indexed)
+                std::fill(std::begin(bindings), std::end(bindings), IndexedBinding{});
+            program = UNKNOWN;
+            activeUnit = UNKNOWN;
+        }
+
+        void bindBuffer(GLenum target, GLuint id) {
+            const int t = buffer_target_index(target);
+            if (t >= 0 && buffers[t] == id && skip()) return;
+            glBindBuffer(target, id);
+            counters.issued++;
+            if (t >= 0) buffers[t] = id;
+        }
+
+        // Also binds to the generic target, like glBindBufferBase does
+        void bindBufferBase(GLenum target, GLuint index, GLuint id) {
+            bind_indexed(target, index, id, 0, -1);
+        }
+
+        // Also binds to the generic target, like glBindBufferRange does
+        void bindBufferRange(GLenum target, GLuint index, GLuint id, GLintptr offset, GLsizeiptr size) {
+            bind_indexed(target, index, id, offset, size);
+        }
+
+        void useProgram(GLuint id) {
+            if (program == id && skip()) return;
+            glUseProgram(id);
+            counters.issued++;
+            program = id;
+        }
+
+        // Bind a texture to a texture unit (0 = GL_TEXTURE0). Side effect: the active texture unit is always
+        // left at `unit` (glActiveTexture is issued when it differs, including GL_TEXTURE0 for unit 0),
+        // code that tracks the active unit itself (ie raylib's rlActiveTextureSlot) must set it again
+        // Only GL_TEXTURE_2D is cached, other targets are always issued
+        void bindTexture(GLuint unit, GLenum target, GLuint id) {
+            // Before the skip check so the active unit is `unit` even when the bind itself is skipped
+            activeTexture(unit);
+            const bool cached = target == GL_TEXTURE_2D && unit < MAX_TEXTURE_UNITS;
+            if (cached && textures[unit] == id && skip()) return;
+            glBindTexture(target, id);
+            counters.issued++;
+            if (cached) textures[unit] = id;
+        }
+
+        void activeTexture(GLuint unit) {
+            if (activeUnit == unit && skip()) return;
+            glActiveTexture(GL_TEXTURE0 + unit);
+            counters.issued++;
+            activeUnit = unit;
+        }
+
+        // Delete buffers, forgetting them in the cache (GL unbinds deleted buffers)
+        void deleteBuffers(GLsizei n, const GLuint * ids) {
+            glDeleteBuffers(n, ids);
+            for (GLsizei i = 0; i < n; i++) {
+                for (auto &bound : buffers)
+                    if (bound == ids[i]) bound = 0;
+                for (auto &bindings : indexed)
+                    for (auto &binding : bindings)
+                        if (binding.id == ids[i]) binding = IndexedBinding{};
+            }
+        }
+
+        const GLStateCounters &getCounters() const { return counters; }
+        void resetCounters() { counters = GLStateCounters{}; }
+    private:
+        static constexpr GLuint UNKNOWN = ~GLuint(0);
+
+        // Generic buffer targets that are tracked
+        static constexpr GLenum BUFFER_TARGETS[] = {
+            GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER,
+            GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_DRAW_INDIRECT_BUFFER, GL_DISPATCH_INDIRECT_BUFFER,
+            GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_ATOMIC_COUNTER_BUFFER
+        };
+        static constexpr std::size_t BUFFER_TARGET_COUNT = sizeof(BUFFER_TARGETS) / sizeof(GLenum);
+
+        // Indexed targets that are tracked, in the same order as indexed[]
+        static constexpr GLenum INDEXED_TARGETS[] = {
+            GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_ATOMIC_COUNTER_BUFFER
+        };
+        static constexpr std::size_t INDEXED_TARGET_COUNT = sizeof(INDEXED_TARGETS) / sizeof(GLenum);
+
+        struct IndexedBinding {
+            GLuint id = UNKNOWN;
+            GLintptr offset = 0;
+            GLsizeiptr size = -1; // -1 = whole buffer (glBindBufferBase)
+        };
+
+        bool enabled = false;
+        GLuint buffers[BUFFER_TARGET_COUNT];
+        IndexedBinding indexed[INDEXED_TARGET_COUNT][MAX_INDEXED_BINDINGS];
+        GLuint textures[MAX_TEXTURE_UNITS];
+        GLuint program;
+        GLuint activeUnit;
+        GLStateCounters counters;
+
+        // A call matched the cached state: count it, true if it should be skipped
+        bool skip() {
+            counters.redundant++;
+            if (!enabled) return false;
+            counters.avoided++;
+            return true;
+        }
+
+        static int buffer_target_index(GLenum target) {
+            for (std::size_t i = 0; i < BUFFER_TARGET_COUNT; i++)
+                if (BUFFER_TARGETS[i] == target) return (int)i;
+            return -1;
+        }
+
+        static int indexed_target_index(GLenum target) {
+            for (std::size_t i = 0; i < INDEXED_TARGET_COUNT; i++)
+                if (INDEXED_TARGETS[i] == target) return (int)i;
+            return -1;
+        }
+
+        void bind_indexed(GLenum target, GLuint index, GLuint id, GLintptr offset, GLsizeiptr size) {
+            const int t = indexed_target_index(target);
+            const bool cached = t >= 0 && index < MAX_INDEXED_BINDINGS;
+
+            if (cached) {
+                const auto &binding = indexed[t][index];
+                if (binding.id == id && binding.offset == offset && binding.size == size && skip()) return;
+            }
+
+            if (size < 0) glBindBufferBase(target, index, id);
+            else glBindBufferRange(target, index, id, offset, size);
+            counters.issued++;
+
+            if (cached) indexed[t][index] = IndexedBinding{ id, offset, size };
+            const int g = buffer_target_index(target);
+            if (g >= 0) buffers[g] = id;
+        }
+    };
+
+    // Get the GL state cache for the calling thread
+    inline GLStateCache &glState() {
+        static thread_local GLStateCache cache;
+        return cache;
+    }
+}
+
+#endif
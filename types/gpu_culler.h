@@ -0,0 +1,265 @@
+#ifndef BOWSER_UTIL_GPU_CULLER_H
+#define BOWSER_UTIL_GPU_CULLER_H
+
+#include <glad.h>
+#include "raylib.h"
+#include "rlgl.h"
+#include "stdint.h"
+#include "persistent_buffer.h"
+#include "program_cache.h"
+#include "gl_state.h"
+#include "vector.h"
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+#ifdef DEBUG
+#include <stdexcept>
+#endif
+
+namespace bowser_util {
+    // Same layout as the arguments glDrawElementsIndirect reads
+    struct DrawElementsIndirectCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    /**
+     * @brief Frustum culling of instances on the GPU with a compute shader
+     * Instance bounding spheres (vec4(center, radius)) are written to a PersistentBuffer SSBO,
+     * the compute shader writes the indices of visible instances to a compacted SSBO and
+     * atomically counts them into the instanceCount of an indirect draw command. The visible
+     * count is copied into a READ persistent buffer and read back readbackFrames frames
+     * later so stats never stall the pipeline.
+     *
+     * Shader bindings: the visible index SSBO should be read in your vertex shader
+     * with gl_InstanceID, ie
+     * layout(std430, binding = 3) readonly buffer Visible { uint visible[]; };
+     *
+     * MUST BE CONSTRUCTED AFTER OPENGL CONTEXT IS INITIALIZED
+     *
+     * @tparam bufferCount Number of bounds buffers to cycle through
+     * @tparam readbackFrames Number of readback buffers = frames of latency for getVisibleCount()
+     */
+    template <std::size_t bufferCount = 3, std::size_t readbackFrames = 4>
+    class GPUCuller {
+        static_assert(readbackFrames >= 2, "Need at least 2 readback buffers to read back asynchronously");
+    public:
+        static constexpr GLuint WORKGROUP_SIZE = 64;
+
+        /**
+         * @brief Construct a new GPU culler
+         * @param maxInstances Max number of instances that can be culled per frame, at least 1 (0 throws under DEBUG,
+         *        otherwise it's raised to 1)
+         * @param cmd Indirect draw command for the mesh, instanceCount is overwritten each frame
+         * @param cache Optional program cache to load the compute shader with
+         */
+        GPUCuller(std::size_t maxInstances, const DrawElementsIndirectCommand &cmd, ProgramBinaryCache * cache = nullptr):
+                maxInstances(checked_max_instances(maxInstances)), command(cmd),
+                bounds(GL_SHADER_STORAGE_BUFFER, this->maxInstances * sizeof(vec4), PBFlags::WRITE),
+                readback(GL_COPY_WRITE_BUFFER, sizeof(GLuint), PBFlags::READ) {
+            program = cache ? cache->loadCompute(SHADER_CODE) : compile_program();
+            if (!program) {
+                #ifdef DEBUG
+                throw std::runtime_error("Failed to build the GPU culling compute shader");
+                #else
+                TraceLog(LOG_ERROR, "GPUCuller: Failed to build the compute shader, nothing will be drawn");
+                #endif
+                command.instanceCount = 0;
+            }
+            planesLoc = glGetUniformLocation(program, "planes");
+            countLoc = glGetUniformLocation(program, "instanceCount");
+
+            GLuint ids[2];
+            glGenBuffers(2, ids);
+            visibleBuffer = ids[0];
+            indirectBuffer = ids[1];
+
+            glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBuffer);
+            glBufferStorage(GL_SHADER_STORAGE_BUFFER, this->maxInstances * sizeof(GLuint), NULL, 0);
+            glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            glBufferStorage(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand), &command, GL_DYNAMIC_STORAGE_BIT);
+        }
+        ~GPUCuller() {
+            if (visibleBuffer) {
+                GLuint ids[2] = { visibleBuffer, indirectBuffer };
+                glState().deleteBuffers(2, ids);
+            }
+            if (program) glDeleteProgram(program);
+        }
+
+        GPUCuller(const GPUCuller &other) = delete;
+        GPUCuller &operator=(const GPUCuller &other) = delete;
+
+        /**
+         * @brief Get the bounds buffer for this frame to write bounding spheres into,
+         *        waits for the GPU to be done with it if needed
+         * @return vec4* maxInstances vec4(center.x, center.y, center.z, radius)
+         */
+        vec4 * beginFrame() {
+            bounds.wait(0);
+            return bounds.template get<vec4>(0);
+        }
+
+        /**
+         * @brief Cull instanceCount instances written since beginFrame() against a frustum,
+         *        does nothing (the draw command keeps 0 instances) if the compute shader failed to build
+         * @param instanceCount Number of bounds written this frame
+         * @param viewProj View projection matrix, ie MatrixMultiply(view, projection)
+         */
+        void cull(std::size_t instanceCount, const Matrix &viewProj) {
+            if (!program) return; // The command was created with 0 instances
+            instanceCount = std::min(instanceCount, maxInstances);
+            read_back();
+            instanceHistory[frames % readbackFrames] = instanceCount;
+
+            // Reset the instance count of the draw command
+            command.instanceCount = 0;
+            glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), &command);
+
+            vec4 planes[6];
+            extractFrustumPlanes(viewProj, planes);
+
+            glState().useProgram(program);
+            glUniform4fv(planesLoc, 6, &planes[0].x);
+            glUniform1ui(countLoc, (GLuint)instanceCount);
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, bounds.getId(0));
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleBuffer);
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, indirectBuffer);
+            glDispatchCompute((GLuint)(instanceCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+            glState().useProgram(0);
+
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+            bounds.lock(0);
+            bounds.advance_cycle();
+
+            // Copy the visible count out for async stats
+            glState().bindBuffer(GL_COPY_READ_BUFFER, indirectBuffer);
+            glState().bindBuffer(GL_COPY_WRITE_BUFFER, readback.getId(0));
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                offsetof(DrawElementsIndirectCommand, instanceCount), 0, sizeof(GLuint));
+            readback.lock(0);
+            readback.advance_cycle();
+            frames++;
+        }
+
+        /**
+         * @brief Bind the buffers for drawing: the indirect command to GL_DRAW_INDIRECT_BUFFER
+         *        and the visible indices to the given SSBO binding
+         * @param visibleBinding SSBO binding index the vertex shader reads visible indices from
+         */
+        void bindForDraw(GLuint visibleBinding = 3) {
+            glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, visibleBinding, visibleBuffer);
+        }
+
+        /**
+         * @brief Get the number of visible instances from readbackFrames - 1 frames ago
+         *        (0 until enough frames have been culled)
+         */
+        GLuint getVisibleCount() const { return visibleCount; }
+        // Instance count of the frame getVisibleCount() refers to
+        GLuint getCulledCount() const { return culledCount; }
+
+        GLuint getIndirectBuffer() const { return indirectBuffer; }
+        GLuint getVisibleBuffer() const { return visibleBuffer; }
+        GLuint getProgram() const { return program; }
+        std::size_t getMaxInstances() const { return maxInstances; }
+
+        /**
+         * @brief Extract normalized frustum planes (xyz = normal pointing inwards, w = distance)
+         *        from a view projection matrix (Gribb / Hartmann)
+         * @param m View projection matrix
+         * @param out 6 planes: left, right, bottom, top, near, far
+         */
+        static void extractFrustumPlanes(const Matrix &m, vec4 out[6]) {
+            const vec4 row0(m.m0, m.m4, m.m8, m.m12);
+            const vec4 row1(m.m1, m.m5, m.m9, m.m13);
+            const vec4 row2(m.m2, m.m6, m.m10, m.m14);
+            const vec4 row3(m.m3, m.m7, m.m11, m.m15);
+            out[0] = row3 + row0;
+            out[1] = row3 - row0;
+            out[2] = row3 + row1;
+            out[3] = row3 - row1;
+            out[4] = row3 + row2;
+            out[5] = row3 - row2;
+            for (int i = 0; i < 6; i++) {
+                const float len = std::sqrt(out[i].x * out[i].x + out[i].y * out[i].y + out[i].z * out[i].z);
+                if (len > 0.0f) out[i] /= len;
+            }
+        }
+    private:
+        static constexpr const char * SHADER_CODE = R"(#version 430
+layout(local_size_x = 64) in;
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 0) readonly buffer Bounds { vec4 bounds[]; };
+layout(std430, binding = 1) writeonly buffer Visible { uint visible[]; };
+layout(std430, binding = 2) buffer Command { DrawCommand cmd; };
+
+uniform vec4 planes[6];
+uniform uint instanceCount;
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= instanceCount) return;
+
+    vec4 sphere = bounds[i];
+    for (int p = 0; p < 6; p++)
+        if (dot(planes[p].xyz, sphere.xyz) + planes[p].w < -sphere.w) return;
+
+    uint slot = atomicAdd(cmd.instanceCount, 1u);
+    visible[slot] = i;
+}
+)";
+
+        std::size_t maxInstances = 0;
+        DrawElementsIndirectCommand command{};
+        PersistentBuffer<bufferCount> bounds;
+        PersistentBuffer<readbackFrames> readback;
+        GLuint program = 0;
+        GLint planesLoc = -1, countLoc = -1;
+        GLuint visibleBuffer = 0, indirectBuffer = 0;
+
+        std::size_t frames = 0;
+        std::size_t instanceHistory[readbackFrames] = {}; // Instance count passed to cull() per readback buffer
+        GLuint visibleCount = 0, culledCount = 0;
+
+        static std::size_t checked_max_instances(std::size_t maxInstances) {
+            #ifdef DEBUG
+            if (maxInstances == 0) throw std::invalid_argument("GPUCuller needs maxInstances > 0");
+            #endif
+            return std::max<std::size_t>(maxInstances, 1);
+        }
+
+        // The shader object is only needed until the program is linked
+        static GLuint compile_program() {
+            const GLuint shader = rlCompileShader(SHADER_CODE, RL_COMPUTE_SHADER);
+            if (!shader) return 0;
+            const GLuint result = rlLoadComputeShaderProgram(shader);
+            glDeleteShader(shader);
+            return result;
+        }
+
+        // Read the oldest readback buffer, it was written readbackFrames - 1 frames ago
+        void read_back() {
+            if (frames + 1 < readbackFrames) return;
+            readback.wait(1);
+            visibleCount = *readback.template get<GLuint>(1);
+            culledCount = (GLuint)instanceHistory[(frames + 1) % readbackFrames];
+        }
+    };
+}
+
+#endif
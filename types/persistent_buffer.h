@@ -3,6 +3,7 @@
 
 #include <glad.h>
 #include "rlgl.h"
+#include "gl_state.h"
 #include <cstddef>
 #include <algorithm>
 #include <stdexcept>
@@ -89,7 +90,7 @@ namespace bowser_util {
                 else if (flag == PBFlags::READ_ALT_WRITE)
                     rwFlag = i % 2 == 1 ? GL_MAP_WRITE_BIT : GL_MAP_READ_BIT;
 
-                glBindBuffer(target, buffsId[i]);
+                glState().bindBuffer(target, buffsId[i]);
                 auto flags = rwFlag | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
                 glBufferStorage(target, size, NULL, flags);
 
@@ -106,10 +107,10 @@ namespace bowser_util {
     PersistentBuffer<bufferCount>::~PersistentBuffer() {
         if (bufferCount && _size) {
             for (int i = 0; i < bufferCount; i++) {
-                glBindBuffer(target, buffsId[i]);
+                glState().bindBuffer(target, buffsId[i]);
                 glUnmapBuffer(target);
             }
-            glDeleteBuffers(bufferCount, buffsId);
+            glState().deleteBuffers(bufferCount, buffsId);
         }
         delete[] buffsId;
         delete[] ptrs;
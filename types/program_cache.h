@@ -0,0 +1,285 @@
+#ifndef BOWSER_UTIL_PROGRAM_CACHE_H
+#define BOWSER_UTIL_PROGRAM_CACHE_H
+
+#include <glad.h>
+#include "raylib.h"
+#include "stdint.h"
+#include "../parallel.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace bowser_util {
+    /**
+     * @brief Cache statistics, time saved is estimated from the compile
+     *        time recorded when each cached binary was first created
+     */
+    struct ProgramCacheStats {
+        std::size_t hits = 0;        // Programs loaded from a cached binary
+        std::size_t misses = 0;      // Programs compiled from source (no cache file / key mismatch)
+        std::size_t rejected = 0;    // Cached binaries the driver refused (ie after a driver update)
+        double compileSeconds = 0.0; // Time spent compiling + linking from source
+        double loadSeconds = 0.0;    // Time spent loading cached binaries
+        double savedSeconds = 0.0;   // Estimated compile time avoided by cache hits, minus the time spent loading them
+    };
+
+    /**
+     * @brief Shader program loader that caches glGetProgramBinary output on disk
+     * Cache files are keyed by a hash of the shader sources and the driver string
+     * (vendor + renderer + version), so a driver update or source change falls
+     * back to compiling and rewrites the cache file.
+     *
+     * MUST BE USED AFTER OPENGL CONTEXT IS INITIALIZED
+     *
+     * Example:
+     * ProgramBinaryCache cache("shader_cache");
+     * GLuint program = cache.load(vertexCode, fragmentCode);
+     * auto writer = UBOBlockWriter(program, uboId, "MyBlock");
+     */
+    class ProgramBinaryCache {
+    public:
+        /**
+         * @brief Construct a new program cache
+         * @param directory Directory to store binaries in, created if it doesn't exist
+         */
+        ProgramBinaryCache(const std::string &directory): directory(directory) {
+            std::error_code err;
+            std::filesystem::create_directories(directory, err);
+
+            GLint formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            supported = formats > 0;
+
+            std::string driver;
+            for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+                const GLubyte * str = glGetString(name);
+                if (str) driver += (const char*)str;
+                driver += '\n';
+            }
+            driverHash = fnv1a(driver.data(), driver.size());
+        }
+
+        /**
+         * @brief Load a vertex + fragment shader program, from the cache if possible
+         * @param vsCode Vertex shader source
+         * @param fsCode Fragment shader source
+         * @return GLuint Program id, 0 on compile / link failure
+         */
+        GLuint load(const char * vsCode, const char * fsCode) {
+            return load_program({ { GL_VERTEX_SHADER, vsCode }, { GL_FRAGMENT_SHADER, fsCode } });
+        }
+
+        /**
+         * @brief Load a compute shader program, from the cache if possible
+         * @param csCode Compute shader source
+         * @return GLuint Program id, 0 on compile / link failure
+         */
+        GLuint loadCompute(const char * csCode) {
+            return load_program({ { GL_COMPUTE_SHADER, csCode } });
+        }
+
+        const ProgramCacheStats &getStats() const { return stats; }
+        bool isSupported() const { return supported; }
+    private:
+        struct Stage {
+            GLenum type;
+            const char * code;
+        };
+
+        // Header written before the binary in each cache file
+        struct FileHeader {
+            uint32_t magic;
+            uint32_t binaryFormat;
+            uint64_t sourceHash;
+            uint64_t driverHash;
+            uint64_t binarySize;
+            double compileSeconds;
+        };
+        static constexpr uint32_t MAGIC = 0x42504243; // "BPBC"
+
+        // Attributes rlLoadShaderProgram binds before linking (rlgl.h defaults), so shaders without
+        // layout(location) qualifiers still line up with raylib meshes
+        static constexpr struct { GLuint location; const char * name; } DEFAULT_ATTRIBUTES[] = {
+            { 0, "vertexPosition" }, { 1, "vertexTexCoord" }, { 2, "vertexNormal" },
+            { 3, "vertexColor" }, { 4, "vertexTangent" }, { 5, "vertexTexCoord2" }
+        };
+
+        std::string directory;
+        uint64_t driverHash = 0;
+        bool supported = false;
+        ProgramCacheStats stats;
+
+        GLuint load_program(std::initializer_list<Stage> stages) {
+            uint64_t sourceHash = 14695981039346656037ull;
+            for (const auto &stage : stages) {
+                sourceHash = fnv1a(&stage.type, sizeof(stage.type), sourceHash);
+                sourceHash = fnv1a(stage.code, strlen(stage.code), sourceHash);
+            }
+            const std::string path = cache_path(sourceHash);
+
+            if (supported) {
+                const auto start = std::chrono::steady_clock::now();
+                double cachedCompileSeconds = 0.0;
+                GLuint program = load_binary(path, sourceHash, cachedCompileSeconds);
+                if (program) {
+                    const double loadTime = secondsSince(start);
+                    stats.hits++;
+                    stats.loadSeconds += loadTime;
+                    stats.savedSeconds += std::max(0.0, cachedCompileSeconds - loadTime);
+                    return program;
+                }
+            }
+
+            stats.misses++;
+            const auto start = std::chrono::steady_clock::now();
+            GLuint program = compile(stages);
+            const double compileTime = secondsSince(start);
+            stats.compileSeconds += compileTime;
+
+            if (program && supported)
+                save_binary(path, program, sourceHash, compileTime);
+            return program;
+        }
+
+        // Returns 0 if there is no usable cache file
+        GLuint load_binary(const std::string &path, uint64_t sourceHash, double &compileSeconds) {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file) return 0;
+            const std::streamoff fileSize = file.tellg();
+            file.seekg(0);
+
+            FileHeader header;
+            if (!file.read((char*)&header, sizeof(header))) return 0;
+            if (header.magic != MAGIC || header.sourceHash != sourceHash || header.driverHash != driverHash)
+                return 0;
+            // Don't trust the size on disk further than the file actually goes
+            if (fileSize < 0 || header.binarySize == 0 || header.binarySize != (uint64_t)fileSize - sizeof(header)) return 0;
+
+            std::vector<char> binary(header.binarySize);
+            if (!file.read(binary.data(), binary.size())) return 0;
+
+            GLuint program = glCreateProgram();
+            glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+            GLint status = GL_FALSE;
+            glGetProgramiv(program, GL_LINK_STATUS, &status);
+            if (status != GL_TRUE) {
+                glDeleteProgram(program);
+                stats.rejected++;
+                return 0;
+            }
+
+            compileSeconds = header.compileSeconds;
+            return program;
+        }
+
+        void save_binary(const std::string &path, GLuint program, uint64_t sourceHash, double compileTime) {
+            GLint length = 0;
+            glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+            if (length <= 0) return;
+
+            std::vector<char> binary(length);
+            GLenum format = 0;
+            glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+            // Written to a temporary file then renamed over the cache file, so a crash mid write never
+            // leaves a torn file behind
+            FileHeader header{ MAGIC, format, sourceHash, driverHash, (uint64_t)length, compileTime };
+            const std::string tmpPath = path + ".tmp";
+            {
+                std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+                file.write((const char*)&header, sizeof(header));
+                file.write(binary.data(), binary.size());
+                file.close();
+                if (!file) {
+                    std::error_code err;
+                    std::filesystem::remove(tmpPath, err);
+                    return;
+                }
+            }
+            std::error_code err;
+            std::filesystem::rename(tmpPath, path, err);
+            if (err) std::filesystem::remove(tmpPath, err);
+        }
+
+        GLuint compile(std::initializer_list<Stage> stages) {
+            GLuint program = glCreateProgram();
+            std::vector<GLuint> shaders;
+            bool ok = true;
+
+            for (const auto &stage : stages) {
+                GLuint shader = glCreateShader(stage.type);
+                glShaderSource(shader, 1, &stage.code, nullptr);
+                glCompileShader(shader);
+
+                GLint status = GL_FALSE;
+                glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+                if (status != GL_TRUE) {
+                    log_error(shader, false);
+                    ok = false;
+                }
+                glAttachShader(program, shader);
+                shaders.push_back(shader);
+            }
+
+            if (ok) {
+                for (const auto &stage : stages) {
+                    if (stage.type != GL_VERTEX_SHADER) continue;
+                    for (const auto &attribute : DEFAULT_ATTRIBUTES) glBindAttribLocation(program, attribute.location, attribute.name);
+                }
+                glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+                glLinkProgram(program);
+                GLint status = GL_FALSE;
+                glGetProgramiv(program, GL_LINK_STATUS, &status);
+                if (status != GL_TRUE) {
+                    log_error(program, true);
+                    ok = false;
+                }
+            }
+
+            for (GLuint shader : shaders) {
+                glDetachShader(program, shader);
+                glDeleteShader(shader);
+            }
+            if (!ok) {
+                glDeleteProgram(program);
+                return 0;
+            }
+            return program;
+        }
+
+        static void log_error(GLuint id, bool isProgram) {
+            GLint length = 0;
+            if (isProgram) glGetProgramiv(id, GL_INFO_LOG_LENGTH, &length);
+            else glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
+
+            std::string log(std::max(length, 1), '\0');
+            if (isProgram) glGetProgramInfoLog(id, length, nullptr, log.data());
+            else glGetShaderInfoLog(id, length, nullptr, log.data());
+            TraceLog(LOG_WARNING, "SHADER: [ID %i] Failed to %s: %s", id, isProgram ? "link" : "compile", log.c_str());
+        }
+
+        std::string cache_path(uint64_t sourceHash) const {
+            char name[32];
+            snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)sourceHash);
+            return (std::filesystem::path(directory) / name).string();
+        }
+
+        static uint64_t fnv1a(const void * data, std::size_t size, uint64_t hash = 14695981039346656037ull) {
+            const uint8_t * bytes = (const uint8_t*)data;
+            for (std::size_t i = 0; i < size; i++) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+    };
+}
+
+#endif
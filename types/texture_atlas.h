@@ -0,0 +1,419 @@
+#ifndef BOWSER_UTIL_TEXTURE_ATLAS_H
+#define BOWSER_UTIL_TEXTURE_ATLAS_H
+
+#include <glad.h>
+#include "raylib.h"
+#include "rlgl.h"
+#include "stdint.h"
+#include "texture_uploader.h"
+#include "vector.h"
+#include "../parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace bowser_util {
+    /**
+     * @brief MaxRects rectangle packer (best short side fit)
+     * Keeps a list of maximal free rectangles, so unlike a skyline packer space can be
+     * given back with free() and reused, which the atlas needs for eviction.
+     * free() merges the rect with free neighbours sharing a full edge, and an insert() that
+     * fails after frees rebuilds the maximal free rects from the used ones before giving up.
+     */
+    class MaxRectsPacker {
+    public:
+        struct Rect { int x, y, w, h; };
+
+        MaxRectsPacker(int width = 0, int height = 0) { reset(width, height); }
+
+        void reset(int width, int height) {
+            this->width = width;
+            this->height = height;
+            freeRects.clear();
+            usedRects.clear();
+            if (width > 0 && height > 0) freeRects.push_back({ 0, 0, width, height });
+            usedArea = 0;
+            fragmented = false;
+        }
+
+        /**
+         * @brief Find a spot for a size x size rectangle
+         * @param size Size of the rectangle
+         * @param pos Output top left position
+         * @return true if it fit
+         */
+        bool insert(const ivec2 &size, ivec2 &pos) {
+            if (size.x <= 0 || size.y <= 0) return false;
+            if (place(size, pos)) return true;
+            if (!fragmented) return false;
+            rebuild();
+            return place(size, pos);
+        }
+
+        // Give a previously inserted rectangle back
+        void free(const ivec2 &pos, const ivec2 &size) {
+            for (std::size_t i = 0; i < usedRects.size(); i++) {
+                const Rect &r = usedRects[i];
+                if (r.x == pos.x && r.y == pos.y && r.w == size.x && r.h == size.y) {
+                    usedRects[i] = usedRects.back();
+                    usedRects.pop_back();
+                    break;
+                }
+            }
+            usedArea -= std::min(usedArea, (std::size_t)size.x * size.y);
+            if (usedRects.empty()) {
+                reset(width, height);
+                return;
+            }
+            freeRects.push_back({ pos.x, pos.y, size.x, size.y });
+            merge();
+            prune();
+            fragmented = true;
+        }
+
+        std::size_t getUsedArea() const { return usedArea; }
+        std::size_t getArea() const { return (std::size_t)width * height; }
+        float occupancy() const { return getArea() ? (float)usedArea / getArea() : 0.0f; }
+    private:
+        int width = 0, height = 0;
+        std::size_t usedArea = 0;
+        std::vector<Rect> freeRects;
+        std::vector<Rect> usedRects;
+        std::vector<Rect> scratch;
+        bool fragmented = false; // Free rects may not be maximal since the last free()
+
+        bool place(const ivec2 &size, ivec2 &pos) {
+            int best = -1;
+            int bestShort = std::numeric_limits<int>::max(), bestLong = std::numeric_limits<int>::max();
+            for (int i = 0; i < (int)freeRects.size(); i++) {
+                const Rect &r = freeRects[i];
+                if (r.w < size.x || r.h < size.y) continue;
+                const int dx = r.w - size.x, dy = r.h - size.y;
+                const int s = std::min(dx, dy), l = std::max(dx, dy);
+                if (s < bestShort || (s == bestShort && l < bestLong)) {
+                    best = i;
+                    bestShort = s;
+                    bestLong = l;
+                }
+            }
+            if (best < 0) return false;
+
+            const Rect placed{ freeRects[best].x, freeRects[best].y, size.x, size.y };
+            split_free_rects(placed);
+            prune();
+            usedRects.push_back(placed);
+            usedArea += (std::size_t)size.x * size.y;
+            pos = ivec2(placed.x, placed.y);
+            return true;
+        }
+
+        // Recompute the maximal free rects by splitting the whole page with every used rect
+        void rebuild() {
+            freeRects.clear();
+            freeRects.push_back({ 0, 0, width, height });
+            for (const Rect &r : usedRects) {
+                split_free_rects(r);
+                prune();
+            }
+            fragmented = false;
+        }
+
+        // Join free rects that share a full edge, until none do
+        void merge() {
+            bool merged = true;
+            while (merged) {
+                merged = false;
+                for (std::size_t i = 0; i < freeRects.size() && !merged; i++) {
+                    for (std::size_t j = i + 1; j < freeRects.size(); j++) {
+                        Rect &a = freeRects[i];
+                        const Rect &b = freeRects[j];
+                        if (a.x == b.x && a.w == b.w && (a.y + a.h == b.y || b.y + b.h == a.y)) {
+                            a.y = std::min(a.y, b.y);
+                            a.h += b.h;
+                        } else if (a.y == b.y && a.h == b.h && (a.x + a.w == b.x || b.x + b.w == a.x)) {
+                            a.x = std::min(a.x, b.x);
+                            a.w += b.w;
+                        } else {
+                            continue;
+                        }
+                        freeRects.erase(freeRects.begin() + j);
+                        merged = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        static bool contains(const Rect &a, const Rect &b) {
+            return b.x >= a.x && b.y >= a.y && b.x + b.w <= a.x + a.w && b.y + b.h <= a.y + a.h;
+        }
+
+        // Replace every free rect overlapping the placed one with up to 4 maximal pieces around it
+        void split_free_rects(const Rect &p) {
+            scratch.clear();
+            for (const Rect &r : freeRects) {
+                if (p.x >= r.x + r.w || p.x + p.w <= r.x || p.y >= r.y + r.h || p.y + p.h <= r.y) {
+                    scratch.push_back(r);
+                    continue;
+                }
+                if (p.x > r.x)             scratch.push_back({ r.x, r.y, p.x - r.x, r.h });
+                if (p.x + p.w < r.x + r.w) scratch.push_back({ p.x + p.w, r.y, r.x + r.w - p.x - p.w, r.h });
+                if (p.y > r.y)             scratch.push_back({ r.x, r.y, r.w, p.y - r.y });
+                if (p.y + p.h < r.y + r.h) scratch.push_back({ r.x, p.y + p.h, r.w, r.y + r.h - p.y - p.h });
+            }
+            freeRects.swap(scratch);
+        }
+
+        // Remove free rects fully contained in another one
+        void prune() {
+            for (std::size_t i = 0; i < freeRects.size(); i++) {
+                for (std::size_t j = i + 1; j < freeRects.size(); j++) {
+                    if (contains(freeRects[j], freeRects[i])) {
+                        freeRects.erase(freeRects.begin() + i);
+                        i--;
+                        break;
+                    }
+                    if (contains(freeRects[i], freeRects[j])) {
+                        freeRects.erase(freeRects.begin() + j);
+                        j--;
+                    }
+                }
+            }
+        }
+    };
+
+    /**
+     * @brief Atlas statistics, counters accumulate until resetStats()
+     */
+    struct TextureAtlasStats {
+        std::size_t pages = 0;
+        std::size_t entries = 0;
+        std::size_t inserts = 0;      // Successful add() calls
+        std::size_t evictions = 0;    // Entries evicted to make room
+        std::size_t failures = 0;     // add() calls that returned nullptr
+        std::size_t usedArea = 0;     // Texels in use (including padding) over all pages
+        std::size_t totalArea = 0;    // Texels over all pages
+        double packSeconds = 0.0;     // Time spent finding space (including evictions)
+        double uploadSeconds = 0.0;   // Time spent copying pixels to staging and submitting
+
+        float occupancy() const { return totalArea ? (float)usedArea / totalArea : 0.0f; }
+    };
+
+    /**
+     * @brief Where an atlas entry lives, use texture + rect with DrawTexturePro / DrawTextureRec
+     */
+    struct AtlasRegion {
+        Texture2D texture;
+        Rectangle rect;
+        int page;
+    };
+
+    /**
+     * @brief Runtime texture atlas
+     * Rectangles (glyphs, generated sprites...) are packed incrementally into fixed size pages
+     * with a MaxRectsPacker and uploaded through a TextureUploader, so many small images share a
+     * few textures and raylib can batch their draws. When all pages are full the least recently
+     * used entries are evicted, entries used in the current frame are never evicted since raylib
+     * may not have flushed draws sampling them yet.
+     *
+     * MUST BE CONSTRUCTED AFTER OPENGL CONTEXT IS INITIALIZED
+     *
+     * @tparam bufferCount Number of staging slots of the uploader
+     */
+    template <std::size_t bufferCount = 3>
+    class TextureAtlas {
+    public:
+        /**
+         * @brief Construct a new texture atlas
+         * @param pageSize Size of each page texture
+         * @param maxPages Max number of pages before entries are evicted
+         * @param stagingSize Bytes per staging slot
+         * @param format Pixel format of the pages and of the pixels passed to add()
+         * @param padding Empty texels kept around each entry to avoid bleeding with filtering, cleared whenever
+         *        an entry is uploaded so reused space doesn't bleed the previous entry
+         */
+        TextureAtlas(const ivec2 &pageSize, int maxPages = 4, GLsizeiptr stagingSize = 4 * 1024 * 1024,
+                int format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, int padding = 1):
+            pageSize(pageSize), maxPages(maxPages), format(format), padding(padding), uploader(stagingSize) {}
+        ~TextureAtlas() {
+            for (auto &page : pages)
+                rlUnloadTexture(page.texture.id);
+        }
+
+        TextureAtlas(const TextureAtlas &other) = delete;
+        TextureAtlas &operator=(const TextureAtlas &other) = delete;
+
+        /**
+         * @brief Find an entry and mark it as used this frame
+         * @return const AtlasRegion* nullptr if not in the atlas (never added or evicted)
+         */
+        const AtlasRegion * find(uint64_t key) {
+            auto it = entries.find(key);
+            if (it == entries.end()) return nullptr;
+            touch(it->second);
+            return &it->second.region;
+        }
+
+        /**
+         * @brief Pack and upload an image, replaces an existing entry with the same key
+         * @param key Unique key, ie (fontId << 32) | codepoint
+         * @param size Size in pixels
+         * @param pixels size.x * size.y pixels in the atlas format, tightly packed
+         * @return const AtlasRegion* nullptr if it doesn't fit even after evicting
+         */
+        const AtlasRegion * add(uint64_t key, const ivec2 &size, const void * pixels) {
+            remove(key);
+
+            const auto packStart = std::chrono::steady_clock::now();
+            const ivec2 padded = size + 2 * padding;
+            int page = -1;
+            ivec2 pos;
+            if (padded.x <= pageSize.x && padded.y <= pageSize.y)
+                page = find_space(padded, pos);
+            stats.packSeconds += secondsSince(packStart);
+            if (page < 0) {
+                stats.failures++;
+                return nullptr;
+            }
+
+            const auto uploadStart = std::chrono::steady_clock::now();
+            const ivec2 texel = pos + padding;
+            if (padding > 0) {
+                // Upload the whole padded rect with a cleared border, reused space still has the pixels
+                // of whatever was removed or evicted there
+                upload_padded(pages[page].texture, pos, size, padded, pixels);
+            } else if (size.x > 0 && size.y > 0) {
+                uploader.updateRec(pages[page].texture, texel.x, texel.y, size.x, size.y, pixels);
+            }
+            stats.uploadSeconds += secondsSince(uploadStart);
+
+            lru.push_front(key);
+            Entry &e = entries[key];
+            e.region = AtlasRegion{ pages[page].texture,
+                Rectangle{ (float)texel.x, (float)texel.y, (float)size.x, (float)size.y }, page };
+            e.pos = pos;
+            e.size = padded;
+            e.lastUsed = frame;
+            e.lruIt = lru.begin();
+            stats.inserts++;
+            return &e.region;
+        }
+
+        // Remove an entry, its space can be reused right away
+        void remove(uint64_t key) {
+            auto it = entries.find(key);
+            if (it == entries.end()) return;
+            pages[it->second.region.page].packer.free(it->second.pos, it->second.size);
+            lru.erase(it->second.lruIt);
+            entries.erase(it);
+        }
+
+        /**
+         * @brief Call once per frame after drawing, hands staged uploads to the GPU and
+         *        makes entries used this frame evictable again
+         */
+        void endFrame() {
+            uploader.endFrame();
+            frame++;
+        }
+
+        const TextureAtlasStats &getStats() {
+            stats.pages = pages.size();
+            stats.entries = entries.size();
+            stats.usedArea = stats.totalArea = 0;
+            for (const auto &page : pages) {
+                stats.usedArea += page.packer.getUsedArea();
+                stats.totalArea += page.packer.getArea();
+            }
+            return stats;
+        }
+        void resetStats() { stats = TextureAtlasStats{}; }
+
+        std::size_t getPageCount() const { return pages.size(); }
+        Texture2D getPage(std::size_t i) const { return pages[i].texture; }
+        TextureUploader<bufferCount> &getUploader() { return uploader; }
+    private:
+        struct Page {
+            Texture2D texture;
+            MaxRectsPacker packer;
+        };
+
+        struct Entry {
+            AtlasRegion region;
+            ivec2 pos, size; // Padded rectangle in the packer
+            std::size_t lastUsed = 0;
+            std::list<uint64_t>::iterator lruIt;
+        };
+
+        ivec2 pageSize;
+        int maxPages;
+        int format;
+        int padding;
+        TextureUploader<bufferCount> uploader;
+        std::vector<Page> pages;
+        std::unordered_map<uint64_t, Entry> entries;
+        std::list<uint64_t> lru; // Most recently used first
+        std::size_t frame = 0;
+        std::vector<uint8_t> paddedScratch; // Zero bordered copy of the entry being uploaded
+        TextureAtlasStats stats;
+
+        void touch(Entry &e) {
+            e.lastUsed = frame;
+            lru.splice(lru.begin(), lru, e.lruIt);
+        }
+
+        // Try existing pages, then a new page, then evict least recently used entries
+        int find_space(const ivec2 &size, ivec2 &pos) {
+            for (int i = 0; i < (int)pages.size(); i++)
+                if (pages[i].packer.insert(size, pos)) return i;
+
+            if ((int)pages.size() < maxPages) {
+                add_page();
+                if (pages.back().packer.insert(size, pos)) return (int)pages.size() - 1;
+            }
+
+            while (!lru.empty()) {
+                const uint64_t key = lru.back();
+                Entry &victim = entries[key];
+                if (victim.lastUsed == frame) break; // Everything left was used this frame
+                const int page = victim.region.page;
+                remove(key);
+                stats.evictions++;
+                if (pages[page].packer.insert(size, pos)) return page;
+            }
+            return -1;
+        }
+
+        void upload_padded(const Texture2D &texture, const ivec2 &pos, const ivec2 &size, const ivec2 &padded, const void * pixels) {
+            const std::size_t rowBytes = GetPixelDataSize(size.x, 1, format);
+            const std::size_t paddedRowBytes = GetPixelDataSize(padded.x, 1, format);
+            const std::size_t borderBytes = GetPixelDataSize(padding, 1, format);
+            paddedScratch.assign(paddedRowBytes * padded.y, 0);
+            const uint8_t * src = (const uint8_t *)pixels;
+            for (int y = 0; y < size.y; y++)
+                std::copy(src + y * rowBytes, src + (y + 1) * rowBytes,
+                    paddedScratch.begin() + (y + padding) * paddedRowBytes + borderBytes);
+            uploader.updateRec(texture, pos.x, pos.y, padded.x, padded.y, paddedScratch.data());
+        }
+
+        void add_page() {
+            // Start cleared, entries clear their own padding when they're uploaded
+            const std::size_t bytes = GetPixelDataSize(pageSize.x, pageSize.y, format);
+            std::vector<uint8_t> zero(bytes, 0);
+            Page page;
+            page.texture.id = rlLoadTexture(zero.data(), pageSize.x, pageSize.y, format, 1);
+            page.texture.width = pageSize.x;
+            page.texture.height = pageSize.y;
+            page.texture.mipmaps = 1;
+            page.texture.format = format;
+            page.packer.reset(pageSize.x, pageSize.y);
+            pages.push_back(page);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,265 @@
+#ifndef BOWSER_UTIL_TEXTURE_UPLOADER_H
+#define BOWSER_UTIL_TEXTURE_UPLOADER_H
+
+#include <glad.h>
+#include "raylib.h"
+#include "rlgl.h"
+#include "persistent_buffer.h"
+#include "gl_state.h"
+#include "../parallel.h"
+#include <cstddef>
+#include <cstring>
+#include <chrono>
+
+#ifdef DEBUG
+#include <stdexcept>
+#endif
+
+namespace bowser_util {
+    /**
+     * @brief Upload statistics, accumulated until resetStats() is called
+     */
+    struct TextureUploadStats {
+        std::size_t uploads = 0;       // Number of glTexSubImage2D calls sourced from staging memory
+        std::size_t fallbacks = 0;     // Uploads too big for a staging slot (uploaded synchronously instead)
+        std::size_t bytes = 0;         // Total bytes uploaded
+        std::size_t slotsFlushed = 0;  // Number of staging slots locked and handed to the GPU
+        std::size_t rejected = 0;      // Uploads dropped because glTexSubImage2D can't take the format (compressed / unknown)
+        double stallSeconds = 0.0;     // Time spent waiting on fences for staging memory to be free
+        double copySeconds = 0.0;      // Time spent copying pixels into staging in update() / updateRec()
+        double submitSeconds = 0.0;    // Time spent issuing glTexSubImage2D calls
+        double lastFrameStallSeconds = 0.0; // Fence wait time during the last completed frame (see endFrame())
+
+        // Bytes / second spent on the render thread (copying + submitting + stalls), pixels written through
+        // reserve() by the caller don't count their decode / copy time
+        double throughput() const {
+            const double t = stallSeconds + copySeconds + submitSeconds;
+            return t > 0.0 ? bytes / t : 0.0;
+        }
+    };
+
+    /**
+     * @brief Async texture uploader
+     * Decode / copy pixels into a persistently mapped GL_PIXEL_UNPACK_BUFFER and issue
+     * glTexSubImage2D from buffer offsets, so the driver can DMA the data instead of copying
+     * it out of client memory on the render thread. Staging slots are recycled with the
+     * PersistentBuffer lock() / wait() fences.
+     *
+     * Example:
+     * TextureUploader<3> uploader(4 * 1024 * 1024); // 4 MiB of staging per slot
+     *
+     * // In the game loop
+     * void * px = uploader.reserve(bytes);
+     * decodeFrameInto(px);
+     * uploader.submit(myTexture, 0, 0, myTexture.width, myTexture.height);
+     * uploader.endFrame();
+     *
+     * @tparam bufferCount Number of staging slots to cycle through
+     */
+    template <std::size_t bufferCount = 3>
+    class TextureUploader {
+    public:
+        /**
+         * @brief Construct a new texture uploader, MUST BE DONE AFTER OPENGL CONTEXT IS INITIALIZED
+         * @param stagingSize Size in bytes of each staging slot
+         */
+        TextureUploader(GLsizeiptr stagingSize):
+                staging(GL_PIXEL_UNPACK_BUFFER, stagingSize, PBFlags::WRITE) {
+            // PersistentBuffer leaves its last buffer bound, which would make every
+            // following raylib texture upload read from our staging memory
+            glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        TextureUploader() {}
+
+        TextureUploader(const TextureUploader &other) = delete;
+        TextureUploader &operator=(const TextureUploader &other) = delete;
+        TextureUploader(TextureUploader &&other) { if (this != &other) swap(other); }
+        TextureUploader &operator=(TextureUploader &&other) {
+            if (this != &other) swap(other);
+            return *this;
+        }
+
+        void swap(TextureUploader &other) noexcept {
+            staging.swap(other.staging);
+            std::swap(offset, other.offset);
+            std::swap(reserved, other.reserved);
+            std::swap(reservedSize, other.reservedSize);
+            std::swap(slotReady, other.slotReady);
+            std::swap(frameStall, other.frameStall);
+            std::swap(stats, other.stats);
+        }
+
+        /**
+         * @brief Reserve bytes in the current staging slot to decode pixels into.
+         *        If the current slot is full it is handed to the GPU and the next slot
+         *        is used (this may wait on a fence).
+         * @param bytes Number of bytes to reserve
+         * @return void* Pointer into mapped memory, or nullptr if bytes is bigger than a slot
+         */
+        void * reserve(std::size_t bytes) {
+            if (bytes == 0 || bytes > staging.size()) return nullptr;
+
+            if (offset + bytes > staging.size())
+                flush();
+            acquire_slot();
+
+            reserved = offset;
+            reservedSize = bytes;
+            offset = align(offset + bytes);
+            return staging.template get<uint8_t>(0) + reserved;
+        }
+
+        /**
+         * @brief Upload the last reserve()'d region into a sub-rectangle of a texture
+         * @param tex Texture to upload to (uncompressed formats only, others are counted in stats.rejected
+         *        and dropped, or throw under DEBUG)
+         * @param x Left of the sub-rectangle in pixels
+         * @param y Top of the sub-rectangle in pixels
+         * @param w Width in pixels
+         * @param h Height in pixels
+         */
+        void submit(const Texture2D &tex, int x, int y, int w, int h) {
+            GLenum format, type;
+            if (!gl_format(tex.format, format, type)) return reject();
+            submit(tex.id, x, y, w, h, format, type);
+        }
+
+        /**
+         * @brief Upload the last reserve()'d region into a sub-rectangle of a texture
+         * @param texId OpenGL texture id
+         * @param format Pixel format, ie GL_RGBA
+         * @param type Pixel type, ie GL_UNSIGNED_BYTE
+         */
+        void submit(GLuint texId, int x, int y, int w, int h, GLenum format, GLenum type) {
+            const auto start = std::chrono::steady_clock::now();
+            glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.getId(0));
+            glState().bindTexture(0, GL_TEXTURE_2D, texId);
+            tex_sub_image(x, y, w, h, format, type, (const void*)reserved);
+            glState().bindTexture(0, GL_TEXTURE_2D, 0);
+            glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+            stats.submitSeconds += secondsSince(start);
+            stats.bytes += reservedSize;
+            stats.uploads++;
+        }
+
+        /**
+         * @brief Copy pixels to staging memory and upload them to the whole texture.
+         *        Same as UpdateTexture() but without waiting for the driver copy. Textures
+         *        too big for a staging slot fall back to a synchronous upload
+         * @param tex Texture to upload to (uncompressed formats only)
+         * @param pixels Pixel data, tightly packed
+         */
+        void update(const Texture2D &tex, const void * pixels) {
+            updateRec(tex, 0, 0, tex.width, tex.height, pixels);
+        }
+
+        /**
+         * @brief Same as update() but for a sub-rectangle, pixels should be w * h tightly packed
+         */
+        void updateRec(const Texture2D &tex, int x, int y, int w, int h, const void * pixels) {
+            GLenum format, type;
+            if (!gl_format(tex.format, format, type)) return reject();
+            const std::size_t bytes = GetPixelDataSize(w, h, tex.format);
+            void * dst = reserve(bytes);
+            if (dst) {
+                const auto start = std::chrono::steady_clock::now();
+                memcpy(dst, pixels, bytes);
+                stats.copySeconds += secondsSince(start);
+                submit(tex.id, x, y, w, h, format, type);
+                return;
+            }
+
+            glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glState().bindTexture(0, GL_TEXTURE_2D, tex.id);
+            tex_sub_image(x, y, w, h, format, type, pixels);
+            glState().bindTexture(0, GL_TEXTURE_2D, 0);
+            stats.fallbacks++;
+            stats.bytes += bytes;
+        }
+
+        /**
+         * @brief Hand the current staging slot to the GPU (fence + cycle) if anything was written
+         */
+        void flush() {
+            if (!slotReady) return;
+            staging.lock(0);
+            staging.advance_cycle();
+            offset = 0;
+            slotReady = false;
+            stats.slotsFlushed++;
+        }
+
+        /**
+         * @brief Call once per frame after all uploads, flushes the current slot
+         *        and records the frame's stall time
+         */
+        void endFrame() {
+            flush();
+            stats.lastFrameStallSeconds = frameStall;
+            frameStall = 0.0;
+        }
+
+        const TextureUploadStats &getStats() const { return stats; }
+        void resetStats() { stats = TextureUploadStats{}; }
+
+        std::size_t getBufferCount() const { return bufferCount; }
+        std::size_t stagingSize() const { return staging.size(); }
+
+        /**
+         * @brief Get the GL format and type for an uncompressed raylib pixel format, same mapping raylib
+         *        uses to create the texture (rlGetGlTextureFormats)
+         * @param pixelFormat raylib PixelFormat, ie PIXELFORMAT_UNCOMPRESSED_R8G8B8A8
+         * @param format Output GL format, ie GL_RGBA
+         * @param type Output GL type, ie GL_UNSIGNED_BYTE
+         * @return false for compressed or unknown formats, glTexSubImage2D can't upload those
+         */
+        static bool gl_format(int pixelFormat, GLenum &format, GLenum &type) {
+            unsigned int internalFormat = 0, glFormat = 0, glType = 0;
+            rlGetGlTextureFormats(pixelFormat, &internalFormat, &glFormat, &glType);
+            format = glFormat;
+            type = glType;
+            return glFormat != 0 && glType != 0;
+        }
+    private:
+        PersistentBuffer<bufferCount> staging;
+        std::size_t offset = 0;       // Write cursor in the current slot
+        std::size_t reserved = 0;     // Offset of the last reservation
+        std::size_t reservedSize = 0;
+        bool slotReady = false;       // Has the current slot been waited on since it was cycled in
+        double frameStall = 0.0;
+        TextureUploadStats stats;
+
+        // Wait for the GPU to finish reading the current slot before reusing it
+        void acquire_slot() {
+            if (slotReady) return;
+            const auto start = std::chrono::steady_clock::now();
+            staging.wait(0);
+            const double t = secondsSince(start);
+            stats.stallSeconds += t;
+            frameStall += t;
+            slotReady = true;
+        }
+
+        void reject() {
+            #ifdef DEBUG
+            throw std::invalid_argument("TextureUploader only uploads uncompressed pixel formats");
+            #endif
+            stats.rejected++;
+        }
+
+        // Rows are tightly packed, the caller's unpack alignment is restored afterwards
+        static void tex_sub_image(int x, int y, int w, int h, GLenum format, GLenum type, const void * pixels) {
+            GLint alignment = 4;
+            glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+            if (alignment != 1) glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, format, type, pixels);
+            if (alignment != 1) glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+        }
+
+        // Keep each upload 16 byte aligned so any pixel type can be read from the offset
+        static std::size_t align(std::size_t x) { return (x + 15) & ~std::size_t(15); }
+    };
+}
+
+#endif
@@ -0,0 +1,355 @@
+#ifndef BOWSER_UTIL_TILEMAP_H
+#define BOWSER_UTIL_TILEMAP_H
+
+#include <glad.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "rlgl.h"
+#include "stdint.h"
+#include "bitset8.h"
+#include "gl_state.h"
+#include "vector.h"
+#include "../camera_extra.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace bowser_util {
+    struct IVec2Hash {
+        std::size_t operator()(const ivec2 &v) const {
+            return std::hash<uint64_t>()(((uint64_t)(uint32_t)v.x << 32) | (uint32_t)v.y);
+        }
+    };
+
+    /**
+     * @brief Compute 8-neighbour autotile masks for a dense grid of tiles in bulk
+     *        Bit order (reading order): 0 = up-left, 1 = up, 2 = up-right, 3 = left,
+     *        4 = right, 5 = down-left, 6 = down, 7 = down-right. A bit is set if the
+     *        neighbour has the same tile id. Tiles outside the grid never match
+     * @param tiles width * height tile ids (row major)
+     * @param width Width of the grid
+     * @param height Height of the grid
+     * @param out width * height output masks
+     */
+    inline void computeAutotileMasks(const uint16_t * tiles, int width, int height, Bitset8 * out) {
+        // Pad with a 1 tile halo that never matches so the inner loop has no bounds checks
+        const int pw = width + 2;
+        std::vector<uint32_t> padded((std::size_t)pw * (height + 2), 0xFFFFFFFF);
+        for (int y = 0; y < height; y++)
+            std::copy(tiles + (std::size_t)y * width, tiles + (std::size_t)(y + 1) * width, padded.begin() + (std::size_t)(y + 1) * pw + 1);
+
+        for (int y = 0; y < height; y++) {
+            const uint32_t * up = padded.data() + (std::size_t)y * pw + 1;
+            const uint32_t * mid = up + pw;
+            const uint32_t * down = mid + pw;
+            Bitset8 * row = out + (std::size_t)y * width;
+            for (int x = 0; x < width; x++) {
+                const uint32_t c = mid[x];
+                row[x] = (uint8_t)(
+                    (up[x - 1] == c)        | (up[x] == c) << 1     | (up[x + 1] == c) << 2 |
+                    (mid[x - 1] == c) << 3  | (mid[x + 1] == c) << 4 |
+                    (down[x - 1] == c) << 5 | (down[x] == c) << 6   | (down[x + 1] == c) << 7);
+            }
+        }
+    }
+
+    /**
+     * @brief Chunked tilemap renderer
+     * Tiles are stored in chunkSize x chunkSize chunks, each with a static vertex buffer that is only
+     * rebuilt when one of its tiles (or a neighbouring tile, for autotiling) changes. Chunks are culled
+     * against the camera view so drawing is one draw call per visible chunk.
+     *
+     * Tile id 0 is empty. Other ids index into the tileset texture (id - 1, left to right, top to bottom),
+     * optionally remapped with an autotile function from (id, 8-neighbour mask).
+     *
+     * MUST BE CONSTRUCTED AFTER OPENGL CONTEXT IS INITIALIZED
+     *
+     * @tparam chunkSize Width / height of a chunk in tiles
+     */
+    template <int chunkSize = 32>
+    class Tilemap {
+    public:
+        // Map (tile id, neighbour mask) to the tileset index to draw (id - 1 based, like ids)
+        using AutotileFunc = std::function<uint16_t(uint16_t id, Bitset8 mask)>;
+
+        struct Stats {
+            std::size_t chunks = 0;          // Chunks with at least one buffer
+            std::size_t chunksDrawn = 0;     // Chunks drawn in the last draw()
+            std::size_t chunksRebuilt = 0;   // Chunks rebuilt in the last draw()
+            std::size_t tilesDrawn = 0;      // Tiles drawn in the last draw()
+        };
+
+        /**
+         * @brief Construct a new tilemap
+         * @param tileset Tileset texture, tiles laid out in a grid
+         * @param tileSize Size of one tile in the tileset, in pixels (also the world size of a tile)
+         */
+        Tilemap(const Texture2D &tileset, int tileSize): tileset(tileset), tileSize(tileSize) {
+            program = rlLoadShaderCode(VS_CODE, FS_CODE);
+            mvpLoc = glGetUniformLocation(program, "mvp");
+            texLoc = glGetUniformLocation(program, "texture0");
+            colorLoc = glGetUniformLocation(program, "colDiffuse");
+            columns = std::max(1, tileset.width / std::max(1, tileSize));
+        }
+        ~Tilemap() {
+            for (auto &[pos, chunk] : chunks)
+                unload_chunk(chunk);
+            if (program) rlUnloadShaderProgram(program);
+        }
+
+        Tilemap(const Tilemap &other) = delete;
+        Tilemap &operator=(const Tilemap &other) = delete;
+
+        void setAutotile(AutotileFunc func) {
+            autotile = std::move(func);
+            for (auto &[pos, chunk] : chunks) chunk.dirty = true;
+        }
+
+        uint16_t get(const ivec2 &tile) const {
+            auto it = chunks.find(chunk_of(tile));
+            if (it == chunks.end()) return 0;
+            return it->second.tiles[local_index(tile)];
+        }
+
+        // Set a tile, marks its chunk (and neighbouring chunks if on a border) for rebuild.
+        // Chunks are only allocated for non empty tiles, and freed (with their buffers) once all their tiles are erased
+        void set(const ivec2 &tile, uint16_t id) {
+            const ivec2 c = chunk_of(tile);
+            auto found = chunks.find(c);
+            if (found == chunks.end()) {
+                if (!id) return; // Erasing in an empty area, don't allocate a chunk for it
+                found = chunks.try_emplace(c).first;
+            }
+            Chunk &chunk = found->second;
+            uint16_t &t = chunk.tiles[local_index(tile)];
+            if (t == id) return;
+            chunk.filled += (t == 0) - (id == 0);
+            t = id;
+            chunk.dirty = true;
+
+            // Autotile masks of neighbours in other chunks depend on this tile
+            for (int dy = -1; dy <= 1; dy++)
+                for (int dx = -1; dx <= 1; dx++) {
+                    const ivec2 n = chunk_of(ivec2(tile.x + dx, tile.y + dy));
+                    if (n == c) continue;
+                    auto it = chunks.find(n);
+                    if (it != chunks.end()) it->second.dirty = true;
+                }
+
+            if (!chunk.filled) {
+                unload_chunk(chunk);
+                chunks.erase(found);
+            }
+        }
+
+        // Get the autotile mask of a tile (as of the last rebuild)
+        Bitset8 getMask(const ivec2 &tile) const {
+            auto it = chunks.find(chunk_of(tile));
+            if (it == chunks.end()) return Bitset8();
+            return it->second.masks[local_index(tile)];
+        }
+
+        /**
+         * @brief Rebuild dirty chunks visible to the camera and draw the visible chunks
+         *        Call inside BeginMode2D(camera) so rlgl's matrices match the camera
+         * @param camera Camera used to cull chunks
+         * @param tint Tint color
+         */
+        void draw(Camera2DExtended &camera, Color tint = WHITE) {
+            const Matrix mvp = MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection());
+            ivec2 minChunk, maxChunk;
+            visible_chunks(camera, minChunk, maxChunk);
+
+            stats.chunksDrawn = stats.chunksRebuilt = stats.tilesDrawn = 0;
+            rlDrawRenderBatchActive();
+            glState().useProgram(program);
+            rlSetUniformMatrix(mvpLoc, mvp);
+            const float color[4] = { tint.r / 255.0f, tint.g / 255.0f, tint.b / 255.0f, tint.a / 255.0f };
+            glUniform4fv(colorLoc, 1, color);
+            glUniform1i(texLoc, 0);
+            glState().bindTexture(0, GL_TEXTURE_2D, tileset.id);
+
+            // Walk whichever is smaller: the visible chunk range or the loaded chunks
+            const std::size_t rangeArea = (std::size_t)(maxChunk.x - minChunk.x + 1) * (maxChunk.y - minChunk.y + 1);
+            if (rangeArea <= chunks.size()) {
+                for (int y = minChunk.y; y <= maxChunk.y; y++)
+                    for (int x = minChunk.x; x <= maxChunk.x; x++) {
+                        auto it = chunks.find(ivec2(x, y));
+                        if (it != chunks.end()) draw_chunk(it->first, it->second);
+                    }
+            } else {
+                for (auto &[pos, chunk] : chunks)
+                    if (pos.x >= minChunk.x && pos.y >= minChunk.y && pos.x <= maxChunk.x && pos.y <= maxChunk.y)
+                        draw_chunk(pos, chunk);
+            }
+            glBindVertexArray(0);
+            glState().useProgram(0);
+            stats.chunks = bufferedChunks;
+        }
+
+        const Stats &getStats() const { return stats; }
+        int getTileSize() const { return tileSize; }
+    private:
+        static constexpr int CHUNK_AREA = chunkSize * chunkSize;
+
+        static constexpr const char * VS_CODE = R"(#version 330
+layout(location = 0) in vec2 vertexPosition;
+layout(location = 1) in vec2 vertexTexCoord;
+uniform mat4 mvp;
+out vec2 fragTexCoord;
+void main() {
+    fragTexCoord = vertexTexCoord;
+    gl_Position = mvp * vec4(vertexPosition, 0.0, 1.0);
+}
+)";
+        static constexpr const char * FS_CODE = R"(#version 330
+in vec2 fragTexCoord;
+uniform sampler2D texture0;
+uniform vec4 colDiffuse;
+out vec4 finalColor;
+void main() { finalColor = texture(texture0, fragTexCoord) * colDiffuse; }
+)";
+
+        struct Chunk {
+            uint16_t tiles[CHUNK_AREA] = {};
+            Bitset8 masks[CHUNK_AREA];
+            bool dirty = true;
+            int filled = 0; // Non empty tiles
+            GLuint vao = 0, vbo = 0;
+            GLsizei vertexCount = 0;
+        };
+
+        struct Vertex { float x, y, u, v; };
+
+        Texture2D tileset;
+        int tileSize;
+        int columns = 1;
+        GLuint program = 0;
+        GLint mvpLoc = -1, texLoc = -1, colorLoc = -1;
+        AutotileFunc autotile;
+        std::unordered_map<ivec2, Chunk, IVec2Hash> chunks;
+        std::vector<Vertex> scratch;
+        std::size_t bufferedChunks = 0; // Chunks with a vertex buffer, for Stats::chunks
+        Stats stats;
+
+        static int floor_div(int a, int b) { return (a >= 0 ? a : a - b + 1) / b; }
+        static ivec2 chunk_of(const ivec2 &tile) {
+            return ivec2(floor_div(tile.x, chunkSize), floor_div(tile.y, chunkSize));
+        }
+        static int local_index(const ivec2 &tile) {
+            const int x = tile.x - floor_div(tile.x, chunkSize) * chunkSize;
+            const int y = tile.y - floor_div(tile.y, chunkSize) * chunkSize;
+            return y * chunkSize + x;
+        }
+
+        // Chunk range covering the camera view (handles rotation by using all 4 corners)
+        void visible_chunks(Camera2DExtended &camera, ivec2 &minChunk, ivec2 &maxChunk) const {
+            const float w = (float)GetScreenWidth(), h = (float)GetScreenHeight();
+            const vec2 corners[4] = {
+                camera.screenToWorld(Vector2{ 0, 0 }), camera.screenToWorld(Vector2{ w, 0 }),
+                camera.screenToWorld(Vector2{ 0, h }), camera.screenToWorld(Vector2{ w, h })
+            };
+            vec2 lo = corners[0], hi = corners[0];
+            for (const auto &c : corners) {
+                lo = vec2(std::min(lo.x, c.x), std::min(lo.y, c.y));
+                hi = vec2(std::max(hi.x, c.x), std::max(hi.y, c.y));
+            }
+            const float chunkWorld = (float)chunkSize * tileSize;
+            minChunk = ivec2((int)std::floor(lo.x / chunkWorld), (int)std::floor(lo.y / chunkWorld));
+            maxChunk = ivec2((int)std::floor(hi.x / chunkWorld), (int)std::floor(hi.y / chunkWorld));
+        }
+
+        void draw_chunk(const ivec2 &pos, Chunk &chunk) {
+            if (chunk.dirty) {
+                rebuild(pos, chunk);
+                stats.chunksRebuilt++;
+            }
+            if (!chunk.vertexCount) return;
+
+            glBindVertexArray(chunk.vao);
+            glDrawArrays(GL_TRIANGLES, 0, chunk.vertexCount);
+            stats.chunksDrawn++;
+            stats.tilesDrawn += chunk.vertexCount / 6;
+        }
+
+        void rebuild(const ivec2 &pos, Chunk &chunk) {
+            compute_masks(pos, chunk);
+
+            scratch.clear();
+            const float invW = 1.0f / tileset.width, invH = 1.0f / tileset.height;
+            for (int y = 0; y < chunkSize; y++) {
+                for (int x = 0; x < chunkSize; x++) {
+                    const int i = y * chunkSize + x;
+                    uint16_t id = chunk.tiles[i];
+                    if (!id) continue;
+                    if (autotile) id = autotile(id, chunk.masks[i]);
+                    if (!id) continue;
+
+                    const float u0 = ((id - 1) % columns) * tileSize * invW;
+                    const float v0 = ((id - 1) / columns) * tileSize * invH;
+                    const float u1 = u0 + tileSize * invW, v1 = v0 + tileSize * invH;
+                    const float x0 = (float)(pos.x * chunkSize + x) * tileSize, y0 = (float)(pos.y * chunkSize + y) * tileSize;
+                    const float x1 = x0 + tileSize, y1 = y0 + tileSize;
+
+                    scratch.push_back({ x0, y0, u0, v0 });
+                    scratch.push_back({ x0, y1, u0, v1 });
+                    scratch.push_back({ x1, y1, u1, v1 });
+                    scratch.push_back({ x0, y0, u0, v0 });
+                    scratch.push_back({ x1, y1, u1, v1 });
+                    scratch.push_back({ x1, y0, u1, v0 });
+                }
+            }
+
+            unload_chunk(chunk);
+            chunk.vertexCount = (GLsizei)scratch.size();
+            chunk.dirty = false;
+            if (scratch.empty()) return;
+
+            glGenVertexArrays(1, &chunk.vao);
+            glBindVertexArray(chunk.vao);
+            glGenBuffers(1, &chunk.vbo);
+            glState().bindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+            glBufferStorage(GL_ARRAY_BUFFER, scratch.size() * sizeof(Vertex), scratch.data(), 0);
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(2 * sizeof(float)));
+            glEnableVertexAttribArray(1);
+            glBindVertexArray(0);
+            bufferedChunks++;
+        }
+
+        // Masks for the whole chunk, neighbours in adjacent chunks are read through a 1 tile halo
+        void compute_masks(const ivec2 &pos, Chunk &chunk) {
+            constexpr int W = chunkSize + 2;
+            uint16_t padded[W * W];
+            Bitset8 masks[W * W];
+            const ivec2 origin = pos * chunkSize - 1;
+            for (int y = 0; y < W; y++) {
+                for (int x = 0; x < W; x++) {
+                    if (x > 0 && y > 0 && x <= chunkSize && y <= chunkSize)
+                        padded[y * W + x] = chunk.tiles[(y - 1) * chunkSize + x - 1];
+                    else
+                        padded[y * W + x] = get(origin + ivec2(x, y));
+                }
+            }
+            computeAutotileMasks(padded, W, W, masks);
+            for (int y = 0; y < chunkSize; y++)
+                std::copy(masks + (y + 1) * W + 1, masks + (y + 1) * W + 1 + chunkSize, chunk.masks + y * chunkSize);
+        }
+
+        void unload_chunk(Chunk &chunk) {
+            if (chunk.vao) {
+                glDeleteVertexArrays(1, &chunk.vao);
+                bufferedChunks--;
+            }
+            if (chunk.vbo) glState().deleteBuffers(1, &chunk.vbo);
+            chunk.vao = chunk.vbo = 0;
+            chunk.vertexCount = 0;
+        }
+    };
+}
+
+#endif
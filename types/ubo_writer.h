@@ -5,6 +5,7 @@
 #include "stdint.h"
 #include "rlgl.h"
 #include <glad.h>
+#include "gl_state.h"
 #include <cstring>
 #include <algorithm>
 
@@ -85,7 +86,7 @@ namespace bowser_util {
          * @brief Upload changes to the data array to the GPU, will bind the UBO buffer
          */
         void upload() {
-            glBindBuffer(GL_UNIFORM_BUFFER, UBOId);
+            glState().bindBuffer(GL_UNIFORM_BUFFER, UBOId);
             glBufferSubData(GL_UNIFORM_BUFFER, 0, dataSizeBytes, data); 
         }
 
@@ -0,0 +1,211 @@
+#ifndef BOWSER_UTIL_VOXEL_AO_H
+#define BOWSER_UTIL_VOXEL_AO_H
+
+#include "stdint.h"
+#include "types/bitset8.h"
+#include "parallel.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+namespace bowser_util {
+    /**
+     * @brief Visible face of a voxel with the ambient occlusion of its 4 corners
+     *
+     *        Corners are in the order (-u, -v), (+u, -v), (+u, +v), (-u, +v) where u, v are the two axes after
+     *        the face's axis (x face: y, z, y face: z, x, z face: x, y)
+     */
+    struct VoxelAOFace {
+        uint8_t x, y, z;
+        uint8_t direction;  // 0 = -x, 1 = +x, 2 = -y, 3 = +y, 4 = -z, 5 = +z
+        uint8_t ao;         // 2 bits per corner, 3 = open, 0 = fully occluded
+
+        int corner(int i) const { return (ao >> (2 * i)) & 3; }
+
+        // Split the quad along the other diagonal (corners 1 - 3) so occlusion interpolates symmetrically
+        bool flipDiagonal() const { return corner(0) + corner(2) < corner(1) + corner(3); }
+    };
+
+    /**
+     * @brief Stats of the last VoxelAOBaker::bake()
+     */
+    struct VoxelAOStats {
+        std::size_t voxels = 0;
+        std::size_t faces = 0;
+        double fillSeconds = 0.0;   // Reading the chunk + halo into the padded buffer
+        double bakeSeconds = 0.0;
+        double totalSeconds() const { return fillSeconds + bakeSeconds; }
+        double facesPerMs() const { return totalSeconds() > 0.0 ? faces / (totalSeconds() * 1000.0) : 0.0; }
+    };
+
+    namespace VoxelAO {
+        /**
+         * @brief Corner occlusion of a face from its 8 neighbours in the layer in front of it. Bits go around the
+         *        face: 0 (-u, -v), 1 (0, -v), 2 (+u, -v), 3 (+u, 0), 4 (+u, +v), 5 (0, +v), 6 (-u, +v), 7 (-u, 0)
+         * @return uint8_t 2 bits per corner
+         */
+        constexpr uint8_t corners_from_ring(uint8_t ring) {
+            uint8_t out = 0;
+            for (int c = 0; c < 4; c++) {
+                // Corner c sits between ring bits 2c - 1 (side), 2c (corner) and 2c + 1 (side)
+                const int side1 = (ring >> ((2 * c + 7) & 7)) & 1, corner = (ring >> (2 * c)) & 1, side2 = (ring >> (2 * c + 1)) & 1;
+                const int ao = side1 && side2 ? 0 : 3 - (side1 + side2 + corner);
+                out |= (uint8_t)(ao << (2 * c));
+            }
+            return out;
+        }
+
+        // All 256 neighbourhoods
+        constexpr std::array<uint8_t, 256> make_table() {
+            std::array<uint8_t, 256> table {};
+            for (int i = 0; i < 256; i++) table[i] = corners_from_ring((uint8_t)i);
+            return table;
+        }
+
+        inline constexpr std::array<uint8_t, 256> TABLE = make_table();
+    }
+
+    /**
+     * @brief Bakes per corner ambient occlusion for a cubic chunk of voxels
+     *
+     *        The chunk and a one voxel halo are first read into a padded dense buffer, so neighbour chunks are
+     *        only looked up once per halo voxel instead of for every corner. Each visible face then reads the 8
+     *        voxels around it in front of the face into a Bitset8, and a 256 entry table gives all 4 corners
+     *        at once
+     *
+     *        One baker per thread, the padded buffer is reused between chunks
+     */
+    class VoxelAOBaker {
+    public:
+        /**
+         * @brief Read a chunk through a callback
+         * @param size Chunk edge (<= 254)
+         * @param solid bool(int x, int y, int z) with coordinates relative to the chunk in [-1, size]
+         */
+        template <class F>
+        void fill(int size, F &&solid) {
+            const auto start = std::chrono::steady_clock::now();
+            resize(size);
+            std::size_t i = 0;
+            for (int z = -1; z <= size; z++)
+                for (int y = -1; y <= size; y++)
+                    for (int x = -1; x <= size; x++)
+                        padded[i++] = solid(x, y, z) ? 1 : 0;
+            fillSeconds = secondsSince(start);
+        }
+
+        /**
+         * @brief Copy a dense chunk, only the halo goes through the callback
+         * @param voxels size^3 values indexed x + y * size + z * size * size, non zero = solid
+         * @param size Chunk edge (<= 254)
+         * @param haloSolid bool(int x, int y, int z) for the halo voxels, coordinates relative to the chunk
+         */
+        template <class F>
+        void fill(const uint8_t * voxels, int size, F &&haloSolid) {
+            const auto start = std::chrono::steady_clock::now();
+            resize(size);
+            std::size_t i = 0;
+            for (int z = -1; z <= size; z++) {
+                for (int y = -1; y <= size; y++) {
+                    if (z < 0 || z == size || y < 0 || y == size) {
+                        for (int x = -1; x <= size; x++) padded[i++] = haloSolid(x, y, z) ? 1 : 0;
+                        continue;
+                    }
+                    padded[i++] = haloSolid(-1, y, z) ? 1 : 0;
+                    const uint8_t * row = voxels + ((std::size_t)z * size + y) * size;
+                    for (int x = 0; x < size; x++) padded[i++] = row[x] != 0;
+                    padded[i++] = haloSolid(size, y, z) ? 1 : 0;
+                }
+            }
+            fillSeconds = secondsSince(start);
+        }
+
+        /**
+         * @brief Emit every visible face of the filled chunk (solid voxel next to an empty one) with its AO
+         * @param out Faces are appended
+         * @return const VoxelAOStats& Stats of this chunk
+         */
+        const VoxelAOStats &bake(std::vector<VoxelAOFace> &out) {
+            const auto start = std::chrono::steady_clock::now();
+            const std::size_t first = out.size();
+            const int stride[3] = { 1, paddedSize, paddedSize * paddedSize };
+            for (int z = 0; z < size; z++) {
+                for (int y = 0; y < size; y++) {
+                    const uint8_t * row = padded.data() + index(0, y, z);
+                    for (int x = 0; x < size; x++) {
+                        if (!row[x]) continue;
+                        for (int dir = 0; dir < 6; dir++) {
+                            const uint8_t * front = row + x + (dir & 1 ? stride[dir >> 1] : -stride[dir >> 1]);
+                            if (*front) continue;
+                            out.push_back({ (uint8_t)x, (uint8_t)y, (uint8_t)z, (uint8_t)dir, VoxelAO::TABLE[ring(front, dir)] });
+                        }
+                    }
+                }
+            }
+            stats.voxels = (std::size_t)size * size * size;
+            stats.faces = out.size() - first;
+            stats.fillSeconds = fillSeconds;
+            stats.bakeSeconds = secondsSince(start);
+            return stats;
+        }
+
+        /**
+         * @brief AO of one face of the filled chunk, for meshers emitting their own faces (ie greedy meshing
+         *        merges only faces with equal values)
+         * @param x, y, z Voxel in the chunk
+         * @param direction 0 = -x, 1 = +x, 2 = -y, 3 = +y, 4 = -z, 5 = +z
+         * @return uint8_t 2 bits per corner, see VoxelAOFace
+         */
+        uint8_t faceAO(int x, int y, int z, int direction) const {
+            const int stride[3] = { 1, paddedSize, paddedSize * paddedSize };
+            const int axis = direction >> 1;
+            return VoxelAO::TABLE[ring(padded.data() + index(x, y, z) + (direction & 1 ? stride[axis] : -stride[axis]), direction)];
+        }
+
+        // Occupancy of the voxels around a face, see VoxelAO::corners_from_ring() for the bit order
+        Bitset8 faceNeighbours(int x, int y, int z, int direction) const {
+            const int stride[3] = { 1, paddedSize, paddedSize * paddedSize };
+            const int axis = direction >> 1;
+            return ring(padded.data() + index(x, y, z) + (direction & 1 ? stride[axis] : -stride[axis]), direction);
+        }
+
+        bool isSolid(int x, int y, int z) const { return padded[index(x, y, z)]; }
+        int getSize() const { return size; }
+        const VoxelAOStats &getStats() const { return stats; }
+
+    private:
+        std::vector<uint8_t> padded;
+        int size = 0, paddedSize = 0;
+        int ringOffsets[3][8];
+        double fillSeconds = 0.0;
+        VoxelAOStats stats;
+
+        // Index in the padded buffer of chunk voxel (x, y, z), coordinates in [-1, size]
+        std::size_t index(int x, int y, int z) const {
+            return ((std::size_t)(z + 1) * paddedSize + (y + 1)) * paddedSize + (x + 1);
+        }
+
+        void resize(int chunkSize) {
+            size = chunkSize;
+            paddedSize = chunkSize + 2;
+            padded.resize((std::size_t)paddedSize * paddedSize * paddedSize);
+            const int stride[3] = { 1, paddedSize, paddedSize * paddedSize };
+            const int du[8] = { -1, 0, 1, 1, 1, 0, -1, -1 }, dv[8] = { -1, -1, -1, 0, 1, 1, 1, 0 };
+            for (int axis = 0; axis < 3; axis++) {
+                const int u = stride[(axis + 1) % 3], v = stride[(axis + 2) % 3];
+                for (int b = 0; b < 8; b++) ringOffsets[axis][b] = du[b] * u + dv[b] * v;
+            }
+        }
+
+        // The 8 voxels around `front` (the voxel in front of a face) in the plane of the face
+        Bitset8 ring(const uint8_t * front, int direction) const {
+            const int * offsets = ringOffsets[direction >> 1];
+            uint8_t bits = 0;
+            for (int b = 0; b < 8; b++) bits |= (uint8_t)(front[offsets[b]] << b);
+            return Bitset8(bits);
+        }
+    };
+}
+
+#endif
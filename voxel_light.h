@@ -0,0 +1,479 @@
+#ifndef BOWSER_UTIL_VOXEL_LIGHT_H
+#define BOWSER_UTIL_VOXEL_LIGHT_H
+
+#include "stdint.h"
+#include "types/vector.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace bowser_util {
+    /**
+     * @brief Stats of the last VoxelLightEngine::update()
+     */
+    struct VoxelLightStats {
+        std::size_t chunks = 0;
+        std::size_t edits = 0;            // setBlock() calls since the previous update
+        std::size_t removeRounds = 0;     // Parallel rounds, chunks hand light over their borders between rounds
+        std::size_t addRounds = 0;
+        std::size_t removedVoxels = 0;    // Voxels visited by the remove pass
+        std::size_t litVoxels = 0;        // Voxels visited by the add pass
+        unsigned threads = 0;
+        double removeSeconds = 0.0;
+        double addSeconds = 0.0;
+        double totalSeconds = 0.0;
+
+        double voxelsPerMs() const { return totalSeconds > 0.0 ? (removedVoxels + litVoxels) / (totalSeconds * 1000.0) : 0.0; }
+    };
+
+    namespace VoxelLight {
+        constexpr int SIZE = 32;                      // Chunk edge
+        constexpr int SHIFT = 5;                      // log2(SIZE)
+        constexpr std::size_t VOXELS = SIZE * SIZE * SIZE;
+        constexpr int MAX_LEVEL = 15;
+
+        enum Channel { BLOCK = 0, SKY = 1 };
+        enum Direction { NEG_X = 0, POS_X, NEG_Y, POS_Y, NEG_Z, POS_Z };
+        constexpr int OFFSET[6] = { -1, 1, -SIZE, SIZE, -SIZE * SIZE, SIZE * SIZE };
+
+        // Block bits
+        constexpr uint8_t OPAQUE = 0x80;
+        constexpr uint8_t EMISSION = 0x0F;
+
+        // Queue entries: local index (15 bits) | level << 15 | down << 19 (remove messages moving down, sky rule)
+        constexpr uint32_t INDEX_MASK = VOXELS - 1;
+        constexpr uint32_t LEVEL_SHIFT = 15;
+        constexpr uint32_t DOWN_BIT = 1u << 19;
+
+        inline uint32_t entry(uint32_t index, int level) { return index | (uint32_t)level << LEVEL_SHIFT; }
+        inline int entry_level(uint32_t e) { return (e >> LEVEL_SHIFT) & 0xF; }
+
+        inline uint64_t chunk_key(const ivec3 &c) {
+            return ((uint64_t)(c.x & 0x1FFFFF) << 42) | ((uint64_t)(c.y & 0x1FFFFF) << 21) | (uint64_t)(c.z & 0x1FFFFF);
+        }
+
+        // Growable FIFO over a power of two ring buffer, no per node allocation like std::queue / std::deque
+        class RingQueue {
+        public:
+            void push(uint32_t value) {
+                if (count == data.size()) grow();
+                data[(head + count) & (data.size() - 1)] = value;
+                count++;
+            }
+
+            uint32_t pop() {
+                const uint32_t value = data[head];
+                head = (head + 1) & (data.size() - 1);
+                count--;
+                return value;
+            }
+
+            bool empty() const { return count == 0; }
+            std::size_t size() const { return count; }
+            void clear() { head = count = 0; }
+
+        private:
+            std::vector<uint32_t> data;
+            std::size_t head = 0, count = 0;
+
+            void grow() {
+                std::vector<uint32_t> bigger(std::max<std::size_t>(data.size() * 2, 1024));
+                for (std::size_t i = 0; i < count; i++) bigger[i] = data[(head + i) & (data.size() - 1)];
+                data.swap(bigger);
+                head = 0;
+            }
+        };
+
+        struct Chunk {
+            ivec3 coord;
+            uint8_t light[VOXELS] = {};    // Block light in the low nibble, sky light in the high nibble
+            uint8_t blocks[VOXELS] = {};   // OPAQUE bit | emission
+            int32_t neighbours[6] = { -1, -1, -1, -1, -1, -1 };
+
+            RingQueue add[2], remove[2];
+            std::vector<uint32_t> inAdd[2], inRemove[2];            // Messages from neighbour chunks
+            std::vector<uint32_t> outAdd[2][6], outRemove[2][6];    // Messages to neighbour chunks, by direction
+            std::size_t visited = 0;
+
+            int get(uint32_t i, int c) const { return (light[i] >> (4 * c)) & 0xF; }
+            void set(uint32_t i, int c, int level) {
+                light[i] = (uint8_t)((light[i] & (0xF0 >> (4 * c))) | level << (4 * c));
+            }
+            bool opaque(uint32_t i) const { return blocks[i] & OPAQUE; }
+
+            bool has_work(bool removing) const {
+                for (int c = 0; c < 2; c++) {
+                    if (removing ? !remove[c].empty() || !inRemove[c].empty() : !add[c].empty() || !inAdd[c].empty())
+                        return true;
+                }
+                return false;
+            }
+        };
+
+        // Index of the voxel next to local index i in direction dir, or -1 if it's in the neighbour chunk
+        // (then wrapped holds its index in that chunk)
+        inline int32_t step(uint32_t i, int dir, uint32_t &wrapped) {
+            const int axis = dir >> 1, shift = axis * SHIFT;
+            const int coord = (i >> shift) & (SIZE - 1);
+            if (dir & 1 ? coord == SIZE - 1 : coord == 0) {
+                wrapped = dir & 1 ? i - (uint32_t)(SIZE - 1) * (1u << shift) : i + (uint32_t)(SIZE - 1) * (1u << shift);
+                return -1;
+            }
+            return (int32_t)i + OFFSET[dir];
+        }
+    }
+
+    /**
+     * @brief Incremental block light + sky light (levels 0 - 15) over 32^3 voxel chunks
+     *
+     *        Light spreads to the 6 neighbours losing 1 level per voxel and stops at opaque voxels, sky light
+     *        at level 15 goes straight down without losing any. Edits use the usual two pass flood fill: a
+     *        remove pass darkens everything lit by what changed, then an add pass relights from the brighter
+     *        borders and the sources
+     *
+     *        Each chunk has its own ring buffer queues. Passes run in rounds: every chunk with work floods
+     *        its own voxels in parallel, light reaching a border becomes a message to the neighbour chunk,
+     *        messages are handed over between rounds. A chunk only ever touches its own voxels so no locking
+     *        is needed, and the result doesn't depend on the thread count
+     *
+     *        Light doesn't enter chunks that aren't loaded, sky light enters chunks without a loaded chunk above
+     */
+    class VoxelLightEngine {
+    public:
+        /**
+         * @brief Load an empty (all transparent) chunk, lit by the sky if nothing is loaded above. Light of the
+         *        neighbouring chunks flows in on the next update()
+         * @param coord Chunk coordinate (voxel coordinate / 32)
+         */
+        void addChunk(const ivec3 &coord) {
+            using namespace VoxelLight;
+            if (find_chunk(coord) >= 0) return;
+            const int32_t index = (int32_t)chunks.size();
+            chunks.push_back(std::make_unique<Chunk>());
+            Chunk &chunk = *chunks.back();
+            chunk.coord = coord;
+            lookup[chunk_key(coord)] = index;
+
+            const ivec3 offsets[6] = { ivec3(-1, 0, 0), ivec3(1, 0, 0), ivec3(0, -1, 0), ivec3(0, 1, 0), ivec3(0, 0, -1), ivec3(0, 0, 1) };
+            for (int dir = 0; dir < 6; dir++) {
+                const int32_t n = find_chunk(coord + offsets[dir]);
+                chunk.neighbours[dir] = n;
+                if (n < 0) continue;
+                Chunk &other = *chunks[n];
+                other.neighbours[dir ^ 1] = index;
+                // Relight the neighbour's face towards this chunk
+                for_each_face_voxel(dir ^ 1, [&](uint32_t i) {
+                    for (int c = 0; c < 2; c++)
+                        if (other.get(i, c) > 1) other.add[c].push(i);
+                });
+            }
+
+            // A chunk loaded above a sky lit column takes over the sky, the column below keeps its light
+            if (chunk.neighbours[POS_Y] < 0) {
+                for_each_face_voxel(POS_Y, [&](uint32_t i) {
+                    chunk.set(i, SKY, MAX_LEVEL);
+                    chunk.add[SKY].push(i);
+                });
+            }
+        }
+
+        bool hasChunk(const ivec3 &coord) const { return find_chunk(coord) >= 0; }
+
+        /**
+         * @brief Change a voxel, light is updated by the next update(). The chunk is loaded if needed
+         * @param pos Voxel position
+         * @param opaque Blocks light
+         * @param emission Block light emitted (0 - 15)
+         */
+        void setBlock(const ivec3 &pos, bool opaque, int emission = 0) {
+            using namespace VoxelLight;
+            const ivec3 coord = chunk_of(pos);
+            if (find_chunk(coord) < 0) addChunk(coord);
+            Chunk &chunk = *chunks[find_chunk(coord)];
+            const uint32_t i = local_index(pos);
+            emission = std::clamp(emission, 0, MAX_LEVEL);
+            edits++;
+
+            // Darken whatever this voxel lit, then let the surroundings and the sky relight it
+            for (int c = 0; c < 2; c++) {
+                const int level = chunk.get(i, c);
+                if (!level) continue;
+                chunk.set(i, c, 0);
+                chunk.remove[c].push(entry(i, level));
+            }
+            chunk.blocks[i] = (uint8_t)((opaque ? OPAQUE : 0) | emission);
+            if (!opaque) {
+                for (int dir = 0; dir < 6; dir++) {
+                    uint32_t wrapped;
+                    const int32_t j = VoxelLight::step(i, dir, wrapped);
+                    Chunk * owner = &chunk;
+                    if (j < 0) {
+                        if (chunk.neighbours[dir] < 0) continue;
+                        owner = chunks[chunk.neighbours[dir]].get();
+                    }
+                    const uint32_t k = j < 0 ? wrapped : (uint32_t)j;
+                    for (int c = 0; c < 2; c++)
+                        if (owner->get(k, c) > 0) owner->add[c].push(k);
+                }
+                if (chunk.neighbours[POS_Y] < 0 && ((i >> SHIFT) & (SIZE - 1)) == SIZE - 1) {
+                    chunk.set(i, SKY, MAX_LEVEL);
+                    chunk.add[SKY].push(i);
+                }
+            }
+            if (emission) {
+                chunk.set(i, BLOCK, emission);
+                chunk.add[BLOCK].push(i);
+            }
+        }
+
+        /**
+         * @brief Propagate the edits since the last update
+         * @param threads Number of threads, 0 = hardwareThreadCount()
+         * @return const VoxelLightStats& Stats of this update
+         */
+        const VoxelLightStats &update(unsigned threads = 0) {
+            const auto totalStart = std::chrono::steady_clock::now();
+            stats = VoxelLightStats();
+            stats.chunks = chunks.size();
+            stats.edits = edits;
+            edits = 0;
+            if (!threads) threads = hardwareThreadCount();
+            stats.threads = threads;
+
+            auto start = std::chrono::steady_clock::now();
+            stats.removeRounds = run_pass(true, threads, stats.removedVoxels);
+            stats.removeSeconds = secondsSince(start);
+
+            start = std::chrono::steady_clock::now();
+            stats.addRounds = run_pass(false, threads, stats.litVoxels);
+            stats.addSeconds = secondsSince(start);
+
+            stats.totalSeconds = secondsSince(totalStart);
+            return stats;
+        }
+
+        /**
+         * @brief Recompute all light from scratch (ie after generating the world), then update()
+         * @param threads Number of threads, 0 = hardwareThreadCount()
+         */
+        const VoxelLightStats &relightAll(unsigned threads = 0) {
+            using namespace VoxelLight;
+            for (auto &ptr : chunks) {
+                Chunk &chunk = *ptr;
+                std::fill(std::begin(chunk.light), std::end(chunk.light), (uint8_t)0);
+                for (int c = 0; c < 2; c++) {
+                    chunk.add[c].clear();
+                    chunk.remove[c].clear();
+                    chunk.inAdd[c].clear();
+                    chunk.inRemove[c].clear();
+                }
+                for (uint32_t i = 0; i < VOXELS; i++) {
+                    const int emission = chunk.blocks[i] & EMISSION;
+                    if (!emission) continue;
+                    chunk.set(i, BLOCK, emission);
+                    chunk.add[BLOCK].push(i);
+                }
+                if (chunk.neighbours[POS_Y] >= 0) continue;
+                for_each_face_voxel(POS_Y, [&](uint32_t i) {
+                    if (chunk.opaque(i)) return;
+                    chunk.set(i, SKY, MAX_LEVEL);
+                    chunk.add[SKY].push(i);
+                });
+            }
+            return update(threads);
+        }
+
+        int getBlockLight(const ivec3 &pos) const { return get_light(pos, VoxelLight::BLOCK); }
+        int getSkyLight(const ivec3 &pos) const { return get_light(pos, VoxelLight::SKY); }
+
+        bool isOpaque(const ivec3 &pos) const {
+            const int32_t c = find_chunk(chunk_of(pos));
+            return c >= 0 && chunks[c]->opaque(local_index(pos));
+        }
+
+        /**
+         * @brief Packed light of a chunk for meshing, block light in the low nibble and sky light in the high
+         *        nibble, indexed x + y * 32 + z * 32 * 32
+         * @return const uint8_t* 32^3 values, nullptr if the chunk isn't loaded
+         */
+        const uint8_t * getChunkLight(const ivec3 &coord) const {
+            const int32_t c = find_chunk(coord);
+            return c >= 0 ? chunks[c]->light : nullptr;
+        }
+
+        std::size_t getChunkCount() const { return chunks.size(); }
+        const VoxelLightStats &getStats() const { return stats; }
+
+        void clear() {
+            chunks.clear();
+            lookup.clear();
+            edits = 0;
+        }
+
+        static ivec3 chunk_of(const ivec3 &pos) {
+            using VoxelLight::SHIFT;
+            return ivec3(pos.x >> SHIFT, pos.y >> SHIFT, pos.z >> SHIFT);
+        }
+
+    private:
+        std::vector<std::unique_ptr<VoxelLight::Chunk>> chunks;
+        std::unordered_map<uint64_t, int32_t> lookup;
+        std::vector<int32_t> active;
+        std::size_t edits = 0;
+        VoxelLightStats stats;
+
+        int32_t find_chunk(const ivec3 &coord) const {
+            const auto it = lookup.find(VoxelLight::chunk_key(coord));
+            return it == lookup.end() ? -1 : it->second;
+        }
+
+        static uint32_t local_index(const ivec3 &pos) {
+            using namespace VoxelLight;
+            return (uint32_t)(pos.x & (SIZE - 1)) | (uint32_t)(pos.y & (SIZE - 1)) << SHIFT | (uint32_t)(pos.z & (SIZE - 1)) << (2 * SHIFT);
+        }
+
+        int get_light(const ivec3 &pos, int channel) const {
+            const int32_t c = find_chunk(chunk_of(pos));
+            return c >= 0 ? chunks[c]->get(local_index(pos), channel) : 0;
+        }
+
+        // Calls func(localIndex) for the 32 * 32 voxels of a chunk face
+        template <class F>
+        static void for_each_face_voxel(int dir, F &&func) {
+            using namespace VoxelLight;
+            const int axis = dir >> 1, fixed = dir & 1 ? SIZE - 1 : 0;
+            const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+            for (int b = 0; b < SIZE; b++) {
+                for (int a = 0; a < SIZE; a++) {
+                    uint32_t i = (uint32_t)fixed << (axis * SHIFT);
+                    i |= (uint32_t)a << (u * SHIFT) | (uint32_t)b << (v * SHIFT);
+                    func(i);
+                }
+            }
+        }
+
+        // Runs rounds until no chunk has work left, returns the number of rounds
+        std::size_t run_pass(bool removing, unsigned threads, std::size_t &visited) {
+            std::size_t rounds = 0;
+            while (true) {
+                active.clear();
+                for (int32_t c = 0; c < (int32_t)chunks.size(); c++)
+                    if (chunks[c]->has_work(removing)) active.push_back(c);
+                if (active.empty()) break;
+                rounds++;
+
+                parallelFor(0, active.size(), [&](std::size_t begin, std::size_t end, unsigned) {
+                    for (std::size_t a = begin; a < end; a++) {
+                        VoxelLight::Chunk &chunk = *chunks[active[a]];
+                        for (int c = 0; c < 2; c++) {
+                            if (removing) remove_light(chunk, c);
+                            else add_light(chunk, c);
+                        }
+                    }
+                }, threads, 1);
+
+                // Hand border messages over to the neighbours
+                for (int32_t index : active) {
+                    VoxelLight::Chunk &chunk = *chunks[index];
+                    visited += chunk.visited;
+                    chunk.visited = 0;
+                    for (int c = 0; c < 2; c++) {
+                        for (int dir = 0; dir < 6; dir++) {
+                            auto &out = removing ? chunk.outRemove[c][dir] : chunk.outAdd[c][dir];
+                            if (out.empty()) continue;
+                            if (chunk.neighbours[dir] >= 0) {
+                                auto &in = removing ? chunks[chunk.neighbours[dir]]->inRemove[c] : chunks[chunk.neighbours[dir]]->inAdd[c];
+                                in.insert(in.end(), out.begin(), out.end());
+                            }
+                            out.clear();
+                        }
+                    }
+                }
+            }
+            return rounds;
+        }
+
+        // Flood light from the add queue, sky light at full level goes down without losing a level
+        static void add_light(VoxelLight::Chunk &chunk, int c) {
+            using namespace VoxelLight;
+            for (uint32_t message : chunk.inAdd[c]) {
+                const uint32_t i = message & INDEX_MASK;
+                const int level = entry_level(message);
+                if (chunk.opaque(i) || chunk.get(i, c) >= level) continue;
+                chunk.set(i, c, level);
+                chunk.add[c].push(i);
+            }
+            chunk.inAdd[c].clear();
+
+            RingQueue &queue = chunk.add[c];
+            chunk.visited += queue.size();
+            while (!queue.empty()) {
+                const uint32_t i = queue.pop();
+                const int level = chunk.get(i, c);
+                if (level <= 1) continue;
+                for (int dir = 0; dir < 6; dir++) {
+                    const int next = c == SKY && dir == NEG_Y && level == MAX_LEVEL ? MAX_LEVEL : level - 1;
+                    uint32_t wrapped;
+                    const int32_t j = VoxelLight::step(i, dir, wrapped);
+                    if (j < 0) {
+                        if (chunk.neighbours[dir] >= 0) chunk.outAdd[c][dir].push_back(entry(wrapped, next));
+                        continue;
+                    }
+                    if (chunk.opaque(j) || chunk.get(j, c) >= next) continue;
+                    chunk.set(j, c, next);
+                    queue.push(j);
+                    chunk.visited++;
+                }
+            }
+        }
+
+        // Darken the voxels lit through the removed ones, brighter voxels met on the way go to the add queue
+        static void remove_light(VoxelLight::Chunk &chunk, int c) {
+            using namespace VoxelLight;
+            RingQueue &queue = chunk.remove[c];
+            // Darkens j if it was lit through a voxel of level `from`, otherwise queues it to relight the hole
+            auto visit = [&](uint32_t j, int from, bool down) {
+                const int level = chunk.get(j, c);
+                if (!level) return;
+                const bool litFrom = level < from || (c == SKY && down && from == MAX_LEVEL && level == MAX_LEVEL);
+                const int emission = c == BLOCK ? chunk.blocks[j] & EMISSION : 0;
+                if (litFrom && emission < level) {
+                    chunk.set(j, c, emission);
+                    if (emission) chunk.add[c].push(j);
+                    queue.push(entry(j, level));
+                } else if (level >= from || emission) {
+                    chunk.add[c].push(j);
+                }
+            };
+
+            for (uint32_t message : chunk.inRemove[c])
+                visit(message & INDEX_MASK, entry_level(message), message & DOWN_BIT);
+            chunk.inRemove[c].clear();
+
+            chunk.visited += queue.size();
+            while (!queue.empty()) {
+                const uint32_t e = queue.pop();
+                const uint32_t i = e & INDEX_MASK;
+                const int from = entry_level(e);
+                for (int dir = 0; dir < 6; dir++) {
+                    uint32_t wrapped;
+                    const int32_t j = VoxelLight::step(i, dir, wrapped);
+                    if (j < 0) {
+                        if (chunk.neighbours[dir] >= 0)
+                            chunk.outRemove[c][dir].push_back(entry(wrapped, from) | (dir == NEG_Y ? DOWN_BIT : 0));
+                        continue;
+                    }
+                    const std::size_t before = queue.size();
+                    visit(j, from, dir == NEG_Y);
+                    chunk.visited += queue.size() - before;
+                }
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,488 @@
+#ifndef BOWSER_UTIL_XPBD_H
+#define BOWSER_UTIL_XPBD_H
+
+#include "raylib.h"
+#include "stdint.h"
+#include "types/vector.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace bowser_util {
+    /**
+     * @brief Stats of the last XPBDSolver::step()
+     */
+    struct XPBDStats {
+        std::size_t particles = 0;
+        std::size_t constraints = 0;
+        std::size_t colours = 0;          // Constraint batches, constraints of a batch share no particle
+        int substeps = 0;
+        int iterations = 0;               // Per substep
+        unsigned threads = 0;
+        double colourSeconds = 0.0;       // Only when constraints were added since the last step
+        double solveSeconds = 0.0;        // Prediction, constraints and velocity update
+        double collisionSeconds = 0.0;
+        double totalSeconds = 0.0;
+
+        // Constraint projections per millisecond of solve time
+        double constraintIterationsPerMs() const {
+            return solveSeconds > 0.0 ? (double)constraints * substeps * iterations / (solveSeconds * 1000.0) : 0.0;
+        }
+    };
+
+    // Collision shapes for XPBDSolver, BoundingBox (raylib) is used for boxes
+    struct XPBDSphere {
+        vec3 center;
+        float radius;
+    };
+
+    struct XPBDCapsule {
+        vec3 a, b;
+        float radius;
+    };
+
+    // Half space dot(normal, p) >= distance, normal must be normalized
+    struct XPBDPlane {
+        vec3 normal;
+        float distance;
+    };
+
+    namespace XPBD {
+        constexpr std::size_t BLOCK = 64;
+
+        /**
+         * @brief Project a block of distance constraints (no shared particles). Works on copies gathered into
+         *        local arrays, so the loops vectorize
+         * @param n Constraints in the block, <= BLOCK
+         * @param d Positions of a minus positions of b per axis, replaced by the correction direction * delta lambda
+         * @param wa Inverse mass of a
+         * @param wb Inverse mass of b
+         * @param rest Rest lengths
+         * @param alpha Compliance / dt^2
+         * @param lambda Accumulated lambdas, updated
+         */
+        inline void solve_distance_block(std::size_t n, float (&d)[3][BLOCK], const float (&wa)[BLOCK], const float (&wb)[BLOCK],
+                const float (&rest)[BLOCK], const float (&alpha)[BLOCK], float (&lambda)[BLOCK]) {
+            float length[BLOCK];
+            for (std::size_t i = 0; i < n; i++) length[i] = d[0][i] * d[0][i] + d[1][i] * d[1][i] + d[2][i] * d[2][i];
+            sqrtInPlace(length, n);
+            for (std::size_t i = 0; i < n; i++) {
+                // C = |a - b| - rest, dlambda = (-C - alpha lambda) / (wa + wb + alpha)
+                const float c = length[i] - rest[i];
+                const float dLambda = (-c - alpha[i] * lambda[i]) / (wa[i] + wb[i] + alpha[i] + 1e-12f);
+                lambda[i] += dLambda;
+                const float s = dLambda / (length[i] + 1e-12f);
+                d[0][i] *= s;
+                d[1][i] *= s;
+                d[2][i] *= s;
+            }
+        }
+    }
+
+    /**
+     * @brief Extended position based dynamics (XPBD) for cloth and ropes, with small steps (several substeps,
+     *        one iteration each by default) which converges much better than more iterations of one big step
+     *
+     *        Particles are SoA, constraints are distance constraints with a compliance (inverse stiffness,
+     *        0 = rigid) so stiffness doesn't depend on the timestep or iteration count. Constraints are greedily
+     *        coloured into batches sharing no particle, the constraints of a batch are then independent: they are
+     *        split over threads and solved in blocks whose math auto vectorizes. Results don't depend on the
+     *        thread count
+     *
+     *        Particles collide with spheres, capsules, planes and boxes (no self collision)
+     */
+    class XPBDSolver {
+    public:
+        using ParticleId = uint32_t;
+
+        vec3 gravity = vec3(0.0f, -9.81f, 0.0f);
+        int substeps = 8;
+        int iterations = 1;                 // Per substep
+        float damping = 0.0f;               // Velocity lost per second (0 - 1)
+        float collisionMargin = 0.01f;      // Particles are kept this far from colliders
+        float friction = 0.3f;              // 0 = slide, 1 = stick on contact
+
+        std::vector<XPBDSphere> spheres;
+        std::vector<XPBDCapsule> capsules;
+        std::vector<XPBDPlane> planes;
+        std::vector<BoundingBox> boxes;
+
+        /**
+         * @brief Add a particle
+         * @param position Position
+         * @param mass Mass, 0 = pinned (infinite mass)
+         * @return ParticleId
+         */
+        ParticleId addParticle(const vec3 &position, float mass = 1.0f) {
+            const float p[3] = { position.x, position.y, position.z };
+            for (int k = 0; k < 3; k++) {
+                pos[k].push_back(p[k]);
+                prev[k].push_back(p[k]);
+                vel[k].push_back(0.0f);
+            }
+            invMass.push_back(mass > 0.0f ? 1.0f / mass : 0.0f);
+            return (ParticleId)(invMass.size() - 1);
+        }
+
+        /**
+         * @brief Add a distance constraint
+         * @param a First particle
+         * @param b Second particle
+         * @param compliance Inverse stiffness in m/N, 0 = rigid
+         * @param restLength Rest length, < 0 = current distance
+         */
+        void addDistanceConstraint(ParticleId a, ParticleId b, float compliance = 0.0f, float restLength = -1.0f) {
+            if (restLength < 0.0f) restLength = getPosition(a).distance(getPosition(b));
+            constraintA.push_back(a);
+            constraintB.push_back(b);
+            constraintRest.push_back(restLength);
+            constraintCompliance.push_back(compliance);
+            coloured = false;
+        }
+
+        /**
+         * @brief Add a rope of segments + 1 particles from start to end
+         * @param mass Mass of each particle
+         * @param compliance Stretch compliance
+         * @param bendCompliance Compliance of the constraints skipping one particle, < 0 = no bending resistance
+         * @return ParticleId First particle, the others follow in order
+         */
+        ParticleId addRope(const vec3 &start, const vec3 &end, int segments, float mass = 1.0f, float compliance = 0.0f,
+                float bendCompliance = -1.0f) {
+            const ParticleId first = (ParticleId)size();
+            segments = std::max(segments, 1);
+            for (int i = 0; i <= segments; i++) addParticle(start + (end - start) * ((float)i / segments), mass);
+            for (int i = 0; i < segments; i++) addDistanceConstraint(first + i, first + i + 1, compliance);
+            if (bendCompliance >= 0.0f)
+                for (int i = 0; i + 1 < segments; i++) addDistanceConstraint(first + i, first + i + 2, bendCompliance);
+            return first;
+        }
+
+        /**
+         * @brief Add a rectangular cloth of resU * resV particles, with stretch (grid edges), shear (diagonals)
+         *        and bend (skipping one particle) constraints
+         * @param origin Corner of the cloth
+         * @param u Edge of the cloth along its first axis
+         * @param v Edge of the cloth along its second axis
+         * @param resU Particles along u (>= 2)
+         * @param resV Particles along v (>= 2)
+         * @param mass Mass of each particle
+         * @param compliance Stretch / shear compliance
+         * @param bendCompliance Bend compliance, < 0 = no bend constraints
+         * @return ParticleId First particle, particle (i, j) is first + j * resU + i
+         */
+        ParticleId addCloth(const vec3 &origin, const vec3 &u, const vec3 &v, int resU, int resV, float mass = 1.0f,
+                float compliance = 0.0f, float bendCompliance = 0.01f) {
+            const ParticleId first = (ParticleId)size();
+            resU = std::max(resU, 2);
+            resV = std::max(resV, 2);
+            for (int j = 0; j < resV; j++)
+                for (int i = 0; i < resU; i++)
+                    addParticle(origin + u * ((float)i / (resU - 1)) + v * ((float)j / (resV - 1)), mass);
+            auto id = [&](int i, int j) { return first + (ParticleId)(j * resU + i); };
+            for (int j = 0; j < resV; j++) {
+                for (int i = 0; i < resU; i++) {
+                    if (i + 1 < resU) addDistanceConstraint(id(i, j), id(i + 1, j), compliance);
+                    if (j + 1 < resV) addDistanceConstraint(id(i, j), id(i, j + 1), compliance);
+                    if (i + 1 < resU && j + 1 < resV) {
+                        addDistanceConstraint(id(i, j), id(i + 1, j + 1), compliance);
+                        addDistanceConstraint(id(i + 1, j), id(i, j + 1), compliance);
+                    }
+                    if (bendCompliance < 0.0f) continue;
+                    if (i + 2 < resU) addDistanceConstraint(id(i, j), id(i + 2, j), bendCompliance);
+                    if (j + 2 < resV) addDistanceConstraint(id(i, j), id(i, j + 2), bendCompliance);
+                }
+            }
+            return first;
+        }
+
+        // Mass 0 pins the particle. Pinning / unpinning recolours the constraints on the next step, pinned
+        // particles may be shared inside a colour but free ones can't
+        void setMass(ParticleId p, float mass) {
+            const float inv = mass > 0.0f ? 1.0f / mass : 0.0f;
+            if ((inv == 0.0f) != (invMass[p] == 0.0f)) coloured = false;
+            invMass[p] = inv;
+        }
+
+        // Move a particle without giving it velocity (ie pinned particles attached to something)
+        void setPosition(ParticleId p, const vec3 &position) {
+            const float v[3] = { position.x, position.y, position.z };
+            for (int k = 0; k < 3; k++) pos[k][p] = prev[k][p] = v[k];
+        }
+
+        void setVelocity(ParticleId p, const vec3 &velocity) {
+            vel[0][p] = velocity.x;
+            vel[1][p] = velocity.y;
+            vel[2][p] = velocity.z;
+        }
+
+        vec3 getPosition(ParticleId p) const { return vec3(pos[0][p], pos[1][p], pos[2][p]); }
+        vec3 getVelocity(ParticleId p) const { return vec3(vel[0][p], vel[1][p], vel[2][p]); }
+        bool isPinned(ParticleId p) const { return invMass[p] == 0.0f; }
+        std::size_t size() const { return invMass.size(); }
+        std::size_t getConstraintCount() const { return constraintA.size(); }
+
+        // SoA streams, axis 0 = x, 1 = y, 2 = z
+        std::span<const float> getPositions(int axis) const { return pos[axis]; }
+        std::span<const float> getVelocities(int axis) const { return vel[axis]; }
+
+        void clear() {
+            for (int k = 0; k < 3; k++) {
+                pos[k].clear();
+                prev[k].clear();
+                vel[k].clear();
+            }
+            invMass.clear();
+            constraintA.clear();
+            constraintB.clear();
+            constraintRest.clear();
+            constraintCompliance.clear();
+            coloured = false;
+        }
+
+        /**
+         * @brief Advance the simulation
+         * @param dt Time step, split into substeps
+         * @param threads Number of threads, 0 = hardwareThreadCount()
+         * @return const XPBDStats& Stats of this step
+         */
+        const XPBDStats &step(float dt, unsigned threads = 0) {
+            const auto totalStart = std::chrono::steady_clock::now();
+            stats = XPBDStats();
+            stats.particles = size();
+            stats.constraints = getConstraintCount();
+            stats.substeps = std::max(substeps, 1);
+            stats.iterations = std::max(iterations, 1);
+            if (!threads) threads = hardwareThreadCount();
+            stats.threads = threads;
+            if (dt <= 0.0f || !size()) return stats;
+
+            if (!coloured) {
+                const auto start = std::chrono::steady_clock::now();
+                build_colours();
+                stats.colourSeconds = secondsSince(start);
+            }
+            stats.colours = colourStart.size() - 1;
+
+            const float h = dt / stats.substeps;
+            const float keep = std::clamp(1.0f - damping * h, 0.0f, 1.0f);
+            for (int s = 0; s < stats.substeps; s++) {
+                auto start = std::chrono::steady_clock::now();
+                integrate(h, keep, threads);
+                std::fill(lambda.begin(), lambda.end(), 0.0f);
+                for (int it = 0; it < stats.iterations; it++)
+                    for (std::size_t c = 0; c + 1 < colourStart.size(); c++) solve_colour(c, h, threads);
+                stats.solveSeconds += secondsSince(start);
+
+                start = std::chrono::steady_clock::now();
+                collide(threads);
+                stats.collisionSeconds += secondsSince(start);
+
+                start = std::chrono::steady_clock::now();
+                update_velocities(h, threads);
+                stats.solveSeconds += secondsSince(start);
+            }
+            stats.totalSeconds = secondsSince(totalStart);
+            return stats;
+        }
+
+        const XPBDStats &getStats() const { return stats; }
+        std::size_t getColourCount() const { return coloured ? colourStart.size() - 1 : 0; }
+
+    private:
+        std::vector<float> pos[3], prev[3], vel[3], invMass;
+
+        // Constraints in insertion order
+        std::vector<ParticleId> constraintA, constraintB;
+        std::vector<float> constraintRest, constraintCompliance;
+
+        // Constraints sorted by colour, colour c is [colourStart[c], colourStart[c + 1])
+        bool coloured = false;
+        std::vector<ParticleId> colouredA, colouredB;
+        std::vector<float> colouredRest, colouredCompliance, lambda;
+        std::vector<std::size_t> colourStart;
+
+        XPBDStats stats;
+
+        // Greedy colouring, each pass takes every remaining constraint whose particles are still free in this colour
+        void build_colours() {
+            const std::size_t m = constraintA.size();
+            std::vector<uint32_t> order(m), remaining(m), stamp(size(), 0);
+            for (uint32_t i = 0; i < m; i++) remaining[i] = i;
+            colourStart.assign(1, 0);
+            std::size_t placed = 0;
+            for (uint32_t colour = 1; !remaining.empty(); colour++) {
+                std::size_t kept = 0;
+                for (uint32_t c : remaining) {
+                    const ParticleId a = constraintA[c], b = constraintB[c];
+                    if (stamp[a] == colour || stamp[b] == colour) {
+                        remaining[kept++] = c;
+                        continue;
+                    }
+                    // Pinned particles are never written, they don't need to be exclusive
+                    if (invMass[a] != 0.0f) stamp[a] = colour;
+                    if (invMass[b] != 0.0f) stamp[b] = colour;
+                    order[placed++] = c;
+                }
+                remaining.resize(kept);
+                colourStart.push_back(placed);
+            }
+
+            colouredA.resize(m);
+            colouredB.resize(m);
+            colouredRest.resize(m);
+            colouredCompliance.resize(m);
+            lambda.assign(m, 0.0f);
+            for (std::size_t i = 0; i < m; i++) {
+                colouredA[i] = constraintA[order[i]];
+                colouredB[i] = constraintB[order[i]];
+                colouredRest[i] = constraintRest[order[i]];
+                colouredCompliance[i] = constraintCompliance[order[i]];
+            }
+            coloured = true;
+        }
+
+        // Predict positions from velocities and gravity
+        void integrate(float h, float keep, unsigned threads) {
+            const float g[3] = { gravity.x, gravity.y, gravity.z };
+            parallelFor(0, size(), [&](std::size_t begin, std::size_t end, unsigned) {
+                const float * w = invMass.data();
+                for (int k = 0; k < 3; k++) {
+                    float * p = pos[k].data(), * p0 = prev[k].data(), * v = vel[k].data();
+                    const float gh = g[k] * h;
+                    for (std::size_t i = begin; i < end; i++) {
+                        // Pinned particles keep their velocity (set by setVelocity() for kinematic motion)
+                        v[i] = w[i] != 0.0f ? (v[i] + gh) * keep : v[i];
+                        p0[i] = p[i];
+                        p[i] += v[i] * h;
+                    }
+                }
+            }, threads, 16384);
+        }
+
+        void solve_colour(std::size_t colour, float h, unsigned threads) {
+            using XPBD::BLOCK;
+            const float invH2 = 1.0f / (h * h);
+            parallelFor(colourStart[colour], colourStart[colour + 1], [&](std::size_t begin, std::size_t end, unsigned) {
+                float d[3][BLOCK], wa[BLOCK], wb[BLOCK], rest[BLOCK], alpha[BLOCK], lambdas[BLOCK];
+                float * px = pos[0].data(), * py = pos[1].data(), * pz = pos[2].data();
+                const float * w = invMass.data();
+                const ParticleId * ia = colouredA.data(), * ib = colouredB.data();
+                for (std::size_t first = begin; first < end; first += BLOCK) {
+                    const std::size_t n = std::min(BLOCK, end - first);
+                    for (std::size_t i = 0; i < n; i++) {
+                        const ParticleId a = ia[first + i], b = ib[first + i];
+                        d[0][i] = px[a] - px[b];
+                        d[1][i] = py[a] - py[b];
+                        d[2][i] = pz[a] - pz[b];
+                        wa[i] = w[a];
+                        wb[i] = w[b];
+                        rest[i] = colouredRest[first + i];
+                        alpha[i] = colouredCompliance[first + i] * invH2;
+                        lambdas[i] = lambda[first + i];
+                    }
+                    XPBD::solve_distance_block(n, d, wa, wb, rest, alpha, lambdas);
+                    // No free particle appears twice in a colour, scattering in any order is safe. Pinned
+                    // particles can be shared, they are skipped so threads never write them
+                    for (std::size_t i = 0; i < n; i++) {
+                        const ParticleId a = ia[first + i], b = ib[first + i];
+                        if (wa[i] != 0.0f) {
+                            px[a] += wa[i] * d[0][i];
+                            py[a] += wa[i] * d[1][i];
+                            pz[a] += wa[i] * d[2][i];
+                        }
+                        if (wb[i] != 0.0f) {
+                            px[b] -= wb[i] * d[0][i];
+                            py[b] -= wb[i] * d[1][i];
+                            pz[b] -= wb[i] * d[2][i];
+                        }
+                        lambda[first + i] = lambdas[i];
+                    }
+                }
+            }, threads, 4096);
+        }
+
+        // Push particles out of the colliders, friction removes part of the tangential motion of the substep
+        void collide(unsigned threads) {
+            if (spheres.empty() && capsules.empty() && planes.empty() && boxes.empty()) return;
+            parallelFor(0, size(), [&](std::size_t begin, std::size_t end, unsigned) {
+                for (std::size_t i = begin; i < end; i++) {
+                    if (invMass[i] == 0.0f) continue;
+                    vec3 p(pos[0][i], pos[1][i], pos[2][i]);
+                    vec3 normal;
+                    bool hit = false;
+                    auto push = [&](const vec3 &n, float depth) {
+                        p += n * depth;
+                        normal = n;
+                        hit = true;
+                    };
+
+                    for (const XPBDPlane &plane : planes) {
+                        const float dist = plane.normal.dot(p) - plane.distance;
+                        if (dist < collisionMargin) push(plane.normal, collisionMargin - dist);
+                    }
+                    for (const XPBDSphere &sphere : spheres) push_out_of_sphere(p, sphere.center, sphere.radius, push);
+                    for (const XPBDCapsule &capsule : capsules) {
+                        const vec3 ab = capsule.b - capsule.a;
+                        const float len2 = ab.lengthSqr();
+                        const float t = len2 > 0.0f ? std::clamp((p - capsule.a).dot(ab) / len2, 0.0f, 1.0f) : 0.0f;
+                        push_out_of_sphere(p, capsule.a + ab * t, capsule.radius, push);
+                    }
+                    for (const BoundingBox &box : boxes) push_out_of_box(p, box, push);
+
+                    if (hit) {
+                        const vec3 p0(prev[0][i], prev[1][i], prev[2][i]);
+                        const vec3 delta = p - p0;
+                        p -= (delta - normal * normal.dot(delta)) * friction;
+                    }
+                    pos[0][i] = p.x;
+                    pos[1][i] = p.y;
+                    pos[2][i] = p.z;
+                }
+            }, threads, 4096);
+        }
+
+        template <class F>
+        void push_out_of_sphere(const vec3 &p, const vec3 &center, float radius, F &&push) const {
+            const vec3 d = p - center;
+            const float r = radius + collisionMargin, dist2 = d.lengthSqr();
+            if (dist2 >= r * r) return;
+            const float dist = std::sqrt(dist2);
+            push(dist > 1e-6f ? d / dist : vec3(0.0f, 1.0f, 0.0f), r - dist);
+        }
+
+        // Out through the face of least penetration
+        template <class F>
+        void push_out_of_box(const vec3 &p, const BoundingBox &box, F &&push) const {
+            const float m = collisionMargin;
+            const float lo[3] = { p.x - (box.min.x - m), p.y - (box.min.y - m), p.z - (box.min.z - m) };
+            const float hi[3] = { (box.max.x + m) - p.x, (box.max.y + m) - p.y, (box.max.z + m) - p.z };
+            int axis = 0;
+            float depth = lo[0], sign = -1.0f;
+            for (int k = 0; k < 3; k++) {
+                if (lo[k] <= 0.0f || hi[k] <= 0.0f) return;
+                if (lo[k] < depth) { depth = lo[k]; axis = k; sign = -1.0f; }
+                if (hi[k] < depth) { depth = hi[k]; axis = k; sign = 1.0f; }
+            }
+            push(vec3(axis == 0 ? sign : 0.0f, axis == 1 ? sign : 0.0f, axis == 2 ? sign : 0.0f), depth);
+        }
+
+        void update_velocities(float h, unsigned threads) {
+            const float invH = 1.0f / h;
+            parallelFor(0, size(), [&](std::size_t begin, std::size_t end, unsigned) {
+                const float * w = invMass.data();
+                for (int k = 0; k < 3; k++) {
+                    const float * p = pos[k].data(), * p0 = prev[k].data();
+                    float * v = vel[k].data();
+                    for (std::size_t i = begin; i < end; i++) v[i] = w[i] != 0.0f ? (p[i] - p0[i]) * invH : v[i];
+                }
+            }, threads, 16384);
+        }
+    };
+}
+
+#endif